@@ -24,6 +24,12 @@ set(LIBRARY_OUTPUT_PATH ${PROJECT_BINARY_DIR}/lib)
 
 SET(CMAKE_VERBOSE_MAKEFILE OFF)
 
+######################################
+#hook malloc and operator new in benchmark_main
+#for --track-allocations, off by default as the
+#hooks replace tcmalloc, jemalloc or mimalloc
+option (BENCHMARK_ALLOCATION_HOOKS "if hooking heap allocations" OFF)
+
 ######################################
 #for test
 option(test "enable test on" ON)
@@ -0,0 +1,267 @@
+#ifndef BENCHMARK_ASYNC_TEST_H_
+#define BENCHMARK_ASYNC_TEST_H_
+#include <cstddef>
+#include <vector>
+#include <pthread.h>
+#include <benchmark/clock.h>
+#include <benchmark/statistics.h>
+#include <benchmark/test.h>
+#include <benchmark/test_result.h>
+#include <benchmark/trace_recorder.h>
+
+namespace benchmark {
+
+/// Test of operations that complete asynchronously.
+
+/// Instead of a synchronous test body, startOperation() starts one
+/// operation and hands it a completion token, which the operation
+/// completes from any thread once it has actually finished, e.g. from a
+/// callback or a future continuation. Each iteration is one operation,
+/// and up to maxInFlight() operations are kept outstanding at once. A run
+/// ends only when every operation has completed, so unfinished work is
+/// never left out of the measurement.
+///
+/// Besides the run time, the latency of every operation from start to
+/// completion is reported as the "operation_latency_ns" counter.
+class AsyncTest : public Test {
+public:
+    /// Completion token of an operation.
+    class Completion {
+    public:
+        Completion()
+            :   _owner(NULL),
+                _start(0)
+        {
+
+        }
+
+
+        /// Signal that the operation has finished.
+
+        /// Must be called exactly once per operation, from any thread.
+        void complete()
+        {
+            _owner->completed(*this);
+        }
+    private:
+        friend class AsyncTest;
+
+        AsyncTest          *_owner;
+        Clock::TimePoint    _start;
+    };
+
+
+    AsyncTest()
+        :   _maxInFlight(1),
+            _completed(0)
+    {
+        ::pthread_mutex_init(&_mutex, NULL);
+        ::pthread_cond_init(&_condition, NULL);
+    }
+
+
+    virtual ~AsyncTest()
+    {
+        ::pthread_cond_destroy(&_condition);
+        ::pthread_mutex_destroy(&_mutex);
+    }
+
+
+    /// Maximum number of operations in flight at once.
+    inline std::size_t maxInFlight() const
+    {
+        return _maxInFlight;
+    }
+
+
+    /// Run operations, keeping up to maxInFlight() in flight.
+
+    /// @returns the time from the first start to the last completion in
+    /// nanoseconds.
+    virtual uint64_t run(std::size_t iterations)
+    {
+        std::vector<Completion> tokens(_maxInFlight);
+        std::vector<Completion*> idle;
+        for (std::size_t i = 0; i < tokens.size(); ++i) {
+            tokens[i]._owner = this;
+            idle.push_back(&tokens[i]);
+        }
+
+        const bool traced = TraceRecorder::enabled();
+        uint64_t traceMark = (traced ? TraceRecorder::now() : 0);
+
+        beginFootprint();
+        setUp();
+        if (traced)
+            traceMark = TraceRecorder::span("setUp", "fixture", traceMark);
+        if (cacheFlush().Mode == CacheFlushRuns)
+            CacheFlusher::flush(cacheFlush().Instructions);
+
+        ::pthread_mutex_lock(&_mutex);
+        _idle.swap(idle);
+        _completed = 0;
+        ::pthread_mutex_unlock(&_mutex);
+
+        beginCounting();
+        const Clock::TimePoint startTime = Clock::now();
+        std::size_t started = 0;
+
+        ::pthread_mutex_lock(&_mutex);
+        while (_completed < iterations) {
+            // Start operations while tokens are available.
+            if ((started < iterations) && (!_idle.empty())) {
+                Completion* token = _idle.back();
+                _idle.pop_back();
+                ++started;
+                ::pthread_mutex_unlock(&_mutex);
+
+                token->_start = Clock::now();
+                startOperation(*token);
+
+                ::pthread_mutex_lock(&_mutex);
+                continue;
+            }
+
+            // Let the operations progress.
+            const std::size_t completed = _completed;
+            ::pthread_mutex_unlock(&_mutex);
+            const bool progressed = poll();
+            ::pthread_mutex_lock(&_mutex);
+
+            if ((!progressed) && (_completed == completed)) {
+                ::pthread_cond_wait(&_condition, &_mutex);
+            }
+        }
+        _idle.clear();
+        ::pthread_mutex_unlock(&_mutex);
+
+        const Clock::TimePoint endTime = Clock::now();
+        endCounting(iterations);
+        endFootprint();
+        const uint64_t duration = Clock::duration(startTime, endTime);
+        if (traced)
+            traceMark = traceRun(traceMark, iterations, duration);
+
+        tearDown();
+        if (traced)
+            TraceRecorder::span("tearDown", "fixture", traceMark);
+
+        return duration;
+    }
+
+
+    /// Set when to flush the caches around the timed region.
+
+    /// Operations overlap, so the caches are flushed before every run
+    /// rather than before every iteration.
+    virtual void setCacheFlush(const CacheFlush& flush)
+    {
+        CacheFlush perRun(flush);
+        if (perRun.Mode == CacheFlushIterations) {
+            perRun.Mode = CacheFlushRuns;
+        }
+        Test::setCacheFlush(perRun);
+    }
+
+
+    virtual void collectCounters(ResultCounters& counters)
+    {
+        ResultCounters own;
+
+        ::pthread_mutex_lock(&_mutex);
+        if (_latencies.count()) {
+            own["operation_latency_ns"] = _latencies;
+        }
+        _latencies = SampleStatistics();
+        ::pthread_mutex_unlock(&_mutex);
+
+        mergeCounters(counters, own);
+        Test::collectCounters(counters);
+    }
+protected:
+    /// Set the maximum number of operations in flight at once.
+
+    /// Expected to be called from the fixture constructor.
+    inline void setMaxInFlight(std::size_t count)
+    {
+        _maxInFlight = (count ? count : 1);
+    }
+
+
+    /// Start an operation.
+
+    /// @param completion Token to complete once the operation has
+    /// finished. May be completed before this returns.
+    virtual void startOperation(Completion& completion)
+    {
+        completion.complete();
+    }
+
+
+    /// Let outstanding operations progress.
+
+    /// Called while the runner waits for completions. Operations driven by
+    /// an event loop on the runner's thread run one round of it here.
+    /// @returns false if nothing could be done, in which case the runner
+    /// blocks until an operation completes on another thread.
+    virtual bool poll()
+    {
+        return false;
+    }
+
+
+    /// Run a single operation to completion.
+    virtual void testBody()
+    {
+        std::vector<Completion*> idle;
+        Completion token;
+        token._owner = this;
+        idle.push_back(&token);
+
+        ::pthread_mutex_lock(&_mutex);
+        _idle.swap(idle);
+        const std::size_t target = _completed + 1;
+        ::pthread_mutex_unlock(&_mutex);
+
+        token._start = Clock::now();
+        startOperation(token);
+
+        ::pthread_mutex_lock(&_mutex);
+        while (_completed < target) {
+            ::pthread_mutex_unlock(&_mutex);
+            const bool progressed = poll();
+            ::pthread_mutex_lock(&_mutex);
+            if ((!progressed) && (_completed < target)) {
+                ::pthread_cond_wait(&_condition, &_mutex);
+            }
+        }
+        _idle.clear();
+        ::pthread_mutex_unlock(&_mutex);
+    }
+private:
+    /// Record the completion of an operation.
+    void completed(Completion& completion)
+    {
+        const Clock::TimePoint end = Clock::now();
+
+        ::pthread_mutex_lock(&_mutex);
+        _latencies.add(double(Clock::duration(completion._start, end)));
+        _idle.push_back(&completion);
+        ++_completed;
+        ::pthread_cond_signal(&_condition);
+        ::pthread_mutex_unlock(&_mutex);
+    }
+private:
+    AsyncTest(const AsyncTest&);
+    AsyncTest& operator =(const AsyncTest&);
+private:
+    std::size_t                 _maxInFlight;
+    std::size_t                 _completed;
+    std::vector<Completion*>    _idle;
+    SampleStatistics            _latencies;
+    pthread_mutex_t             _mutex;
+    pthread_cond_t              _condition;
+};
+
+}
+#endif
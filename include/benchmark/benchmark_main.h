@@ -1,13 +1,17 @@
 #ifndef BENCHMARK_BENCHMARK_MAIN_H_
 #define BENCHMARK_BENCHMARK_MAIN_H_
 #include <benchmark/benchmark.h>
+#include <benchmark/repetition.h>
+#include <benchmark/load_generator.h>
 #include <algorithm>
+#include <alloca.h>
 #include <cstdlib>
 #include <cstring>
 #include <ctime>
 #include <errno.h>
 #include <fstream>
 #include <set>
+#include <sys/mman.h>
 #include <vector>
 
 #define PATH_SEPARATOR '/'
@@ -34,7 +38,11 @@ namespace benchmark {
 
 
         /// List benchmarks but do not execute them.
-        MainListBenchmarks
+        MainListBenchmarks,
+
+
+        /// Loop one benchmark for an external profiler.
+        MainProfileBenchmark
     };
 
     class FileOutputter {
@@ -116,12 +124,39 @@ namespace benchmark {
     }
 
     FILE_OUTPUTTER_IMPLEMENTATION(Console);
+    FILE_OUTPUTTER_IMPLEMENTATION(Columnar);
+    FILE_OUTPUTTER_IMPLEMENTATION(JUnitXml);
+    FILE_OUTPUTTER_IMPLEMENTATION(Csv);
+    FILE_OUTPUTTER_IMPLEMENTATION(Tsv);
+    FILE_OUTPUTTER_IMPLEMENTATION(CsvRuns);
+    FILE_OUTPUTTER_IMPLEMENTATION(TsvRuns);
+    FILE_OUTPUTTER_IMPLEMENTATION(Trace);
 
 class MainRunner {
 public:
     MainRunner()
         : ExecutionMode(MainRunBenchmarks),
           ShuffleBenchmarks(false),
+          RetainSamples(false),
+          SoftwareCounters(false),
+          TrackAllocations(false),
+          MeasureMemory(false),
+          LockMemory(false),
+          DetectPreemption(false),
+          PreemptionRetries(0),
+          MeasureFrequency(false),
+          NormalizeFrequency(false),
+          FrequencyThreshold(5.0),
+          AsyncOutput(false),
+          RecordTrace(false),
+          TraceIterations(0),
+          Isolation(IsolationNone),
+          IsolationTimeout(300),
+          Repetitions(1),
+          RepetitionOutputFd(-1),
+          Jobs(1),
+          Duration(10.0),
+          LoadThreads(1),
           StdoutOutputter(NULL)
         {
 
@@ -150,6 +185,125 @@ public:
     bool ShuffleBenchmarks;
 
 
+    /// Retain raw run times in the results.
+    bool RetainSamples;
+
+
+    /// Count software events around every run.
+    bool SoftwareCounters;
+
+
+    /// Track heap allocations in the timed region.
+    bool TrackAllocations;
+
+
+    /// Measure the memory footprint of every run.
+    bool MeasureMemory;
+
+
+    /// Cache flushing around the timed region of every benchmark.
+    ::benchmark::CacheFlush ColdCache;
+
+
+    /// Lock all current and future memory of the process.
+    bool LockMemory;
+
+
+    /// Real-time measures while measuring.
+    ::benchmark::Realtime RealtimeMeasures;
+
+
+    /// Detect preempted or migrated runs.
+    bool DetectPreemption;
+
+
+    /// Preempted or migrated runs per test to run again.
+    unsigned long PreemptionRetries;
+
+
+    /// Measure the effective CPU frequency of every run.
+    bool MeasureFrequency;
+
+
+    /// Scale run times to the nominal CPU frequency.
+    bool NormalizeFrequency;
+
+
+    /// Deviation from the median frequency flagged, in percent.
+    double FrequencyThreshold;
+
+
+    /// Write the output on a background thread.
+    bool AsyncOutput;
+
+
+    /// Record the timeline of the runs for the trace output.
+    bool RecordTrace;
+
+
+    /// Record every n-th iteration in the trace, or 0 for none.
+    unsigned long TraceIterations;
+
+
+    /// Directory to write profiles of the timed regions to, if any.
+    std::string ProfileDirectory;
+
+
+    /// Process isolation mode.
+    IsolationMode Isolation;
+
+
+    /// Time limit in seconds for each isolated child, 0 for none.
+    unsigned IsolationTimeout;
+
+
+    /// Number of benchmark processes to aggregate results from.
+    std::size_t Repetitions;
+
+
+    /// Descriptor to report results to when running as a repetition.
+
+    /// -1 unless this process was started by a repetition parent.
+    int RepetitionOutputFd;
+
+
+    /// Number of benchmarks run concurrently.
+    std::size_t Jobs;
+
+
+    /// CPUs to run concurrent benchmarks on. Empty for all allowed CPUs.
+    std::vector<int> Cpus;
+
+
+    /// File with historical benchmark durations.
+    std::string HistoryPath;
+
+
+    /// Placement of the benchmarks.
+    Placement BenchmarkPlacement;
+
+
+    /// Offered rates for open-loop load. Empty for closed-loop runs.
+    std::vector<double> LoadRates;
+
+
+    /// Seconds to offer each rate for, or to loop the profiled benchmark
+    /// for.
+    double Duration;
+
+
+    /// Benchmark to loop for an external profiler.
+    std::string ProfiledBenchmark;
+
+
+    /// Markers around the profiled steady state.
+    SteadyStateMarkers ProfileMarkers;
+
+
+    /// Number of load driver threads.
+    std::size_t LoadThreads;
+
+
     /// File outputters.
     ///
     /// Outputter will be freed by the class on destruction.
@@ -178,6 +332,17 @@ public:
                       char** argv,
                       std::vector<char*>* residualArgs = NULL)
     {
+        // Keep the arguments for re-executing repetitions, leaving out the
+        // repetition count itself.
+        _arguments.clear();
+        for (int i = 0; i < argc; ++i) {
+            if ((!strcmp(argv[i], "--repetitions")) && (i + 1 < argc)) {
+                ++i;
+                continue;
+            }
+            _arguments.push_back(argv[i]);
+        }
+
         int argI = 1;
         while (argI < argc) {
             char* arg = argv[argI++];
@@ -192,6 +357,224 @@ public:
                 ExecutionMode = ::benchmark::MainListBenchmarks;
             } else if ((!strcmp(arg, "-s")) || (!strcmp(arg, "--shuffle"))) {
                 ShuffleBenchmarks = true;
+            } else if (!strcmp(arg, "--retain-samples")) {
+                RetainSamples = true;
+            } else if (!strcmp(arg, "--software-counters")) {
+                SoftwareCounters = true;
+            } else if (!strcmp(arg, "--track-allocations")) {
+                if (!::benchmark::AllocationTracker::available()) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires the allocation hooks, build with "
+                                "BENCHMARK_ALLOCATION_HOOKS");
+                }
+                TrackAllocations = true;
+            } else if (!strcmp(arg, "--memory")) {
+                MeasureMemory = true;
+            } else if (!strcmp(arg, "--realtime")) {
+                RealtimeMeasures.Enabled = true;
+            } else if (!strcmp(arg, "--realtime-priority")) {
+                unsigned long priority = 0;
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI], priority)) ||
+                    (priority < 1) ||
+                    (priority > 99)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a priority from 1 to 99");
+                }
+                ++argI;
+                RealtimeMeasures.Enabled = true;
+                RealtimeMeasures.Priority = int(priority);
+            } else if (!strcmp(arg, "--detect-preemption")) {
+                DetectPreemption = true;
+            } else if (!strcmp(arg, "--retry-preempted")) {
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI++], PreemptionRetries))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a number of retries");
+                }
+                DetectPreemption = true;
+            } else if (!strcmp(arg, "--frequency")) {
+                MeasureFrequency = true;
+            } else if (!strcmp(arg, "--normalize-frequency")) {
+                MeasureFrequency = true;
+                NormalizeFrequency = true;
+            } else if (!strcmp(arg, "--frequency-threshold")) {
+                char* end = NULL;
+                if ((!argLast) && (*argv[argI])) {
+                    FrequencyThreshold = strtod(argv[argI], &end);
+                }
+                if ((!end) || (*end) || (FrequencyThreshold < 0.0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a percentage");
+                }
+                ++argI;
+                MeasureFrequency = true;
+            } else if (!strcmp(arg, "--async-output")) {
+                AsyncOutput = true;
+            } else if (!strcmp(arg, "--trace-iterations")) {
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI++], TraceIterations))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a number of iterations");
+                }
+            } else if (!strcmp(arg, "--mlockall")) {
+                LockMemory = true;
+            } else if (!strcmp(arg, "--cold-cache")) {
+                if (argLast) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires runs or iterations");
+                }
+                const char* mode = argv[argI++];
+                if (!strcmp(mode, "runs")) {
+                    ColdCache.Mode = ::benchmark::CacheFlushRuns;
+                } else if (!strcmp(mode, "iterations")) {
+                    ColdCache.Mode = ::benchmark::CacheFlushIterations;
+                } else {
+                    MAIN_USAGE_ERROR("invalid cold cache mode: " << mode);
+                }
+            } else if (!strcmp(arg, "--flush-code")) {
+                if (!::benchmark::CacheFlusher::codeFlushAvailable()) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires the code region of "
+                                "benchmark_main, which is not built in");
+                }
+                if (ColdCache.Mode == ::benchmark::CacheFlushNone) {
+                    ColdCache.Mode = ::benchmark::CacheFlushRuns;
+                }
+                ColdCache.Instructions = true;
+            } else if (!strcmp(arg, "--profile")) {
+                if ((argLast) || (*argv[argI] == 0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a directory to be specified");
+                }
+                ProfileDirectory = argv[argI++];
+            } else if (!strcmp(arg, "--profile-mode")) {
+                if ((argLast) || (*argv[argI] == 0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a benchmark name");
+                }
+                ExecutionMode = ::benchmark::MainProfileBenchmark;
+                ProfiledBenchmark = argv[argI++];
+            } else if (!strcmp(arg, "--perf-ctl")) {
+                if ((argLast) || (*argv[argI] == 0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a FIFO path");
+                }
+                ProfileMarkers.PerfControl = argv[argI++];
+                const std::string::size_type comma =
+                    ProfileMarkers.PerfControl.find(',');
+                if (comma != std::string::npos) {
+                    ProfileMarkers.PerfAck =
+                        ProfileMarkers.PerfControl.substr(comma + 1);
+                    ProfileMarkers.PerfControl.erase(comma);
+                }
+            } else if (!strcmp(arg, "--pause")) {
+                ProfileMarkers.Pause = true;
+            } else if (!strcmp(arg, "--isolate")) {
+                Isolation = IsolationPerTest;
+            } else if (!strcmp(arg, "--isolate-runs")) {
+                Isolation = IsolationPerRun;
+            } else if (!strcmp(arg, "--isolate-timeout")) {
+                unsigned long seconds;
+                if ((argLast) || (!ParseUnsigned(argv[argI++], seconds))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a number of seconds");
+                }
+                IsolationTimeout = unsigned(seconds);
+            } else if (!strcmp(arg, "--repetitions")) {
+                unsigned long repetitions;
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI++], repetitions)) ||
+                    (!repetitions)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a positive number of processes");
+                }
+                Repetitions = std::size_t(repetitions);
+            } else if ((!strcmp(arg, "-j")) || (!strcmp(arg, "--jobs"))) {
+                unsigned long jobs;
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI++], jobs)) ||
+                    (!jobs)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a positive number of jobs");
+                }
+                Jobs = std::size_t(jobs);
+            } else if (!strcmp(arg, "--cpus")) {
+                if ((argLast) ||
+                    (!::benchmark::CpuTopology::parseCpuList(argv[argI++],
+                                                             Cpus)) ||
+                    (Cpus.empty())) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a CPU list such as 0-3,8");
+                }
+
+                const std::vector<int> allowed =
+                    ::benchmark::CpuTopology::allowedCpus();
+                for (std::size_t i = 0; i < Cpus.size(); ++i) {
+                    if (!std::binary_search(allowed.begin(),
+                                            allowed.end(),
+                                            Cpus[i])) {
+                        MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) << " CPU "
+                                    << Cpus[i] << " is not available, "
+                                    << "allowed CPUs are "
+                                    << ::benchmark::CpuTopology::
+                                        formatCpuList(allowed));
+                    }
+                }
+            } else if (!strcmp(arg, "--cpu")) {
+                if ((argLast) ||
+                    (!::benchmark::CpuTopology::parseCpuList(
+                        argv[argI++],
+                        BenchmarkPlacement.Cpus)) ||
+                    (BenchmarkPlacement.Cpus.empty())) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a CPU list such as 0-3,8");
+                }
+            } else if (!strcmp(arg, "--numa-node")) {
+                unsigned long node;
+                if ((argLast) || (!ParseUnsigned(argv[argI++], node))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a node number");
+                }
+                BenchmarkPlacement.NumaNode = int(node);
+            } else if (!strcmp(arg, "--rate")) {
+                if ((argLast) ||
+                    (!::benchmark::LoadGenerator::parseRates(argv[argI++],
+                                                             LoadRates))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a list of rates such as "
+                                "50k/s,100k/s");
+                }
+            } else if (!strcmp(arg, "--duration")) {
+                if ((argLast) ||
+                    (!::benchmark::LoadGenerator::parseDuration(argv[argI++],
+                                                                Duration))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a duration such as 30s or 500ms");
+                }
+            } else if (!strcmp(arg, "--load-threads")) {
+                unsigned long threads;
+                if ((argLast) ||
+                    (!ParseUnsigned(argv[argI++], threads)) ||
+                    (!threads)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a positive number of threads");
+                }
+                LoadThreads = std::size_t(threads);
+            } else if (!strcmp(arg, "--history")) {
+                if ((argLast) || (*argv[argI] == 0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a path to be specified");
+                }
+                HistoryPath = argv[argI++];
+            } else if (!strcmp(arg, "--repetition-output")) {
+                // Internal: set by the parent of a repetition.
+                unsigned long fd;
+                if ((argLast) || (!ParseUnsigned(argv[argI++], fd))) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires a file descriptor");
+                }
+                RepetitionOutputFd = int(fd);
             } else if ((!strcmp(arg, "-f")) || (!strcmp(arg, "--filter"))) {
                 if ((argLast) || (*argv[argI] == 0)) {
                     MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
@@ -199,14 +582,23 @@ public:
                 }
                 char* pattern = argv[argI++];
                 ::benchmark::BenchMarker::applyPatternFilter(pattern);
+            } else if (!strcmp(arg, "--regex")) {
+                if ((argLast) || (*argv[argI] == 0)) {
+                    MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
+                                " requires an expression to be specified");
+                }
+                std::string error;
+                if (!::benchmark::BenchMarker::applyRegexFilter(argv[argI++],
+                                                                error)) {
+                    MAIN_USAGE_ERROR("invalid regular expression: " << error);
+                }
             } else if ((!strcmp(arg, "-o")) || (!strcmp(arg, "--output"))) {
                 if (argLast) {
                     MAIN_USAGE_ERROR(MAIN_FORMAT_FLAG(arg) <<
                                 " requires a format to be specified");
                 }
                 char* formatSpecifier = argv[argI++];
-                //unused variable
-                //char* format = formatSpecifier;
+                char* format = formatSpecifier;
                 char* path = strchr(formatSpecifier, ':');
                 if (path) {
                     *(path++) = 0;
@@ -228,18 +620,29 @@ public:
                             new ::benchmark::_prefix ## Outputter(std::cout); \
                     }                                               \
                 }
-                ADD_OUTPUTTER(Console)
-                /*
                 if (!strcmp(format, "console")) {
                     ADD_OUTPUTTER(Console)
-                } else if (!strcmp(format, "json")) {
-                    ADD_OUTPUTTER(Json)
+                } else if (!strcmp(format, "columnar")) {
+                    ADD_OUTPUTTER(Columnar)
+                    RetainSamples = true;
                 } else if (!strcmp(format, "junit")) {
                     ADD_OUTPUTTER(JUnitXml)
+                } else if (!strcmp(format, "csv")) {
+                    ADD_OUTPUTTER(Csv)
+                } else if (!strcmp(format, "tsv")) {
+                    ADD_OUTPUTTER(Tsv)
+                } else if (!strcmp(format, "csv-runs")) {
+                    ADD_OUTPUTTER(CsvRuns)
+                    RetainSamples = true;
+                } else if (!strcmp(format, "tsv-runs")) {
+                    ADD_OUTPUTTER(TsvRuns)
+                    RetainSamples = true;
+                } else if (!strcmp(format, "trace")) {
+                    ADD_OUTPUTTER(Trace)
+                    RecordTrace = true;
                 } else {
                     MAIN_USAGE_ERROR("invalid format: " << format);
                 }
-                */
 #undef ADD_OUTPUTTER
             } else if ((!strcmp(arg, "-c")) || (!strcmp(arg, "--color"))) {
                 if (argLast) {
@@ -289,9 +692,21 @@ public:
 
     /// Run the selected execution mode.
 
-    /// @returns the exit status code to be returned from the executable.
+    /// @returns the exit status code to be returned from the executable,
+    /// a failure if a benchmark violated its performance budget.
     int run()
     {
+        // Keep page faults out of the measurements.
+        if ((LockMemory) && (ExecutionMode != ::benchmark::MainListBenchmarks)) {
+            if (::mlockall(MCL_CURRENT | MCL_FUTURE) != 0) {
+                std::cerr << MAIN_FORMAT_ERROR("mlockall failed: " <<
+                                               strerror(errno) <<
+                                               " (see ulimit -l)")
+                          << std::endl;
+                return EXIT_FAILURE;
+            }
+        }
+
         // Execute based on the selected mode.
         switch (ExecutionMode) {
         case ::benchmark::MainRunBenchmarks:
@@ -300,6 +715,9 @@ public:
         case ::benchmark::MainListBenchmarks:
             return ListBenchmarks();
 
+        case ::benchmark::MainProfileBenchmark:
+            return ProfileBenchmark();
+
         default:
             std::cerr << MAIN_FORMAT_ERROR(
                 "invalid execution mode: " << ExecutionMode
@@ -308,14 +726,57 @@ public:
         }
     }
     private:
+        /// Parse an unsigned decimal number.
+
+        /// @returns true if the whole string is a valid number.
+        static bool ParseUnsigned(const char* text, unsigned long& value)
+        {
+            if ((!text) || (*text < '0') || (*text > '9')) {
+                return false;
+            }
+
+            char* end = NULL;
+            errno = 0;
+            value = strtoul(text, &end, 10);
+            return ((errno == 0) && (*end == 0));
+        }
+
+
         /// Run benchmarks.
 
-        /// @returns the exit status code to be returned from the executable.
+        /// @returns the exit status code to be returned from the executable,
+        /// a failure if a benchmark violated its performance budget.
         int RunBenchmarks()
         {
+            // Profile into fresh files. Repetitions append to the files
+            // their parent has cleared.
+            if (!ProfileDirectory.empty()) {
+                std::string error;
+                if (!::benchmark::SamplingProfiler::setOutputDirectory(
+                        ProfileDirectory, error)) {
+                    std::cerr << MAIN_FORMAT_ERROR(error) << std::endl;
+                    return EXIT_FAILURE;
+                }
+
+                if (RepetitionOutputFd < 0) {
+                    std::vector<const ::benchmark::TestDescriptor*> tests =
+                        ::benchmark::BenchMarker::listTests();
+                    for (std::size_t i = 0; i < tests.size(); ++i) {
+                        ::benchmark::SamplingProfiler::removeOutput(
+                            tests[i]->CanonicalName);
+                    }
+                }
+            }
+
+            // A repetition reports back to its parent only.
+            if (RepetitionOutputFd >= 0) {
+                return RunRepetition();
+            }
+
             // Hook up the outputs.
+            std::vector< ::benchmark::Outputter*> outputters;
             if (StdoutOutputter)
-                ::benchmark::BenchMarker::addOutputter(*StdoutOutputter);
+                outputters.push_back(StdoutOutputter);
 
             for (std::vector< ::benchmark::FileOutputter*>::iterator it =
                      FileOutputters.begin();
@@ -330,17 +791,147 @@ public:
                     return EXIT_FAILURE;
                 }
 
-                ::benchmark::BenchMarker::addOutputter(fileOutputter.outputter());
+                outputters.push_back(&fileOutputter.outputter());
+            }
+
+            // Describe the environment to every output.
+            const ::benchmark::Environment environment =
+                ::benchmark::Environment::probe();
+
+            if (Repetitions > 1) {
+                ::benchmark::ConsoleOutputter defaultOutputter;
+                if (outputters.empty())
+                    outputters.push_back(&defaultOutputter);
+
+                for (std::size_t i = 0; i < outputters.size(); ++i)
+                    outputters[i]->environment(environment);
+
+                ::benchmark::RepetitionRunner repetitionRunner(_arguments,
+                                                               Repetitions);
+                const bool success = repetitionRunner.run(outputters);
+                return (((success) &&
+                         (!::benchmark::BenchMarker::budgetViolations())) ?
+                        EXIT_SUCCESS :
+                        EXIT_FAILURE);
             }
 
+            for (std::size_t i = 0; i < outputters.size(); ++i)
+                ::benchmark::BenchMarker::addOutputter(*outputters[i]);
+
             // Run the benchmarks.
             if (ShuffleBenchmarks) {
                 std::srand(static_cast<unsigned>(std::time(0)));
                 ::benchmark::BenchMarker::shuffleTests();
             }
 
+            ::benchmark::BenchMarker::setEnvironment(environment);
+            ::benchmark::BenchMarker::setAsyncOutput(AsyncOutput);
+            ::benchmark::BenchMarker::setTracing(RecordTrace,
+                                                 TraceIterations);
+            ::benchmark::BenchMarker::setRetainSamples(RetainSamples);
+            ::benchmark::BenchMarker::setSoftwareCounters(SoftwareCounters);
+            ::benchmark::BenchMarker::setAllocationTracking(TrackAllocations);
+            ::benchmark::BenchMarker::setMemoryFootprint(MeasureMemory);
+            ::benchmark::BenchMarker::setCacheFlush(ColdCache);
+            ::benchmark::BenchMarker::setRealtime(RealtimeMeasures);
+            ::benchmark::BenchMarker::setPreemptionDetection(
+                DetectPreemption,
+                PreemptionRetries);
+            ::benchmark::BenchMarker::setFrequencyMeasurement(
+                MeasureFrequency,
+                NormalizeFrequency,
+                FrequencyThreshold);
+            ::benchmark::BenchMarker::setIsolation(Isolation, IsolationTimeout);
+            ::benchmark::BenchMarker::setParallelism(Jobs, Cpus, HistoryPath);
+            ::benchmark::BenchMarker::setPlacement(BenchmarkPlacement);
+            ::benchmark::BenchMarker::setLoad(LoadRates,
+                                              Duration,
+                                              LoadThreads);
             ::benchmark::BenchMarker::runAllTests();
 
+            // Violated performance budgets fail the run.
+            return (::benchmark::BenchMarker::budgetViolations() ?
+                    EXIT_FAILURE :
+                    EXIT_SUCCESS);
+        }
+
+
+        /// Run benchmarks as one repetition of a repetition parent.
+
+        /// Offsets the stack and heap by the amounts derived from the
+        /// layout seed and sends all results to the parent.
+        /// @returns the exit status code to be returned from the executable.
+        int RunRepetition()
+        {
+            ::benchmark::RepetitionOutputter outputter(RepetitionOutputFd);
+            ::benchmark::BenchMarker::addOutputter(outputter);
+
+            volatile char* stackPadding = static_cast<volatile char*>(
+                alloca(::benchmark::ProcessLayout::stackPadding() + 1)
+            );
+            stackPadding[0] = 0;
+
+            char* heapPadding = static_cast<char*>(
+                malloc(::benchmark::ProcessLayout::heapPadding() + 1)
+            );
+
+            if (ShuffleBenchmarks) {
+                std::srand(static_cast<unsigned>(std::time(0)));
+                ::benchmark::BenchMarker::shuffleTests();
+            }
+
+            ::benchmark::BenchMarker::setTracing(RecordTrace,
+                                                 TraceIterations);
+            ::benchmark::BenchMarker::setRetainSamples(RetainSamples);
+            ::benchmark::BenchMarker::setSoftwareCounters(SoftwareCounters);
+            ::benchmark::BenchMarker::setAllocationTracking(TrackAllocations);
+            ::benchmark::BenchMarker::setMemoryFootprint(MeasureMemory);
+            ::benchmark::BenchMarker::setCacheFlush(ColdCache);
+            ::benchmark::BenchMarker::setRealtime(RealtimeMeasures);
+            ::benchmark::BenchMarker::setPreemptionDetection(
+                DetectPreemption,
+                PreemptionRetries);
+            ::benchmark::BenchMarker::setFrequencyMeasurement(
+                MeasureFrequency,
+                NormalizeFrequency,
+                FrequencyThreshold);
+            ::benchmark::BenchMarker::setIsolation(Isolation, IsolationTimeout);
+            ::benchmark::BenchMarker::setParallelism(Jobs, Cpus, HistoryPath);
+            ::benchmark::BenchMarker::setPlacement(BenchmarkPlacement);
+            ::benchmark::BenchMarker::setLoad(LoadRates,
+                                              Duration,
+                                              LoadThreads);
+
+            try {
+                ::benchmark::BenchMarker::runAllTests();
+            } catch (std::exception& e) {
+                std::cerr << MAIN_FORMAT_ERROR(e.what()) << std::endl;
+                free(heapPadding);
+                return EXIT_FAILURE;
+            }
+
+            free(heapPadding);
+            return EXIT_SUCCESS;
+        }
+
+
+        /// Loop one benchmark for an external profiler.
+
+        /// @returns the exit status code to be returned from the executable.
+        int ProfileBenchmark()
+        {
+            ::benchmark::BenchMarker::setPlacement(BenchmarkPlacement);
+            ::benchmark::BenchMarker::setRealtime(RealtimeMeasures);
+
+            std::string failure;
+            if (!::benchmark::BenchMarker::runSteadyState(ProfiledBenchmark,
+                                                          Duration,
+                                                          ProfileMarkers,
+                                                          std::cout,
+                                                          failure)) {
+                std::cerr << MAIN_FORMAT_ERROR(failure) << std::endl;
+                return EXIT_FAILURE;
+            }
             return EXIT_SUCCESS;
         }
 
@@ -413,6 +1004,13 @@ public:
                       << "    matches any substring; ':' separates two "
                       << "patterns."
                       << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--regex")
+                      << " <" << MAIN_FORMAT_ARGUMENT("expression") << ">"
+                      << std::endl
+                      << "    Run only the tests whose name contains a match "
+                      << "of the POSIX extended" << std::endl
+                      << "    regular expression. Anchor it with '^' and '$' "
+                      << "to match whole names." << std::endl
 
                       << "Benchmark execution options:" << std::endl
                       << "  " << MAIN_FORMAT_FLAG("-s") << ", "
@@ -420,6 +1018,223 @@ public:
                       << std::endl
                       << "    Randomize benchmark execution order."
                       << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--retain-samples")
+                      << std::endl
+                      << "    Keep every raw run time in the results. By "
+                      << "default only streaming" << std::endl
+                      << "    statistics are kept, so memory use does not "
+                      << "grow with the run count." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--software-counters")
+                      << std::endl
+                      << "    Report page faults, context switches and, "
+                      << "where perf events are" << std::endl
+                      << "    permitted, system calls per iteration of the "
+                      << "benchmark thread." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--track-allocations")
+                      << std::endl
+                      << "    Count heap allocations, frees and bytes in the "
+                      << "timed region and" << std::endl
+                      << "    report them per iteration with the peak live "
+                      << "bytes of each run." << std::endl
+                      << "    Requires building with "
+                      << "BENCHMARK_ALLOCATION_HOOKS." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--realtime") << std::endl
+                      << "    While measuring, run at SCHED_FIFO priority, "
+                      << "set a 1 ns timer slack" << std::endl
+                      << "    and move onto an isolcpus/nohz_full CPU where "
+                      << "permitted. The applied" << std::endl
+                      << "    measures are recorded as result metadata."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--realtime-priority")
+                      << " <" << MAIN_FORMAT_ARGUMENT("priority") << ">"
+                      << std::endl
+                      << "    SCHED_FIFO priority from 1 to 99 for "
+                      << MAIN_FORMAT_FLAG("--realtime") << ". Default 50."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--detect-preemption")
+                      << std::endl
+                      << "    Count runs that were preempted or migrated to "
+                      << "another CPU." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--retry-preempted")
+                      << " <" << MAIN_FORMAT_ARGUMENT("count") << ">"
+                      << std::endl
+                      << "    Discard up to <count> preempted or migrated runs "
+                      << "per benchmark and run" << std::endl
+                      << "    them again. Implies "
+                      << MAIN_FORMAT_FLAG("--detect-preemption") << "."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--frequency") << std::endl
+                      << "    Measure the effective CPU frequency of every run "
+                      << "with perf or the" << std::endl
+                      << "    APERF/MPERF registers, and flag runs deviating "
+                      << "from the median." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--normalize-frequency")
+                      << std::endl
+                      << "    Scale run times to the nominal CPU frequency. "
+                      << "Implies " << MAIN_FORMAT_FLAG("--frequency") << "."
+                      << std::endl
+                      << "    Skipped where only user space cycles can be "
+                      << "counted." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--frequency-threshold")
+                      << " <" << MAIN_FORMAT_ARGUMENT("percent") << ">"
+                      << std::endl
+                      << "    Deviation from the median frequency at which "
+                      << "runs are flagged." << std::endl
+                      << "    Default 5. Implies "
+                      << MAIN_FORMAT_FLAG("--frequency") << "." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--async-output") << std::endl
+                      << "    Format and write the output on a background "
+                      << "thread instead of between" << std::endl
+                      << "    benchmarks. Ignored with "
+                      << MAIN_FORMAT_FLAG("--track-allocations") << "."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--trace-iterations")
+                      << " <" << MAIN_FORMAT_ARGUMENT("count") << ">"
+                      << std::endl
+                      << "    Add every <count>th iteration of a run to the "
+                      << MAIN_FORMAT_ARGUMENT("trace") << " output. The"
+                      << std::endl
+                      << "    sampled iterations are timed on their own, "
+                      << "which adds to the run time." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--mlockall") << std::endl
+                      << "    Lock all current and future memory of the "
+                      << "process, so steady-state" << std::endl
+                      << "    runs take no major page faults. Needs a "
+                      << "sufficient ulimit -l." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--cold-cache")
+                      << " <" << MAIN_FORMAT_ARGUMENT("runs|iterations")
+                      << ">" << std::endl
+                      << "    Evict the data caches before every run, after "
+                      << "set up, or before" << std::endl
+                      << "    every iteration, outside the timed region. "
+                      << "Iterations are then" << std::endl
+                      << "    timed one by one." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--flush-code") << std::endl
+                      << "    Also execute a large code region to evict the "
+                      << "instruction caches." << std::endl
+                      << "    Implies " << MAIN_FORMAT_FLAG("--cold-cache")
+                      << " runs unless given." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--memory")
+                      << std::endl
+                      << "    Report the RSS delta and peak RSS of every run, "
+                      << "and bytes per element" << std::endl
+                      << "    for benchmarks reporting an element count. "
+                      << "Combine with" << std::endl
+                      << "    " << MAIN_FORMAT_FLAG("--isolate-runs")
+                      << " so memory kept by the allocator does not carry "
+                      << "over." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--profile")
+                      << " <" << MAIN_FORMAT_ARGUMENT("directory") << ">"
+                      << std::endl
+                      << "    Sample call stacks while the timed region of "
+                      << "each benchmark runs and" << std::endl
+                      << "    write them as folded stacks to "
+                      << "<directory>/<benchmark>.folded for" << std::endl
+                      << "    flame graphs. Link with -rdynamic for "
+                      << "function names." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--profile-mode")
+                      << " <" << MAIN_FORMAT_ARGUMENT("benchmark") << ">"
+                      << std::endl
+                      << "    Skip calibration, set up the benchmark once and "
+                      << "loop its body for" << std::endl
+                      << "    the --duration, for an external profiler."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--perf-ctl")
+                      << " <" << MAIN_FORMAT_ARGUMENT("fifo") << ">[,<"
+                      << MAIN_FORMAT_ARGUMENT("ack-fifo") << ">]" << std::endl
+                      << "    Send enable and disable to perf record --control "
+                      << "around the steady" << std::endl
+                      << "    state of --profile-mode. Run perf with "
+                      << "--delay=-1." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--pause") << std::endl
+                      << "    Stop before the steady state of --profile-mode "
+                      << "until SIGCONT, so a" << std::endl
+                      << "    profiler can attach." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--isolate")
+                      << std::endl
+                      << "    Run each benchmark in a forked child process. "
+                      << "Crashing or hanging" << std::endl
+                      << "    benchmarks are reported as failed instead of "
+                      << "aborting the suite." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--isolate-runs")
+                      << std::endl
+                      << "    Like " << MAIN_FORMAT_FLAG("--isolate")
+                      << ", but fork a new child for every run."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--isolate-timeout")
+                      << " <" << MAIN_FORMAT_ARGUMENT("seconds") << ">"
+                      << std::endl
+                      << "    Kill isolated children running longer than "
+                      << "this. 0 disables the limit." << std::endl
+                      << "    Default 300." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--repetitions")
+                      << " <" << MAIN_FORMAT_ARGUMENT("count") << ">"
+                      << std::endl
+                      << "    Execute the benchmark binary this many times, "
+                      << "each with a randomized" << std::endl
+                      << "    environment size, stack and heap offset and "
+                      << "address space layout," << std::endl
+                      << "    and aggregate the results. Variance between "
+                      << "processes is reported" << std::endl
+                      << "    separately from variance within a process."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("-j") << ", "
+                      << MAIN_FORMAT_FLAG("--jobs")
+                      << " <" << MAIN_FORMAT_ARGUMENT("count") << ">"
+                      << std::endl
+                      << "    Run this many benchmarks concurrently, each in "
+                      << "an isolated child pinned" << std::endl
+                      << "    to its own core. Cores sharing an L2 cache or "
+                      << "SMT siblings are only" << std::endl
+                      << "    used when there are not enough others. Output "
+                      << "order is unaffected." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--cpus")
+                      << " <" << MAIN_FORMAT_ARGUMENT("list") << ">"
+                      << std::endl
+                      << "    CPUs to run concurrent benchmarks on, e.g. "
+                      << "0-15,32. Default all" << std::endl
+                      << "    allowed CPUs." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--cpu")
+                      << " <" << MAIN_FORMAT_ARGUMENT("list") << ">"
+                      << std::endl
+                      << "    Pin the runner and benchmark threads to these "
+                      << "CPUs, e.g. 2-3. Per-benchmark" << std::endl
+                      << "    options take precedence." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--numa-node")
+                      << " <" << MAIN_FORMAT_ARGUMENT("node") << ">"
+                      << std::endl
+                      << "    Run on the CPUs of this NUMA node and allocate "
+                      << "fixture memory from it." << std::endl
+                      << "    The placement is recorded with every result."
+                      << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--rate")
+                      << " <" << MAIN_FORMAT_ARGUMENT("rates") << ">"
+                      << std::endl
+                      << "    Offer open-loop load at each of these rates, "
+                      << "e.g. 50k/s,100k/s,200k/s," << std::endl
+                      << "    instead of timing back-to-back runs. Latency "
+                      << "is measured from the" << std::endl
+                      << "    intended start of each call, so queueing "
+                      << "delay is included. One" << std::endl
+                      << "    result is reported per rate." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--duration")
+                      << " <" << MAIN_FORMAT_ARGUMENT("time") << ">"
+                      << std::endl
+                      << "    Time to offer each rate for, or to loop the "
+                      << "profiled benchmark for," << std::endl
+                      << "    e.g. 30s or 500ms. Default 10s." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--load-threads")
+                      << " <" << MAIN_FORMAT_ARGUMENT("count") << ">"
+                      << std::endl
+                      << "    Number of threads issuing calls at the "
+                      << "offered rate. Default 1." << std::endl
+                      << "  " << MAIN_FORMAT_FLAG("--history")
+                      << " <" << MAIN_FORMAT_ARGUMENT("path") << ">"
+                      << std::endl
+                      << "    File of benchmark durations from earlier runs. "
+                      << "Concurrent benchmarks" << std::endl
+                      << "    are started longest first; the file is updated "
+                      << "afterwards." << std::endl
                       << std::endl
 
                       << "Benchmark output options:" << std::endl
@@ -438,13 +1253,30 @@ public:
                       << "    " << MAIN_FORMAT_ARGUMENT("console")
                       << std::endl
                       << "      Standard console output." << std::endl
-                      << "    " << MAIN_FORMAT_ARGUMENT("json")
+                      << "    " << MAIN_FORMAT_ARGUMENT("columnar")
                       << std::endl
-                      << "      JSON." << std::endl
+                      << "      Memory-mappable binary format keeping raw run "
+                      << "times, see" << std::endl
+                      << "      benchmark_convert for converting it to JSON "
+                      << "or CSV. Implies" << std::endl
+                      << "      " << MAIN_FORMAT_FLAG("--retain-samples")
+                      << "." << std::endl
                       << "    " << MAIN_FORMAT_ARGUMENT("junit")
                       << std::endl
-                      << "      JUnit-compatible XML (very restrictive.)"
-                      << std::endl
+                      << "      JUnit-compatible XML. Benchmarks exceeding "
+                      << "their budget are failures." << std::endl
+                      << "    " << MAIN_FORMAT_ARGUMENT("csv") << ", "
+                      << MAIN_FORMAT_ARGUMENT("tsv") << std::endl
+                      << "      One row per benchmark with every statistic and "
+                      << "a column per parameter." << std::endl
+                      << "    " << MAIN_FORMAT_ARGUMENT("csv-runs") << ", "
+                      << MAIN_FORMAT_ARGUMENT("tsv-runs") << std::endl
+                      << "      One row per run with its raw run time. Implies "
+                      << MAIN_FORMAT_FLAG("--retain-samples") << "." << std::endl
+                      << "    " << MAIN_FORMAT_ARGUMENT("trace") << std::endl
+                      << "      Chrome trace-event JSON of calibration, "
+                      << "set up, runs and tear down" << std::endl
+                      << "      per thread, for ui.perfetto.dev." << std::endl
                       << std::endl
                       << "    If multiple output formats are provided without "
                       << "a path, only the last" << std::endl
@@ -473,6 +1305,8 @@ public:
                       << ::benchmark::Clock::description()
                       << std::endl;
         }
+    private:
+        std::vector<std::string> _arguments; ///< Arguments for repetitions.
     };
 
 
@@ -0,0 +1,418 @@
+#ifndef BENCHMARK_COLUMNAR_FORMAT_H_
+#define BENCHMARK_COLUMNAR_FORMAT_H_
+#include <cerrno>
+#include <cstddef>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+namespace benchmark {
+
+/// Columnar binary results file.
+
+/// A file consists of a header followed by five sections, each starting
+/// at a multiple of 8 bytes:
+///
+/// - strings: NUL-terminated strings referred to by their byte offset.
+///   Offset 0 is the empty string.
+/// - entries: key and value string pairs. The first EnvironmentCount
+///   entries describe the environment, the others are test metadata.
+/// - tests: one fixed-width ColumnarTest record per test.
+/// - counters: fixed-width ColumnarCounter records, by test.
+/// - samples: run times in nanoseconds as doubles, by test.
+///
+/// All values are in the byte order of the writing machine, recorded in
+/// the header. Since every section is aligned, a mapped file is read in
+/// place without parsing or copying.
+namespace ColumnarFormat {
+    /// Magic bytes at the start of a file.
+    static const char Magic[8] = { 'B', 'E', 'N', 'C', 'H', 'C', 'O', 'L' };
+
+
+    /// Version of the layout.
+    static const uint32_t Version = 1;
+
+
+    /// Byte order mark as written by the writing machine.
+    static const uint32_t ByteOrder = 0x01020304;
+}
+
+
+/// Header of a columnar results file.
+struct ColumnarHeader {
+    char      Magic[8];
+    uint32_t  Version;
+    uint32_t  ByteOrder;
+    uint64_t  FileBytes;
+    uint64_t  StringsOffset;
+    uint64_t  StringsBytes;
+    uint64_t  EntriesOffset;
+    uint64_t  EntriesCount;
+    uint64_t  EnvironmentCount;
+    uint64_t  TestsOffset;
+    uint64_t  TestsCount;
+    uint64_t  CountersOffset;
+    uint64_t  CountersCount;
+    uint64_t  SamplesOffset;
+    uint64_t  SamplesCount;
+};
+
+
+/// Outcome of a test in a columnar results file.
+enum ColumnarStatus {
+    /// The test was measured.
+    ColumnarMeasured = 0,
+
+
+    /// The test is disabled and was skipped.
+    ColumnarDisabled = 1,
+
+
+    /// The test did not produce a result.
+    ColumnarFailed = 2
+};
+
+
+/// Key and value of an environment property or test metadata.
+struct ColumnarEntry {
+    uint32_t  Key;
+    uint32_t  Value;
+};
+
+
+/// Test record of a columnar results file.
+
+/// Run time statistics are in nanoseconds per run. Samples are only
+/// present if raw run times were retained.
+struct ColumnarTest {
+    uint32_t  Fixture;
+    uint32_t  Name;
+    uint32_t  Parameters;
+    uint32_t  Status;
+    uint32_t  Reason;
+    uint32_t  Reserved;
+    uint64_t  Runs;
+    uint64_t  Iterations;
+    uint64_t  DisturbedRuns;
+    uint64_t  RejectedRuns;
+    double    Mean;
+    double    StdDev;
+    double    Median;
+    double    Quartile1;
+    double    Quartile3;
+    double    Minimum;
+    double    Maximum;
+    uint64_t  FirstEntry;
+    uint64_t  EntriesCount;
+    uint64_t  FirstCounter;
+    uint64_t  CountersCount;
+    uint64_t  FirstSample;
+    uint64_t  SamplesCount;
+};
+
+
+/// Counter record of a columnar results file.
+struct ColumnarCounter {
+    uint32_t  Name;
+    uint32_t  Reserved;
+    uint64_t  Count;
+    double    Mean;
+    double    StdDev;
+    double    Median;
+    double    Minimum;
+    double    Maximum;
+};
+
+
+/// Reader of columnar results files.
+
+/// Validates the layout once and then hands out pointers into the data,
+/// so even files with millions of samples are available immediately:
+///
+///     ColumnarResults results("soak.bcol");
+///     for (std::size_t i = 0; i < results.testCount(); ++i) {
+///         const ColumnarTest& test = results.test(i);
+///         const double* samples = results.samples(test);
+///         ...
+///     }
+///
+/// Failures throw std::runtime_error.
+class ColumnarResults {
+public:
+    /// Map a results file.
+    ColumnarResults(const std::string& path)
+        :   _mapping(NULL),
+            _mappingBytes(0),
+            _data(NULL),
+            _bytes(0),
+            _header(NULL)
+    {
+        const int fd = ::open(path.c_str(), O_RDONLY);
+        if (fd < 0) {
+            throw std::runtime_error("failed to open " + path + ": " +
+                                     strerror(errno));
+        }
+
+        struct stat status;
+        if (::fstat(fd, &status) != 0) {
+            const std::string reason = strerror(errno);
+            ::close(fd);
+            throw std::runtime_error("failed to stat " + path + ": " +
+                                     reason);
+        }
+
+        _mappingBytes = std::size_t(status.st_size);
+        if (_mappingBytes) {
+            _mapping = ::mmap(NULL,
+                              _mappingBytes,
+                              PROT_READ,
+                              MAP_PRIVATE,
+                              fd,
+                              0);
+        }
+        const std::string reason = strerror(errno);
+        ::close(fd);
+
+        if (_mapping == MAP_FAILED) {
+            _mapping = NULL;
+            throw std::runtime_error("failed to map " + path + ": " +
+                                     reason);
+        }
+
+        _data = static_cast<const char*>(_mapping);
+        _bytes = _mappingBytes;
+        try {
+            validate();
+        } catch (...) {
+            unmap();
+            throw;
+        }
+    }
+
+
+    /// Read results already in memory.
+
+    /// @param data Start of the results. Aligned to 8 bytes and expected
+    /// to be available during the life time of the reader.
+    /// @param bytes Size of the results.
+    ColumnarResults(const char* data, std::size_t bytes)
+        :   _mapping(NULL),
+            _mappingBytes(0),
+            _data(data),
+            _bytes(bytes),
+            _header(NULL)
+    {
+        validate();
+    }
+
+
+    ~ColumnarResults()
+    {
+        unmap();
+    }
+
+
+    /// Header of the results.
+    inline const ColumnarHeader& header() const
+    {
+        return *_header;
+    }
+
+
+    /// Number of environment properties.
+    inline std::size_t environmentCount() const
+    {
+        return std::size_t(_header->EnvironmentCount);
+    }
+
+
+    /// Environment property.
+    inline const ColumnarEntry& environment(std::size_t index) const
+    {
+        return entries()[index];
+    }
+
+
+    /// Number of tests.
+    inline std::size_t testCount() const
+    {
+        return std::size_t(_header->TestsCount);
+    }
+
+
+    /// Test record.
+    inline const ColumnarTest& test(std::size_t index) const
+    {
+        return tests()[index];
+    }
+
+
+    /// String at an offset into the string table.
+    inline const char* string(uint32_t offset) const
+    {
+        if (offset >= _header->StringsBytes) {
+            throw std::runtime_error("string offset out of range");
+        }
+        return _data + _header->StringsOffset + offset;
+    }
+
+
+    /// Metadata of a test.
+    inline const ColumnarEntry* metadata(const ColumnarTest& test) const
+    {
+        return entries() + test.FirstEntry;
+    }
+
+
+    /// Counters of a test.
+    inline const ColumnarCounter* counters(const ColumnarTest& test) const
+    {
+        return reinterpret_cast<const ColumnarCounter*>(
+            _data + _header->CountersOffset) + test.FirstCounter;
+    }
+
+
+    /// Run times of a test in nanoseconds.
+    inline const double* samples(const ColumnarTest& test) const
+    {
+        return reinterpret_cast<const double*>(
+            _data + _header->SamplesOffset) + test.FirstSample;
+    }
+private:
+    inline const ColumnarEntry* entries() const
+    {
+        return reinterpret_cast<const ColumnarEntry*>(
+            _data + _header->EntriesOffset);
+    }
+
+
+    inline const ColumnarTest* tests() const
+    {
+        return reinterpret_cast<const ColumnarTest*>(
+            _data + _header->TestsOffset);
+    }
+
+
+    /// Check that a section lies within the data and is aligned.
+    void checkSection(uint64_t offset,
+                      uint64_t count,
+                      uint64_t size,
+                      const char* name) const
+    {
+        if ((offset % 8) ||
+            (offset > _bytes) ||
+            (count > (_bytes - offset) / size)) {
+            throw std::runtime_error(std::string("invalid ") + name +
+                                     " section in columnar results");
+        }
+    }
+
+
+    /// Check that a range of records lies within a section.
+    static void checkRange(uint64_t first,
+                           uint64_t count,
+                           uint64_t total,
+                           const char* name)
+    {
+        if ((first > total) || (count > total - first)) {
+            throw std::runtime_error(std::string("invalid ") + name +
+                                     " range in columnar results");
+        }
+    }
+
+
+    void validate()
+    {
+        if ((_bytes < sizeof(ColumnarHeader)) ||
+            (reinterpret_cast<uintptr_t>(_data) % 8) ||
+            (::memcmp(_data, ColumnarFormat::Magic, 8))) {
+            throw std::runtime_error("not a columnar results file");
+        }
+
+        _header = reinterpret_cast<const ColumnarHeader*>(_data);
+        if (_header->ByteOrder != ColumnarFormat::ByteOrder) {
+            throw std::runtime_error("columnar results were written with a "
+                                     "different byte order");
+        }
+        if (_header->Version != ColumnarFormat::Version) {
+            throw std::runtime_error("unsupported columnar results version");
+        }
+        if (_header->FileBytes != _bytes) {
+            throw std::runtime_error("columnar results are truncated");
+        }
+
+        checkSection(_header->StringsOffset,
+                     _header->StringsBytes,
+                     1,
+                     "strings");
+        checkSection(_header->EntriesOffset,
+                     _header->EntriesCount,
+                     sizeof(ColumnarEntry),
+                     "entries");
+        checkSection(_header->TestsOffset,
+                     _header->TestsCount,
+                     sizeof(ColumnarTest),
+                     "tests");
+        checkSection(_header->CountersOffset,
+                     _header->CountersCount,
+                     sizeof(ColumnarCounter),
+                     "counters");
+        checkSection(_header->SamplesOffset,
+                     _header->SamplesCount,
+                     sizeof(double),
+                     "samples");
+
+        // Strings must not run past the table.
+        if ((!_header->StringsBytes) ||
+            (_data[_header->StringsOffset + _header->StringsBytes - 1])) {
+            throw std::runtime_error("invalid strings section in columnar "
+                                     "results");
+        }
+
+        checkRange(0,
+                   _header->EnvironmentCount,
+                   _header->EntriesCount,
+                   "environment");
+        for (std::size_t i = 0; i < testCount(); ++i) {
+            const ColumnarTest& t = test(i);
+            checkRange(t.FirstEntry,
+                       t.EntriesCount,
+                       _header->EntriesCount,
+                       "metadata");
+            checkRange(t.FirstCounter,
+                       t.CountersCount,
+                       _header->CountersCount,
+                       "counter");
+            checkRange(t.FirstSample,
+                       t.SamplesCount,
+                       _header->SamplesCount,
+                       "sample");
+        }
+    }
+
+
+    void unmap()
+    {
+        if (_mapping) {
+            ::munmap(_mapping, _mappingBytes);
+            _mapping = NULL;
+        }
+    }
+private:
+    ColumnarResults(const ColumnarResults&);
+    ColumnarResults& operator =(const ColumnarResults&);
+private:
+    void                  *_mapping;
+    std::size_t            _mappingBytes;
+    const char            *_data;
+    std::size_t            _bytes;
+    const ColumnarHeader  *_header;
+};
+
+}
+#endif
@@ -0,0 +1,283 @@
+#ifndef BENCHMARK_COLUMNAR_OUTPUTTER_H_
+#define BENCHMARK_COLUMNAR_OUTPUTTER_H_
+#include <cstring>
+#include <map>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <benchmark/columnar_format.h>
+#include <benchmark/outputter.h>
+
+namespace benchmark {
+
+/// Writes results in the columnar binary format.
+
+/// Results are collected in memory and the file is written as a whole at
+/// end(), since the sections follow each other. Read it back with
+/// ColumnarResults.
+class ColumnarOutputter : public Outputter {
+public:
+    ColumnarOutputter(std::ostream& stream = std::cout)
+        :   _stream(stream)
+    {
+        // Offset 0 is the empty string.
+        _strings.push_back('\0');
+        _stringOffsets[std::string()] = 0;
+    }
+
+
+    virtual void environment(const Environment& environment)
+    {
+        for (std::size_t i = 0; i < environment.Properties.size(); ++i) {
+            ColumnarEntry entry;
+            entry.Key = intern(environment.Properties[i].first);
+            entry.Value = intern(environment.Properties[i].second);
+            _environment.push_back(entry);
+        }
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        // Environment entries come first.
+        std::vector<ColumnarEntry> entries(_environment);
+        entries.insert(entries.end(), _metadata.begin(), _metadata.end());
+        for (std::size_t i = 0; i < _tests.size(); ++i) {
+            _tests[i].FirstEntry += _environment.size();
+        }
+
+        ColumnarHeader header;
+        ::memset(&header, 0, sizeof(header));
+        ::memcpy(header.Magic, ColumnarFormat::Magic, sizeof(header.Magic));
+        header.Version = ColumnarFormat::Version;
+        header.ByteOrder = ColumnarFormat::ByteOrder;
+
+        uint64_t offset = aligned(sizeof(header));
+        header.StringsOffset = offset;
+        header.StringsBytes = _strings.size();
+        offset = aligned(offset + header.StringsBytes);
+        header.EntriesOffset = offset;
+        header.EntriesCount = entries.size();
+        header.EnvironmentCount = _environment.size();
+        offset = aligned(offset + entries.size() * sizeof(ColumnarEntry));
+        header.TestsOffset = offset;
+        header.TestsCount = _tests.size();
+        offset = aligned(offset + _tests.size() * sizeof(ColumnarTest));
+        header.CountersOffset = offset;
+        header.CountersCount = _counters.size();
+        offset = aligned(offset + _counters.size() * sizeof(ColumnarCounter));
+        header.SamplesOffset = offset;
+        header.SamplesCount = _samples.size();
+        header.FileBytes = offset + _samples.size() * sizeof(double);
+
+        uint64_t written = 0;
+        write(&header, sizeof(header), written);
+        pad(header.StringsOffset, written);
+        write(_strings.data(), _strings.size(), written);
+        pad(header.EntriesOffset, written);
+        writeArray(entries, written);
+        pad(header.TestsOffset, written);
+        writeArray(_tests, written);
+        pad(header.CountersOffset, written);
+        writeArray(_counters, written);
+        pad(header.SamplesOffset, written);
+        writeArray(_samples, written);
+        _stream.flush();
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+        ColumnarTest& test = addTest(fixtureName,
+                                     testName,
+                                     parameters,
+                                     ColumnarMeasured);
+        test.Runs = result.runs();
+        test.Iterations = result.iterations();
+        test.DisturbedRuns = result.disturbedRuns();
+        test.RejectedRuns = result.rejectedRuns();
+        test.Mean = result.runTimeAverage();
+        test.StdDev = result.runTimeStdDev();
+        test.Median = result.runTimeMedian();
+        test.Quartile1 = result.runTimeQuartile1();
+        test.Quartile3 = result.runTimeQuartile3();
+        test.Minimum = result.runTimeMinimum();
+        test.Maximum = result.runTimeMaximum();
+
+        const ResultMetadata& metadata = result.metadata();
+        test.FirstEntry = _metadata.size();
+        test.EntriesCount = metadata.size();
+        for (std::size_t i = 0; i < metadata.size(); ++i) {
+            ColumnarEntry entry;
+            entry.Key = intern(metadata[i].first);
+            entry.Value = intern(metadata[i].second);
+            _metadata.push_back(entry);
+        }
+
+        const ResultCounters& counters = result.counters();
+        test.FirstCounter = _counters.size();
+        test.CountersCount = counters.size();
+        for (ResultCounters::const_iterator it = counters.begin();
+             it != counters.end();
+             ++it) {
+            ColumnarCounter counter;
+            ::memset(&counter, 0, sizeof(counter));
+            counter.Name = intern(it->first);
+            counter.Count = it->second.count();
+            counter.Mean = it->second.mean();
+            counter.StdDev = it->second.moments().stdDev();
+            counter.Median = it->second.quantile(0.5);
+            counter.Minimum = it->second.minimum();
+            counter.Maximum = it->second.maximum();
+            _counters.push_back(counter);
+        }
+
+        const std::vector<double>& samples = result.runTimes();
+        test.FirstSample = _samples.size();
+        test.SamplesCount = samples.size();
+        _samples.insert(_samples.end(), samples.begin(), samples.end());
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+        ColumnarTest& test = addTest(fixtureName,
+                                     testName,
+                                     parameters,
+                                     ColumnarDisabled);
+        test.Runs = runsCount;
+        test.Iterations = iterationsCount;
+    }
+
+
+    virtual void failTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          const std::string& reason)
+    {
+        ColumnarTest& test = addTest(fixtureName,
+                                     testName,
+                                     parameters,
+                                     ColumnarFailed);
+        test.Reason = intern(reason);
+    }
+private:
+    /// Add a test record with its names and no results.
+    ColumnarTest& addTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          ColumnarStatus status)
+    {
+        ColumnarTest test;
+        ::memset(&test, 0, sizeof(test));
+        test.Fixture = intern(fixtureName);
+        test.Name = intern(testName);
+        test.Status = status;
+
+        // Parameters as "declaration = value, ...".
+        std::string formatted;
+        const std::vector<TestParameterDescriptor>& descs =
+            parameters.Parameters();
+        for (std::size_t i = 0; i < descs.size(); ++i) {
+            if (i) {
+                formatted += ", ";
+            }
+            formatted += descs[i].Declaration + " = " + descs[i].Value;
+        }
+        test.Parameters = intern(formatted);
+
+        test.FirstEntry = _metadata.size();
+        test.FirstCounter = _counters.size();
+        test.FirstSample = _samples.size();
+        _tests.push_back(test);
+        return _tests.back();
+    }
+
+
+    /// Offset of a string in the string table, adding it if new.
+    uint32_t intern(const std::string& value)
+    {
+        std::map<std::string, uint32_t>::const_iterator it =
+            _stringOffsets.find(value);
+        if (it != _stringOffsets.end()) {
+            return it->second;
+        }
+
+        if (_strings.size() + value.size() + 1 > uint32_t(-1)) {
+            throw std::runtime_error("too many strings for columnar results");
+        }
+        const uint32_t offset = uint32_t(_strings.size());
+        _strings.append(value.c_str(), value.size() + 1);
+        _stringOffsets[value] = offset;
+        return offset;
+    }
+
+
+    static inline uint64_t aligned(uint64_t offset)
+    {
+        return (offset + 7) / 8 * 8;
+    }
+
+
+    void write(const void* data, std::size_t bytes, uint64_t& written)
+    {
+        _stream.write(static_cast<const char*>(data),
+                      std::streamsize(bytes));
+        written += bytes;
+    }
+
+
+    template<typename T>
+    void writeArray(const std::vector<T>& values, uint64_t& written)
+    {
+        if (!values.empty()) {
+            write(&values[0], values.size() * sizeof(T), written);
+        }
+    }
+
+
+    /// Pad with zeros up to an offset.
+    void pad(uint64_t offset, uint64_t& written)
+    {
+        static const char zeros[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+        write(zeros, std::size_t(offset - written), written);
+    }
+private:
+    std::ostream                     &_stream;
+    std::string                       _strings;
+    std::map<std::string, uint32_t>   _stringOffsets;
+    std::vector<ColumnarEntry>        _environment;
+    std::vector<ColumnarEntry>        _metadata;
+    std::vector<ColumnarTest>         _tests;
+    std::vector<ColumnarCounter>      _counters;
+    std::vector<double>               _samples;
+};
+
+}
+#endif
@@ -14,6 +14,16 @@ public:
     }
 
 
+    virtual void environment(const Environment& environment)
+    {
+        for (std::size_t i = 0; i < environment.Warnings.size(); ++i) {
+            _stream << Console::TextYellow << "[ WARNING  ] "
+                    << Console::TextDefault << environment.Warnings[i]
+                    << std::endl;
+        }
+    }
+
+
     virtual void begin(const std::size_t& enabledCount,
                         const std::size_t& disabledCount)
     {
@@ -115,12 +125,24 @@ public:
         }
 
 
+        virtual void failTest(const std::string& fixtureName,
+                              const std::string& testName,
+                              const TestParametersDescriptor& parameters,
+                              const std::string& reason)
+        {
+            _stream << Console::TextRed << "[  FAILED  ]"
+                    << Console::TextYellow << " ";
+            writeTestNameToStream(_stream, fixtureName, testName, parameters);
+            _stream << Console::TextDefault << ": " << reason << std::endl;
+        }
+
+
         virtual void endTest(const std::string& fixtureName,
                              const std::string& testName,
                              const TestParametersDescriptor& parameters,
                              const TestResult& result)
         {
-#define PAD(x) _stream << std::setw(34) << x << std::endl;
+#define PAD(x) _stream << std::setw(34) << x << '\n';
 #define PAD_DEVIATION(description,                                      \
                       deviated,                                         \
                       average,                                          \
@@ -166,7 +188,7 @@ public:
             _stream << Console::TextDefault << " ("
                     << std::setprecision(6)
                     << (result.timeTotal() / 1000000.0) << " ms)"
-                    << std::endl;
+                    << '\n';
 
             _stream << Console::TextBlue << "[   RUNS   ] "
                     << Console::TextDefault
@@ -176,7 +198,7 @@ public:
                     << "(" << Console::TextBlue << "~"
                     << result.runTimeStdDev() / 1000.0 << " us"
                     << Console::TextDefault << ")"
-                    << std::endl;
+                    << '\n';
 
             PAD_DEVIATION_INVERSE("Fastest time: ",
                                   (result.runTimeMinimum() / 1000.0),
@@ -193,6 +215,15 @@ public:
                 result.runTimeQuartile3() / 1000.0 << " us" <<
                 Console::TextDefault << ")");
 
+            if (result.processes() > 1) {
+                PAD("Between processes: " <<
+                    result.betweenProcessStdDev() / 1000.0 << " us (" <<
+                    Console::TextCyan << "within a process: " <<
+                    result.withinProcessStdDev() / 1000.0 << " us, " <<
+                    result.processes() << " processes" <<
+                    Console::TextDefault << ")");
+            }
+
             _stream << std::setprecision(5);
 
             PAD("");
@@ -222,7 +253,7 @@ public:
                     << "(" << Console::TextBlue << "~"
                     << result.iterationTimeStdDev() / 1000.0 << " us"
                     << Console::TextDefault << ")"
-                    << std::endl;
+                    << '\n';
 
             PAD_DEVIATION_INVERSE("Fastest time: ",
                                   (result.iterationTimeMinimum() / 1000.0),
@@ -262,6 +293,55 @@ public:
                 result.iterationsPerSecondQuartile3() <<
                 Console::TextDefault << ")");
 
+            const ResultMetadata& metadata = result.metadata();
+            if (!metadata.empty()) {
+                _stream << Console::TextBlue << "[ METADATA ] "
+                        << Console::TextDefault;
+                for (std::size_t i = 0; i < metadata.size(); ++i) {
+                    _stream << (i ? ", " : "") << metadata[i].first << ": "
+                            << metadata[i].second;
+                }
+                _stream << '\n';
+            }
+
+            if ((result.disturbedRuns()) || (result.rejectedRuns())) {
+                _stream << Console::TextYellow << "[ REJECTED ] "
+                        << Console::TextDefault << result.rejectedRuns()
+                        << (result.rejectedRuns() == 1 ? " run" : " runs")
+                        << " preempted or migrated and run again, "
+                        << result.disturbedRuns() << " kept" << '\n';
+            }
+
+            const ResultCounters& counters = result.counters();
+            for (ResultCounters::const_iterator it = counters.begin();
+                 it != counters.end();
+                 ++it) {
+                const SampleStatistics& counter = it->second;
+                _stream << Console::TextBlue << "[  COUNTER ] "
+                        << Console::TextDefault << it->first << ": "
+                        << counter.mean() << " (" << Console::TextCyan
+                        << "median: " << counter.quantile(0.5)
+                        << " | p99: " << counter.quantile(0.99)
+                        << " | max: " << counter.maximum()
+                        << Console::TextDefault << ")" << '\n';
+            }
+
+            const BudgetChecks& checks = result.budgetChecks();
+            for (std::size_t i = 0; i < checks.size(); ++i) {
+                if (!checks[i].Checked) {
+                    _stream << Console::TextYellow << "[ UNCHECKED] ";
+                } else if (checks[i].Passed) {
+                    _stream << Console::TextGreen << "[   PASS   ] ";
+                } else {
+                    _stream << Console::TextRed << "[   FAIL   ] ";
+                }
+                _stream << Console::TextDefault << "Budget "
+                        << checks[i].Description << '\n';
+            }
+
+            // Lines of a result are flushed together, once it is complete.
+            _stream.flush();
+
 #undef PAD_DEVIATION_INVERSE
 #undef PAD_DEVIATION
 #undef PAD
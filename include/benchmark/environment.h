@@ -0,0 +1,373 @@
+#ifndef BENCHMARK_ENVIRONMENT_H_
+#define BENCHMARK_ENVIRONMENT_H_
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <dirent.h>
+#include <stdlib.h>
+#include <sys/utsname.h>
+#include <unistd.h>
+#include <benchmark/cpu_topology.h>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Machine and build the benchmarks run on.
+
+/// Probed once at startup. The properties are attached to every
+/// machine-readable output, so that results from different machines or
+/// builds can be told apart and comparisons between them rejected.
+/// Settings known to make measurements noisy are reported as warnings.
+///
+/// The compiler properties describe the build of benchmark_main; the
+/// flags and build type are only known when it is built with CMake.
+class Environment {
+public:
+    /// Properties as name and value pairs, in a fixed order.
+
+    /// Properties that could not be determined are left out.
+    ResultMetadata Properties;
+
+
+    /// Settings that make measurements noisy.
+    std::vector<std::string> Warnings;
+
+
+    /// Value of a property, or an empty string if unknown.
+    std::string property(const std::string& name) const
+    {
+        for (std::size_t i = 0; i < Properties.size(); ++i) {
+            if (Properties[i].first == name) {
+                return Properties[i].second;
+            }
+        }
+        return std::string();
+    }
+
+
+    /// Probe the current environment.
+    static Environment probe()
+    {
+        Environment environment;
+        environment.probeProcessor();
+        environment.probeFrequencyScaling();
+        environment.probeSystem();
+        environment.probeBuild();
+        return environment;
+    }
+private:
+    void add(const std::string& name, const std::string& value)
+    {
+        if (!value.empty()) {
+            Properties.push_back(std::make_pair(name, value));
+        }
+    }
+
+
+    void warn(const std::string& text)
+    {
+        Warnings.push_back(text);
+    }
+
+
+    /// CPU model, counts and caches.
+    void probeProcessor()
+    {
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if ((line.compare(0, 10, "model name") == 0) ||
+                (line.compare(0, 9, "Processor") == 0)) {
+                const std::string::size_type colon = line.find(':');
+                if (colon != std::string::npos) {
+                    add("cpu_model", trim(line.substr(colon + 1)));
+                }
+                break;
+            }
+        }
+
+        const std::vector<int> allowed = CpuTopology::allowedCpus();
+        add("cpu_count", format(::sysconf(_SC_NPROCESSORS_ONLN)));
+        add("cpus_allowed", CpuTopology::formatCpuList(allowed));
+
+        const int cpu = (allowed.empty() ? 0 : allowed[0]);
+        for (int index = 0; index < 8; ++index) {
+            std::stringstream path;
+            path << "/sys/devices/system/cpu/cpu" << cpu
+                 << "/cache/index" << index;
+
+            const std::string level =
+                CpuTopology::readLine(path.str() + "/level");
+            const std::string type =
+                CpuTopology::readLine(path.str() + "/type");
+            if (level.empty()) {
+                break;
+            }
+
+            std::string name = "cache_l" + level;
+            if (type == "Data") {
+                name += "d";
+            } else if (type == "Instruction") {
+                name += "i";
+            }
+            add(name, CpuTopology::readLine(path.str() + "/size"));
+        }
+
+        const std::string smt =
+            CpuTopology::readLine("/sys/devices/system/cpu/smt/active");
+        if (!smt.empty()) {
+            add("smt", (smt == "1" ? "on" : "off"));
+            if (smt == "1") {
+                warn("SMT is active: a sibling thread may share the core "
+                     "with the benchmark");
+            }
+        }
+    }
+
+
+    /// Governors, frequency limits and turbo.
+    void probeFrequencyScaling()
+    {
+        const std::vector<int> allowed = CpuTopology::allowedCpus();
+        std::set<std::string> governors;
+        for (std::size_t i = 0; i < allowed.size(); ++i) {
+            std::stringstream path;
+            path << "/sys/devices/system/cpu/cpu" << allowed[i]
+                 << "/cpufreq/scaling_governor";
+            const std::string governor = CpuTopology::readLine(path.str());
+            if (!governor.empty()) {
+                governors.insert(governor);
+            }
+        }
+
+        std::string governorList;
+        for (std::set<std::string>::const_iterator it = governors.begin();
+             it != governors.end();
+             ++it) {
+            governorList += (governorList.empty() ? "" : ",") + *it;
+            if (*it != "performance") {
+                warn("CPU governor is " + *it + ": the frequency follows "
+                     "the load instead of staying at its maximum");
+            }
+        }
+        add("cpu_governor", governorList);
+
+        if (!allowed.empty()) {
+            std::stringstream path;
+            path << "/sys/devices/system/cpu/cpu" << allowed[0]
+                 << "/cpufreq/";
+            add("cpu_scaling_driver",
+                CpuTopology::readLine(path.str() + "scaling_driver"));
+            add("cpu_frequency_min_khz",
+                CpuTopology::readLine(path.str() + "scaling_min_freq"));
+            add("cpu_frequency_max_khz",
+                CpuTopology::readLine(path.str() + "scaling_max_freq"));
+        }
+
+        std::string turbo;
+        const std::string noTurbo = CpuTopology::readLine(
+            "/sys/devices/system/cpu/intel_pstate/no_turbo");
+        const std::string boost = CpuTopology::readLine(
+            "/sys/devices/system/cpu/cpufreq/boost");
+        if (!noTurbo.empty()) {
+            turbo = (noTurbo == "0" ? "on" : "off");
+        } else if (!boost.empty()) {
+            turbo = (boost == "1" ? "on" : "off");
+        }
+        add("turbo", turbo);
+        if (turbo == "on") {
+            warn("turbo is enabled: the frequency depends on temperature "
+                 "and on the load of other cores");
+        }
+    }
+
+
+    /// Kernel, memory, power source, CPU quota and load.
+    void probeSystem()
+    {
+        char hostname[256];
+        if (::gethostname(hostname, sizeof(hostname)) == 0) {
+            hostname[sizeof(hostname) - 1] = 0;
+            add("host", hostname);
+        }
+
+        struct utsname names;
+        if (::uname(&names) == 0) {
+            add("kernel", std::string(names.sysname) + " " + names.release +
+                " " + names.machine);
+        }
+
+        const std::string thp = CpuTopology::readLine(
+            "/sys/kernel/mm/transparent_hugepage/enabled");
+        const std::string::size_type open = thp.find('[');
+        const std::string::size_type close = thp.find(']');
+        if ((open != std::string::npos) && (close > open)) {
+            add("transparent_hugepages", thp.substr(open + 1, close - open - 1));
+        }
+
+        std::ifstream status("/proc/self/status");
+        std::string line;
+        while (std::getline(status, line)) {
+            if (line.compare(0, 6, "VmLck:") == 0) {
+                const std::string locked = trim(line.substr(6));
+                if (locked != "0 kB") {
+                    add("locked_memory", locked);
+                }
+                break;
+            }
+        }
+
+        const std::string power = powerSource();
+        add("power_source", power);
+        if (power == "battery") {
+            warn("running on battery: power saving may throttle the CPU");
+        }
+
+        const double quota = cpuQuota();
+        if (quota > 0.0) {
+            add("cgroup_cpu_quota", format(quota));
+            warn("cgroup CPU quota of " + format(quota) + " CPUs: the "
+                 "benchmark may be throttled when the quota runs out");
+        } else if (quota == 0.0) {
+            add("cgroup_cpu_quota", "max");
+        }
+
+        double load[3];
+        if (::getloadavg(load, 3) == 3) {
+            char text[64];
+            ::snprintf(text, sizeof(text), "%.2f %.2f %.2f",
+                       load[0], load[1], load[2]);
+            add("load_average", text);
+
+            const double cpus = double(CpuTopology::allowedCpus().size());
+            if (load[0] > (cpus > 2.0 ? cpus / 2.0 : 1.0)) {
+                warn("load average is " +
+                     std::string(text, std::strchr(text, ' ')) + ": other "
+                     "processes compete for the CPUs");
+            }
+        }
+    }
+
+
+    /// Compiler, flags and build type.
+    void probeBuild()
+    {
+#if defined(__clang__)
+        add("compiler", "clang " __clang_version__);
+#elif defined(__GNUC__)
+        add("compiler", "gcc " __VERSION__);
+#endif
+#if defined(BENCHMARK_BUILD_TYPE)
+        add("build_type", BENCHMARK_BUILD_TYPE);
+#endif
+#if defined(BENCHMARK_CXX_FLAGS)
+        add("compiler_flags", trim(BENCHMARK_CXX_FLAGS));
+#endif
+#if defined(__OPTIMIZE__)
+        add("optimized", "yes");
+#else
+        add("optimized", "no");
+        warn("benchmark_main is built without optimization");
+#endif
+#if defined(NDEBUG)
+        add("assertions", "off");
+#else
+        add("assertions", "on");
+#endif
+    }
+
+
+    /// "battery", "mains" or empty if unknown.
+    static std::string powerSource()
+    {
+        const std::string root = "/sys/class/power_supply/";
+        DIR* directory = ::opendir(root.c_str());
+        if (!directory) {
+            return std::string();
+        }
+
+        bool battery = false;
+        bool mains = false;
+        bool mainsOnline = false;
+        while (struct dirent* entry = ::readdir(directory)) {
+            if (entry->d_name[0] == '.') {
+                continue;
+            }
+
+            const std::string path = root + entry->d_name + "/";
+            const std::string type = CpuTopology::readLine(path + "type");
+            if (type == "Battery") {
+                battery = true;
+            } else if (type == "Mains") {
+                mains = true;
+                mainsOnline = (mainsOnline ||
+                               (CpuTopology::readLine(path + "online") ==
+                                "1"));
+            }
+        }
+        ::closedir(directory);
+
+        if ((battery) && (mains) && (!mainsOnline)) {
+            return "battery";
+        }
+        return (mains ? "mains" : std::string());
+    }
+
+
+    /// CPU quota of the cgroup in CPUs, 0 if unlimited or -1 if unknown.
+    static double cpuQuota()
+    {
+        // cgroup v2: "<quota> <period>" or "max <period>".
+        std::stringstream v2(CpuTopology::readLine("/sys/fs/cgroup/cpu.max"));
+        std::string quota;
+        double period = 0.0;
+        if (v2 >> quota >> period) {
+            if ((quota == "max") || (period <= 0.0)) {
+                return 0.0;
+            }
+            return ::atof(quota.c_str()) / period;
+        }
+
+        // cgroup v1: quota of -1 for unlimited.
+        const std::string v1Quota =
+            CpuTopology::readLine("/sys/fs/cgroup/cpu/cpu.cfs_quota_us");
+        const std::string v1Period =
+            CpuTopology::readLine("/sys/fs/cgroup/cpu/cpu.cfs_period_us");
+        if ((v1Quota.empty()) || (v1Period.empty())) {
+            return -1.0;
+        }
+        if ((::atof(v1Quota.c_str()) <= 0.0) ||
+            (::atof(v1Period.c_str()) <= 0.0)) {
+            return 0.0;
+        }
+        return ::atof(v1Quota.c_str()) / ::atof(v1Period.c_str());
+    }
+
+
+    static std::string trim(const std::string& text)
+    {
+        const std::string::size_type first = text.find_first_not_of(" \t");
+        if (first == std::string::npos) {
+            return std::string();
+        }
+        const std::string::size_type last = text.find_last_not_of(" \t");
+        return text.substr(first, last - first + 1);
+    }
+
+
+    template<typename T>
+    static std::string format(const T& value)
+    {
+        std::stringstream text;
+        text << value;
+        return text.str();
+    }
+};
+
+}
+#endif
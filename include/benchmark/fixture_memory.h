@@ -0,0 +1,287 @@
+#ifndef BENCHMARK_FIXTURE_MEMORY_H_
+#define BENCHMARK_FIXTURE_MEMORY_H_
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <stdint.h>
+#include <sys/mman.h>
+#include <unistd.h>
+
+#if defined(MAP_ANON) && !defined(MAP_ANONYMOUS)
+    #define MAP_ANONYMOUS MAP_ANON
+#endif
+
+namespace benchmark {
+
+/// Pages backing fixture memory.
+enum PageBacking {
+    /// Whatever the transparent huge page policy of the system gives.
+    PagesDefault,
+
+
+    /// Base pages only, with transparent huge pages disabled.
+    PagesSmall,
+
+
+    /// Transparent huge pages, requested with madvise(MADV_HUGEPAGE).
+    PagesTransparentHuge,
+
+
+    /// Explicit huge pages from the reserved pool, with MAP_HUGETLB.
+    PagesExplicitHuge
+};
+
+
+/// Options of fixture memory.
+enum FixtureMemoryFlags {
+    /// Touch every page up front, so the runs take no first-touch faults.
+    MemoryPrefault = 1,
+
+
+    /// Lock the pages in memory with mlock().
+    MemoryLock = 2
+};
+
+
+/// Anonymous memory for large fixture data.
+
+/// Lets a fixture choose the pages backing its data, e.g. to compare base
+/// pages with huge pages for the same benchmark, and fault in and lock the
+/// memory up front so that page faults do not show up in the timed region:
+///
+///     void setUp()
+///     {
+///         _table = new FixtureMemory(1 << 30, PagesTransparentHuge);
+///     }
+///
+/// Failures throw std::runtime_error.
+class FixtureMemory {
+public:
+    /// Map memory.
+
+    /// @param bytes Size of the memory. Rounded up to whole pages.
+    /// @param pages Pages to back the memory with.
+    /// @param flags Combination of FixtureMemoryFlags.
+    FixtureMemory(std::size_t bytes,
+                  PageBacking pages = PagesDefault,
+                  unsigned flags = MemoryPrefault)
+        :   _mapping(NULL),
+            _mappingBytes(0),
+            _data(NULL),
+            _bytes(0),
+            _pages(pages),
+            _locked(false)
+    {
+        const std::size_t basePage = std::size_t(::sysconf(_SC_PAGESIZE));
+        const std::size_t page = ((pages == PagesDefault) ||
+                                  (pages == PagesSmall) ?
+                                  basePage :
+                                  hugePageBytes());
+        _bytes = (bytes + page - 1) / page * page;
+
+        if (pages == PagesExplicitHuge) {
+            mapExplicitHuge();
+        } else {
+            mapAligned(page);
+        }
+
+        if ((flags & MemoryPrefault) && (!(flags & MemoryLock))) {
+            // Write to every base page, so huge pages are populated too.
+            volatile char* data = static_cast<char*>(_data);
+            for (std::size_t offset = 0; offset < _bytes; offset += basePage) {
+                data[offset] = 0;
+            }
+        }
+
+        if (flags & MemoryLock) {
+            // Locking faults in every page as well.
+            if (::mlock(_data, _bytes) != 0) {
+                const std::string reason = strerror(errno);
+                unmap();
+                throw std::runtime_error("mlock failed: " + reason +
+                                         " (see ulimit -l)");
+            }
+            _locked = true;
+        }
+    }
+
+
+    ~FixtureMemory()
+    {
+        unmap();
+    }
+
+
+    /// Start of the memory.
+    inline void* data() const
+    {
+        return _data;
+    }
+
+
+    /// Start of the memory as an array.
+    template<typename T>
+    inline T* as() const
+    {
+        return static_cast<T*>(_data);
+    }
+
+
+    /// Size of the memory in bytes.
+    inline std::size_t size() const
+    {
+        return _bytes;
+    }
+
+
+    /// Whether the memory is locked.
+    inline bool locked() const
+    {
+        return _locked;
+    }
+
+
+    /// Bytes of the memory currently backed by huge pages.
+
+    /// Read from /proc/self/smaps, so transparent huge pages can be told
+    /// apart from a fallback to base pages. 0 where unavailable.
+    std::size_t hugePageBackedBytes() const
+    {
+        if (_pages == PagesExplicitHuge) {
+            return _bytes;
+        }
+
+        std::ifstream smaps("/proc/self/smaps");
+        std::string line;
+        const uintptr_t start = reinterpret_cast<uintptr_t>(_data);
+        const uintptr_t end = start + _bytes;
+        std::size_t total = 0;
+        bool inside = false;
+
+        while (std::getline(smaps, line)) {
+            unsigned long low = 0;
+            unsigned long high = 0;
+            char dash = 0;
+            std::stringstream header(line);
+            if ((header >> std::hex >> low >> dash >> high) && (dash == '-')) {
+                inside = ((low < end) && (high > start));
+            } else if ((inside) &&
+                       (line.compare(0, 14, "AnonHugePages:") == 0)) {
+                total += std::size_t(::strtoull(line.c_str() + 14, NULL, 10)) *
+                    1024;
+            }
+        }
+        return total;
+    }
+
+
+    /// Size of a huge page, from /proc/meminfo or 2 MiB if unknown.
+    static std::size_t hugePageBytes()
+    {
+        std::ifstream meminfo("/proc/meminfo");
+        std::string line;
+        while (std::getline(meminfo, line)) {
+            if (line.compare(0, 13, "Hugepagesize:") == 0) {
+                const std::size_t kilobytes =
+                    std::size_t(::strtoull(line.c_str() + 13, NULL, 10));
+                if (kilobytes) {
+                    return kilobytes * 1024;
+                }
+            }
+        }
+        return 2 * 1024 * 1024;
+    }
+private:
+    /// Map base pages aligned to a page size and advise the kernel.
+    void mapAligned(std::size_t alignment)
+    {
+        _mappingBytes = _bytes + alignment;
+        _mapping = ::mmap(NULL,
+                          _mappingBytes,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS,
+                          -1,
+                          0);
+        if (_mapping == MAP_FAILED) {
+            _mapping = NULL;
+            throw std::runtime_error(std::string("mmap failed: ") +
+                                     strerror(errno));
+        }
+
+        // Huge pages are only used for aligned ranges.
+        const uintptr_t start = reinterpret_cast<uintptr_t>(_mapping);
+        _data = reinterpret_cast<void*>((start + alignment - 1) /
+                                        alignment * alignment);
+
+#if defined(MADV_HUGEPAGE) && defined(MADV_NOHUGEPAGE)
+        if ((_pages == PagesTransparentHuge) &&
+            (::madvise(_data, _bytes, MADV_HUGEPAGE) != 0)) {
+            const std::string reason = strerror(errno);
+            unmap();
+            throw std::runtime_error("madvise(MADV_HUGEPAGE) failed: " +
+                                     reason);
+        }
+        if (_pages == PagesSmall) {
+            ::madvise(_data, _bytes, MADV_NOHUGEPAGE);
+        }
+#else
+        if (_pages == PagesTransparentHuge) {
+            unmap();
+            throw std::runtime_error("transparent huge pages are not "
+                                     "supported on this platform");
+        }
+#endif
+    }
+
+
+    /// Map explicit huge pages.
+    void mapExplicitHuge()
+    {
+#if defined(MAP_HUGETLB)
+        _mappingBytes = _bytes;
+        _mapping = ::mmap(NULL,
+                          _mappingBytes,
+                          PROT_READ | PROT_WRITE,
+                          MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB,
+                          -1,
+                          0);
+        if (_mapping == MAP_FAILED) {
+            _mapping = NULL;
+            throw std::runtime_error(std::string("mmap(MAP_HUGETLB) failed: ") +
+                                     strerror(errno) +
+                                     " (see /proc/sys/vm/nr_hugepages)");
+        }
+        _data = _mapping;
+#else
+        throw std::runtime_error("explicit huge pages are not supported on "
+                                 "this platform");
+#endif
+    }
+
+
+    void unmap()
+    {
+        if (_mapping) {
+            ::munmap(_mapping, _mappingBytes);
+            _mapping = NULL;
+        }
+    }
+private:
+    FixtureMemory(const FixtureMemory&);
+    FixtureMemory& operator =(const FixtureMemory&);
+private:
+    void        *_mapping;
+    std::size_t  _mappingBytes;
+    void        *_data;
+    std::size_t  _bytes;
+    PageBacking  _pages;
+    bool         _locked;
+};
+
+}
+#endif
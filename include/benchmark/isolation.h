@@ -0,0 +1,328 @@
+#ifndef BENCHMARK_ISOLATION_H_
+#define BENCHMARK_ISOLATION_H_
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <sstream>
+#include <string>
+#include <poll.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#include <benchmark/clock.h>
+#include <benchmark/cpu_topology.h>
+
+namespace benchmark {
+
+/// Work executed in an isolated child process.
+class IsolatedTask {
+public:
+    virtual ~IsolatedTask()
+    {
+
+    }
+
+
+    /// Execute the task.
+
+    /// Runs in the child process.
+    /// @param payload Result to be sent back to the parent.
+    virtual void run(std::string& payload) = 0;
+};
+
+
+/// Forked child process execution.
+
+/// Runs an IsolatedTask in a forked child, so heap state, page cache and
+/// static side effects of the task never leak into the parent. The
+/// result is shipped back over a pipe. A child that crashes, exits
+/// prematurely, throws or exceeds its time limit is reported as a
+/// failure instead of taking down the parent.
+///
+/// Several children may be in flight at once: start() them, poll their
+/// fd() and call read() when readable until it returns false, then
+/// finish() each one.
+class ChildProcess {
+public:
+    ChildProcess()
+        :   _pid(-1),
+            _fd(-1),
+            _startTime(0)
+    {
+
+    }
+
+
+    ~ChildProcess()
+    {
+        if (_fd >= 0) {
+            ::close(_fd);
+        }
+        if (_pid > 0) {
+            ::kill(_pid, SIGKILL);
+            reap();
+        }
+    }
+
+
+    /// Run a task in a child process and wait for it.
+
+    /// @param task Task to run.
+    /// @param timeoutSeconds Time limit for the child, or 0 for none.
+    /// @param payload Receives the payload produced by the task.
+    /// @param failure Receives a description of the failure, if any.
+    /// @returns true if the task completed and its payload was received.
+    static bool run(IsolatedTask& task,
+                    unsigned timeoutSeconds,
+                    std::string& payload,
+                    std::string& failure)
+    {
+        ChildProcess child;
+        if (!child.start(task, -1, failure)) {
+            return false;
+        }
+
+        const Clock::TimeDiff limit =
+            Clock::TimeDiff(timeoutSeconds) * 1000000000ULL;
+        bool timedOut = false;
+
+        while (true) {
+            int timeoutMs = -1;
+            if (timeoutSeconds) {
+                const Clock::TimeDiff elapsed = child.elapsed();
+                if (elapsed >= limit) {
+                    timedOut = true;
+                    break;
+                }
+                timeoutMs = int((limit - elapsed) / 1000000) + 1;
+            }
+
+            struct pollfd pfd;
+            pfd.fd = child.fd();
+            pfd.events = POLLIN;
+            pfd.revents = 0;
+
+            const int ready = ::poll(&pfd, 1, timeoutMs);
+            if ((ready < 0) && (errno != EINTR)) {
+                break;
+            }
+            if ((ready > 0) && (!child.read())) {
+                break;
+            }
+        }
+
+        return child.finish(timedOut, timeoutSeconds, payload, failure);
+    }
+
+
+    /// Fork a child running the task.
+
+    /// @param task Task to run.
+    /// @param cpu CPU to pin the child to, or -1 to leave it unpinned.
+    /// @param failure Receives a description of the failure, if any.
+    /// @returns true if the child was started.
+    bool start(IsolatedTask& task, int cpu, std::string& failure)
+    {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            failure = std::string("pipe failed: ") + strerror(errno);
+            return false;
+        }
+
+        // Flush anything buffered so that the child does not repeat it.
+        std::cout.flush();
+        std::cerr.flush();
+        ::fflush(NULL);
+
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+            failure = std::string("fork failed: ") + strerror(errno);
+            ::close(fds[0]);
+            ::close(fds[1]);
+            return false;
+        }
+
+        if (pid == 0) {
+            ::close(fds[0]);
+            if ((cpu >= 0) && (!CpuTopology::pinCurrentThread(cpu))) {
+                std::stringstream error;
+                error << char(ResultFailure) << "pinning to CPU " << cpu
+                      << " failed: " << strerror(errno);
+                exitChild(error.str(), fds[1]);
+            }
+            runChild(task, fds[1]);
+        }
+
+        ::close(fds[1]);
+        _pid = pid;
+        _fd = fds[0];
+        _startTime = Clock::now();
+        _message.clear();
+        return true;
+    }
+
+
+    /// Read end of the result pipe.
+    inline int fd() const
+    {
+        return _fd;
+    }
+
+
+    /// Time since the child was started in nanoseconds.
+    inline Clock::TimeDiff elapsed() const
+    {
+        return Clock::duration(_startTime, Clock::now());
+    }
+
+
+    /// Read the next chunk the child has written.
+
+    /// Only call when fd() is readable.
+    /// @returns false once the child has closed its end of the pipe.
+    bool read()
+    {
+        char buffer[65536];
+
+        const ssize_t got = ::read(_fd, buffer, sizeof(buffer));
+        if (got < 0) {
+            return (errno == EINTR);
+        }
+        if (got == 0) {
+            return false;
+        }
+        _message.append(buffer, std::size_t(got));
+        return true;
+    }
+
+
+    /// Wait for the child to exit and extract its result.
+
+    /// @param timedOut Whether the child exceeded its time limit, in which
+    /// case it is killed.
+    /// @param timeoutSeconds Time limit, for the failure description.
+    /// @param payload Receives the payload produced by the task.
+    /// @param failure Receives a description of the failure, if any.
+    /// @returns true if the task completed and its payload was received.
+    bool finish(bool timedOut,
+                unsigned timeoutSeconds,
+                std::string& payload,
+                std::string& failure)
+    {
+        ::close(_fd);
+        _fd = -1;
+
+        if (timedOut) {
+            ::kill(_pid, SIGKILL);
+        }
+
+        const int status = reap();
+
+        std::stringstream error;
+
+        if (timedOut) {
+            error << "timed out after " << timeoutSeconds << " s";
+        } else if (WIFSIGNALED(status)) {
+            error << "terminated by signal " << WTERMSIG(status)
+                  << " (" << strsignal(WTERMSIG(status)) << ")";
+        } else if ((WIFEXITED(status)) && (WEXITSTATUS(status) != 0)) {
+            error << "exited with status " << WEXITSTATUS(status);
+        } else if (_message.empty()) {
+            error << "exited without reporting a result";
+        } else if (_message[0] == ResultFailure) {
+            error << _message.substr(1);
+        } else if (_message[0] != ResultSuccess) {
+            error << "threw an exception: " << _message.substr(1);
+        } else {
+            payload = _message.substr(1);
+            return true;
+        }
+
+        failure = error.str();
+        return false;
+    }
+private:
+    enum ResultCode {
+        /// Payload follows.
+        ResultSuccess = 'S',
+
+
+        /// Exception description follows.
+        ResultException = 'E',
+
+
+        /// Description of a failure before the task ran follows.
+        ResultFailure = 'F'
+    };
+
+
+    /// Wait for the child to exit.
+    int reap()
+    {
+        int status = 0;
+        while ((::waitpid(_pid, &status, 0) < 0) && (errno == EINTR)) {
+        }
+        _pid = -1;
+        return status;
+    }
+
+
+    /// Child side: run the task and write the result.
+    static void runChild(IsolatedTask& task, int fd)
+    {
+        std::string message(1, char(ResultSuccess));
+
+        try {
+            task.run(message);
+        } catch (std::exception& e) {
+            message = std::string(1, char(ResultException)) + e.what();
+        } catch (...) {
+            message = std::string(1, char(ResultException)) + "unknown";
+        }
+
+        exitChild(message, fd);
+    }
+
+
+    /// Child side: write the result and exit.
+    static void exitChild(const std::string& message, int fd)
+    {
+        const char* data = message.data();
+        std::size_t remaining = message.size();
+
+        while (remaining) {
+            const ssize_t written = ::write(fd, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                ::_exit(EXIT_FAILURE);
+            }
+            data += written;
+            remaining -= std::size_t(written);
+        }
+
+        ::close(fd);
+
+        // Skip static destructors and atexit handlers of the parent image.
+        std::cout.flush();
+        ::fflush(NULL);
+        ::_exit(EXIT_SUCCESS);
+    }
+private:
+    ChildProcess(const ChildProcess&);
+    ChildProcess& operator =(const ChildProcess&);
+private:
+    pid_t              _pid;
+    int                _fd;
+    Clock::TimePoint   _startTime;
+    std::string        _message;
+};
+
+}
+#endif
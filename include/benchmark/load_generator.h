@@ -0,0 +1,418 @@
+#ifndef BENCHMARK_LOAD_GENERATOR_H_
+#define BENCHMARK_LOAD_GENERATOR_H_
+#include <cerrno>
+#include <cmath>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <time.h>
+#include <benchmark/clock.h>
+#include <benchmark/statistics.h>
+#include <benchmark/test.h>
+#include <benchmark/test_factory.h>
+#include <benchmark/test_result.h>
+#include <benchmark/trace_recorder.h>
+
+namespace benchmark {
+
+/// Open-loop load generator.
+
+/// Driver threads call the test body on a fixed schedule at the offered
+/// rate, regardless of how long earlier calls took. The latency of a call
+/// is measured from its intended start time rather than from when it
+/// actually started, so time spent queued behind slow calls is included
+/// instead of being omitted. The schedule starts once every driver has set
+/// up its fixture, so set up does not count as latency either.
+class LoadGenerator {
+public:
+    /// @param factory Factory creating one test instance per driver.
+    /// @param rate Offered rate in calls per second over all drivers.
+    /// @param durationSeconds Time to offer load for.
+    /// @param threads Number of driver threads.
+    LoadGenerator(TestFactory& factory,
+                  double rate,
+                  double durationSeconds,
+                  std::size_t threads)
+        :   _factory(factory),
+            _rate(rate),
+            _durationSeconds(durationSeconds),
+            _threads(threads ? threads : 1)
+    {
+
+    }
+
+
+    /// Offer the load.
+
+    /// @param retainSamples Whether to keep every latency.
+    /// @param measurement Receives the latencies in nanoseconds and the
+    /// offered and achieved rates as metadata.
+    /// @param failure Receives a description of the failure, if any.
+    /// @returns true if all calls completed.
+    bool run(bool retainSamples,
+             TestMeasurement& measurement,
+             std::string& failure)
+    {
+        const double intervalNs = 1000000000.0 / _rate;
+        const uint64_t calls =
+            uint64_t(std::floor(_rate * _durationSeconds + 0.5));
+
+        measurement.RunTimes.retainSamples(retainSamples);
+
+        StartGate gate;
+        std::vector<Driver> drivers(_threads);
+        for (std::size_t i = 0; i < _threads; ++i) {
+            drivers[i].Gate = &gate;
+            drivers[i].TestInstance = _factory.createTest();
+            drivers[i].Latencies.retainSamples(retainSamples);
+            drivers[i].IntervalNs = intervalNs;
+            drivers[i].First = i;
+            drivers[i].Stride = _threads;
+            drivers[i].Calls = calls;
+        }
+
+        std::size_t started = 0;
+        for (; started < _threads; ++started) {
+            drivers[started].LeadNs = 10000000.0;
+            const int error = ::pthread_create(&drivers[started].Thread,
+                                               NULL,
+                                               &LoadGenerator::drive,
+                                               &drivers[started]);
+            if (error) {
+                failure = std::string("pthread_create failed: ") +
+                    strerror(error);
+                break;
+            }
+        }
+
+        // Once every driver is set up, start them against a common
+        // schedule beginning slightly in the future, so that waking the
+        // drivers does not count as latency.
+        ::pthread_mutex_lock(&gate.Mutex);
+        while (gate.Ready < started) {
+            ::pthread_cond_wait(&gate.Changed, &gate.Mutex);
+        }
+        if (!failure.empty()) {
+            gate.Abort = true;
+        }
+        const Clock::TimePoint start = Clock::now();
+        for (std::size_t i = 0; i < started; ++i) {
+            drivers[i].Start = start;
+        }
+        gate.Released = true;
+        ::pthread_cond_broadcast(&gate.Changed);
+        ::pthread_mutex_unlock(&gate.Mutex);
+
+        uint64_t lastNs = 0;
+        for (std::size_t i = 0; i < started; ++i) {
+            ::pthread_join(drivers[i].Thread, NULL);
+            if ((failure.empty()) && (!drivers[i].Failure.empty())) {
+                failure = drivers[i].Failure;
+            }
+            if (drivers[i].LastNs > lastNs) {
+                lastNs = drivers[i].LastNs;
+            }
+            measurement.RunTimes.merge(drivers[i].Latencies);
+        }
+        for (std::size_t i = 0; i < _threads; ++i) {
+            if (i < started) {
+                drivers[i].TestInstance->collectCounters(measurement.Counters);
+            }
+            delete drivers[i].TestInstance;
+        }
+        if (!failure.empty()) {
+            return false;
+        }
+
+        const double elapsedSeconds =
+            (double(lastNs) - drivers[0].LeadNs) / 1000000000.0;
+        std::stringstream offered;
+        std::stringstream achieved;
+        std::stringstream threads;
+
+        offered << _rate << "/s";
+        achieved << (elapsedSeconds > 0 ?
+                     double(measurement.RunTimes.count()) / elapsedSeconds :
+                     0.0) << "/s";
+        threads << _threads;
+
+        measurement.Metadata.push_back(
+            ResultMetadataEntry("offered_rate", offered.str()));
+        measurement.Metadata.push_back(
+            ResultMetadataEntry("achieved_rate", achieved.str()));
+        measurement.Metadata.push_back(
+            ResultMetadataEntry("driver_threads", threads.str()));
+        return true;
+    }
+
+
+    /// Parse a rate such as "200k/s", "1.5M" or "5000".
+
+    /// @returns true if the rate is valid and positive.
+    static bool parseRate(const std::string& text, double& rate)
+    {
+        char* end = NULL;
+        rate = ::strtod(text.c_str(), &end);
+        if ((end == text.c_str()) || (!(rate > 0))) {
+            return false;
+        }
+
+        switch (*end) {
+        case 'k': rate *= 1e3; ++end; break;
+        case 'M': rate *= 1e6; ++end; break;
+        case 'G': rate *= 1e9; ++end; break;
+        default: break;
+        }
+        return ((!*end) || (!strcmp(end, "/s")));
+    }
+
+
+    /// Parse a comma-separated list of rates.
+
+    /// @returns true if every rate is valid.
+    static bool parseRates(const std::string& text, std::vector<double>& rates)
+    {
+        std::stringstream stream(text);
+        std::string item;
+
+        rates.clear();
+        while (std::getline(stream, item, ',')) {
+            double rate;
+            if (!parseRate(item, rate)) {
+                return false;
+            }
+            rates.push_back(rate);
+        }
+        return !rates.empty();
+    }
+
+
+    /// Parse a duration such as "30s", "500ms", "100us" or "2".
+
+    /// A number without unit is in seconds.
+    /// @returns true if the duration is valid and positive.
+    static bool parseDuration(const std::string& text, double& seconds)
+    {
+        char* end = NULL;
+        seconds = ::strtod(text.c_str(), &end);
+        if ((end == text.c_str()) || (!(seconds > 0))) {
+            return false;
+        }
+
+        if ((!*end) || (!strcmp(end, "s"))) {
+            return true;
+        } else if (!strcmp(end, "ms")) {
+            seconds /= 1e3;
+        } else if (!strcmp(end, "us")) {
+            seconds /= 1e6;
+        } else if (!strcmp(end, "m")) {
+            seconds *= 60;
+        } else {
+            return false;
+        }
+        return true;
+    }
+private:
+    /// Holds the drivers back until all of them are set up.
+    struct StartGate {
+        StartGate()
+            :   Ready(0),
+                Released(false),
+                Abort(false)
+        {
+            ::pthread_mutex_init(&Mutex, NULL);
+            ::pthread_cond_init(&Changed, NULL);
+        }
+
+
+        ~StartGate()
+        {
+            ::pthread_cond_destroy(&Changed);
+            ::pthread_mutex_destroy(&Mutex);
+        }
+
+
+        /// Report a driver as set up and wait for the schedule to start.
+
+        /// @param ready Whether the fixture was set up; if not, no driver
+        /// issues calls.
+        /// @returns false if the drivers are to stop without calls.
+        bool arrive(bool ready)
+        {
+            ::pthread_mutex_lock(&Mutex);
+            if (!ready) {
+                Abort = true;
+            }
+            ++Ready;
+            ::pthread_cond_broadcast(&Changed);
+            while (!Released) {
+                ::pthread_cond_wait(&Changed, &Mutex);
+            }
+            const bool proceed = !Abort;
+            ::pthread_mutex_unlock(&Mutex);
+            return proceed;
+        }
+
+        pthread_mutex_t  Mutex;
+        pthread_cond_t   Changed;
+        std::size_t      Ready;
+        bool             Released;
+        bool             Abort;
+    };
+
+
+    /// State of one driver thread.
+    struct Driver {
+        Driver()
+            :   Gate(NULL),
+                TestInstance(NULL),
+                IntervalNs(0.0),
+                LeadNs(0.0),
+                First(0),
+                Stride(1),
+                Calls(0),
+                Start(0),
+                LastNs(0)
+        {
+
+        }
+
+        StartGate           *Gate;
+        Test                *TestInstance;
+        SampleStatistics     Latencies;
+        double               IntervalNs;
+        double               LeadNs;
+        uint64_t             First;
+        uint64_t             Stride;
+        uint64_t             Calls;
+        Clock::TimePoint     Start;
+        uint64_t             LastNs;
+        std::string          Failure;
+        pthread_t            Thread;
+    };
+
+
+    /// Driver thread entry point.
+
+    /// Sets up the fixture, waits for every driver to do so, then issues
+    /// calls First, First + Stride, ... of the common schedule. Times are
+    /// kept in nanoseconds since the start of the schedule.
+    static void* drive(void* argument)
+    {
+        Driver& driver = *static_cast<Driver*>(argument);
+        const bool traced = TraceRecorder::enabled();
+        const std::size_t interval = TraceRecorder::iterationInterval();
+        std::size_t skip = 0;
+        uint64_t traceMark = 0;
+        bool ready = false;
+
+        try {
+            if (traced) {
+                std::stringstream name;
+                name << "load driver " << driver.First;
+                TraceRecorder::nameThread(name.str());
+            }
+
+            traceMark = (traced ? TraceRecorder::now() : 0);
+            driver.TestInstance->setUp();
+            if (traced)
+                TraceRecorder::span("setUp", "fixture", traceMark);
+            ready = true;
+        } catch (std::exception& e) {
+            driver.Failure = e.what();
+        } catch (...) {
+            driver.Failure = "unknown exception";
+        }
+
+        const bool proceed = driver.Gate->arrive(ready);
+        if (!ready) {
+            return NULL;
+        }
+
+        try {
+            for (uint64_t call = driver.First;
+                 (proceed) && (call < driver.Calls);
+                 call += driver.Stride) {
+                const uint64_t intended = uint64_t(
+                    driver.LeadNs + double(call) * driver.IntervalNs);
+                waitUntil(driver.Start, intended);
+
+                // Every n-th call is traced.
+                const bool sampled = ((traced) && (interval) && (!skip--));
+                if (sampled) {
+                    skip = interval - 1;
+                    traceMark = TraceRecorder::now();
+                }
+
+                driver.TestInstance->runIteration();
+
+                const uint64_t end =
+                    Clock::duration(driver.Start, Clock::now());
+                driver.Latencies.add(double(end > intended ?
+                                            end - intended :
+                                            0));
+                driver.LastNs = end;
+
+                if (sampled) {
+                    TraceRecorder::span(
+                        "call",
+                        "iteration",
+                        traceMark,
+                        TraceArguments(1, std::make_pair(
+                            "latency_ns",
+                            double(end > intended ? end - intended : 0))));
+                }
+            }
+
+            traceMark = (traced ? TraceRecorder::now() : 0);
+            driver.TestInstance->tearDown();
+            if (traced)
+                TraceRecorder::span("tearDown", "fixture", traceMark);
+        } catch (std::exception& e) {
+            driver.Failure = e.what();
+        } catch (...) {
+            driver.Failure = "unknown exception";
+        }
+        return NULL;
+    }
+
+
+    /// Wait for a point in time.
+
+    /// Sleeps while the point is far off and spins for the remainder, as
+    /// sleeping overshoots by far more than the interval between calls
+    /// at high rates.
+    /// @param start Start of the schedule.
+    /// @param when Nanoseconds since the start to wait for.
+    static void waitUntil(Clock::TimePoint start, uint64_t when)
+    {
+        uint64_t now = Clock::duration(start, Clock::now());
+
+        while (now < when) {
+            const uint64_t remaining = when - now;
+            if (remaining > 200000) {
+                struct timespec pause;
+                pause.tv_sec = 0;
+                pause.tv_nsec = long(remaining - 100000);
+                if (pause.tv_nsec >= 1000000000L) {
+                    pause.tv_sec = pause.tv_nsec / 1000000000L;
+                    pause.tv_nsec %= 1000000000L;
+                }
+                ::nanosleep(&pause, NULL);
+            }
+            now = Clock::duration(start, Clock::now());
+        }
+    }
+private:
+    TestFactory  &_factory;
+    double        _rate;
+    double        _durationSeconds;
+    std::size_t   _threads;
+};
+
+}
+#endif
@@ -0,0 +1,180 @@
+#ifndef BENCHMARK_MEMORY_FOOTPRINT_H_
+#define BENCHMARK_MEMORY_FOOTPRINT_H_
+#include <cstddef>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Resident memory footprint of the process.
+
+/// Measures the resident set size (RSS) at the start and end of a run
+/// through /proc/self/statm, the proportional set size through
+/// /proc/self/smaps_rollup, and the peak RSS during the run through
+/// VmHWM after resetting it with /proc/self/clear_refs. Where the peak
+/// cannot be reset, the peak over the life time of the process from
+/// getrusage() is used instead.
+///
+/// Freed memory is usually kept by the allocator, so later runs in the
+/// same process may show smaller deltas than the first one.
+class MemoryFootprint {
+public:
+    MemoryFootprint()
+        :   _active(false),
+            _peakReset(false),
+            _startRss(0),
+            _startPss(0)
+    {
+
+    }
+
+
+    /// Enable footprint measurement for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        enabledFlag() = enabled;
+    }
+
+
+    /// Whether footprint measurement is enabled.
+    static bool enabled()
+    {
+        return enabledFlag();
+    }
+
+
+    /// Start measuring.
+    void begin()
+    {
+        _active = enabled();
+        if (!_active) {
+            return;
+        }
+
+        _peakReset = resetPeak();
+        _startRss = residentBytes();
+        _startPss = statusField("/proc/self/smaps_rollup", "Pss:");
+    }
+
+
+    /// Stop measuring and add the footprint.
+
+    /// @param elements Number of elements held by the test, or 0 if not
+    /// reported. Gives the footprint in bytes per element.
+    void end(std::size_t elements)
+    {
+        if (!_active) {
+            return;
+        }
+        _active = false;
+
+        const int64_t rss = residentBytes();
+        const int64_t pss = statusField("/proc/self/smaps_rollup", "Pss:");
+        int64_t peak = (_peakReset ?
+                        statusField("/proc/self/status", "VmHWM:") :
+                        0);
+        if (peak <= 0) {
+            struct rusage usage;
+            ::getrusage(RUSAGE_SELF, &usage);
+#if defined(__APPLE__)
+            peak = int64_t(usage.ru_maxrss);
+#else
+            peak = int64_t(usage.ru_maxrss) * 1024;
+#endif
+        }
+        if (peak < rss) {
+            peak = rss;
+        }
+
+        const int64_t rssDelta = rss - _startRss;
+
+        _counters["rss_delta_bytes"].add(double(rssDelta));
+        _counters["peak_rss_bytes"].add(double(peak));
+        _counters["peak_rss_delta_bytes"].add(double(peak - _startRss));
+        if ((pss > 0) && (_startPss > 0)) {
+            _counters["pss_delta_bytes"].add(double(pss - _startPss));
+        }
+        if (elements) {
+            _counters["rss_bytes_per_element"].add(double(rssDelta) /
+                                                   double(elements));
+        }
+    }
+
+
+    /// Move the measurements into a set of counters.
+    void collect(ResultCounters& counters)
+    {
+        mergeCounters(counters, _counters);
+        _counters.clear();
+    }
+private:
+    /// Reset the peak RSS of the process to its current RSS.
+    static bool resetPeak()
+    {
+#if defined(__linux__)
+        std::ofstream file("/proc/self/clear_refs");
+        file << "5";
+        file.flush();
+        return file.good();
+#else
+        return false;
+#endif
+    }
+
+
+    /// Current RSS in bytes, or 0 if unknown.
+    static int64_t residentBytes()
+    {
+        std::ifstream file("/proc/self/statm");
+        uint64_t size = 0;
+        uint64_t resident = 0;
+        if (!(file >> size >> resident)) {
+            return 0;
+        }
+        return int64_t(resident) * int64_t(::sysconf(_SC_PAGESIZE));
+    }
+
+
+    /// Value of a "<name> <value> kB" line in bytes, or 0 if unknown.
+    static int64_t statusField(const char* path, const std::string& name)
+    {
+        std::ifstream file(path);
+        std::string line;
+
+        while (std::getline(file, line)) {
+            if (line.compare(0, name.size(), name) == 0) {
+                return int64_t(::strtoll(line.c_str() + name.size(),
+                                         NULL,
+                                         10)) * 1024;
+            }
+        }
+        return 0;
+    }
+
+
+    static bool& enabledFlag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+private:
+    MemoryFootprint(const MemoryFootprint&);
+    MemoryFootprint& operator =(const MemoryFootprint&);
+private:
+    bool            _active;
+    bool            _peakReset;
+    int64_t         _startRss;
+    int64_t         _startPss;
+    ResultCounters  _counters;
+};
+
+}
+#endif
@@ -2,12 +2,22 @@
 #define BENCHMARK_OUTPUTTER_H_
 #include <iostream>
 #include <cstddef>
+#include <benchmark/environment.h>
 #include <benchmark/test_result.h>
 
 namespace benchmark {
 
 class Outputter {
 public:
+    /// Describe the machine and build the benchmarks run on.
+
+    /// Called once before begin(). Machine-readable outputters attach the
+    /// properties to their output.
+    virtual void environment(const Environment& environment)
+    {
+
+    }
+
     virtual void begin(const std::size_t& enabledCount,
                            const std::size_t& disabledCount) = 0;
 
@@ -30,6 +40,18 @@ public:
                                       const TestParametersDescriptor &parameters,
                                       const std::size_t& runsCount,
                                       const std::size_t& iterationsCount) = 0;
+
+    /// Report a test that did not produce a result.
+
+    /// Called instead of endTest() when an isolated test crashed, timed
+    /// out or otherwise failed to report back.
+    virtual void failTest(const std::string& fixtureName,
+                              const std::string& testName,
+                              const TestParametersDescriptor& parameters,
+                              const std::string& reason)
+    {
+
+    }
     
     virtual ~Outputter()
     {
@@ -0,0 +1,241 @@
+#ifndef BENCHMARK_PLACEMENT_H_
+#define BENCHMARK_PLACEMENT_H_
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/syscall.h>
+#endif
+#include <benchmark/cpu_topology.h>
+#include <benchmark/test_result.h>
+
+// Memory policy constants from <numaif.h>, which is not always installed.
+#define BENCHMARK_MPOL_DEFAULT 0
+#define BENCHMARK_MPOL_BIND 2
+#define BENCHMARK_MPOL_MF_MOVE (1 << 1)
+
+namespace benchmark {
+
+/// CPU and NUMA placement of a benchmark.
+class Placement {
+public:
+    Placement()
+        :   NumaNode(-1)
+    {
+
+    }
+
+
+    /// CPUs to run on. Empty to leave the affinity unchanged.
+    std::vector<int> Cpus;
+
+
+    /// NUMA node to run on and allocate from, or -1 for any.
+    int NumaNode;
+
+
+    /// Combine with a more specific placement.
+
+    /// @returns this placement with every field set in other replaced.
+    Placement overriddenBy(const Placement& other) const
+    {
+        Placement result(*this);
+        if (!other.Cpus.empty()) {
+            result.Cpus = other.Cpus;
+        }
+        if (other.NumaNode >= 0) {
+            result.NumaNode = other.NumaNode;
+        }
+        return result;
+    }
+
+
+    /// CPUs of a NUMA node.
+    static std::vector<int> nodeCpus(int node)
+    {
+        std::stringstream path;
+        path << "/sys/devices/system/node/node" << node << "/cpulist";
+
+        std::vector<int> cpus;
+        CpuTopology::parseCpuList(CpuTopology::readLine(path.str()), cpus);
+        return cpus;
+    }
+
+
+    /// Restrict allocations of the calling thread to a NUMA node.
+
+    /// @param node Node to allocate from, or -1 to restore the default
+    /// policy.
+    /// @param error Receives a description of the failure, if any.
+    /// @returns true if the policy was applied.
+    static bool setMemoryPolicy(int node, std::string& error)
+    {
+#if defined(__linux__) && defined(SYS_set_mempolicy)
+        unsigned long mask[16];
+        if (!nodeMask(node, mask, error)) {
+            return false;
+        }
+
+        const long result = (node < 0 ?
+            ::syscall(SYS_set_mempolicy, BENCHMARK_MPOL_DEFAULT, NULL, 0) :
+            ::syscall(SYS_set_mempolicy,
+                      BENCHMARK_MPOL_BIND,
+                      mask,
+                      sizeof(mask) * 8));
+        if (result != 0) {
+            error = std::string("set_mempolicy failed: ") + strerror(errno);
+            return false;
+        }
+        return true;
+#else
+        error = "memory policies are not supported";
+        return (node < 0);
+#endif
+    }
+
+
+    /// Bind a memory range to a NUMA node.
+
+    /// Pages already present are migrated.
+    /// @param address Start of the range, page aligned.
+    /// @param length Length of the range in bytes.
+    /// @param node Node to bind to.
+    /// @param error Receives a description of the failure, if any.
+    /// @returns true if the range was bound.
+    static bool bindMemory(void* address,
+                           std::size_t length,
+                           int node,
+                           std::string& error)
+    {
+#if defined(__linux__) && defined(SYS_mbind)
+        unsigned long mask[16];
+        if ((node < 0) || (!nodeMask(node, mask, error))) {
+            if (node < 0) {
+                error = "no NUMA node given";
+            }
+            return false;
+        }
+
+        if (::syscall(SYS_mbind,
+                      address,
+                      length,
+                      BENCHMARK_MPOL_BIND,
+                      mask,
+                      sizeof(mask) * 8,
+                      BENCHMARK_MPOL_MF_MOVE) != 0) {
+            error = std::string("mbind failed: ") + strerror(errno);
+            return false;
+        }
+        return true;
+#else
+        error = "memory policies are not supported";
+        return false;
+#endif
+    }
+private:
+    static bool nodeMask(int node, unsigned long (&mask)[16], std::string& error)
+    {
+        ::memset(mask, 0, sizeof(mask));
+        if (node < 0) {
+            return true;
+        }
+
+        const std::size_t bits = sizeof(unsigned long) * 8;
+        if (std::size_t(node) >= sizeof(mask) * 8) {
+            error = "NUMA node out of range";
+            return false;
+        }
+        mask[std::size_t(node) / bits] |= 1UL << (std::size_t(node) % bits);
+        return true;
+    }
+};
+
+
+/// Applies a placement for the life time of the guard.
+
+/// Pins the calling thread and binds its memory policy, recording what
+/// was actually applied as result metadata. Threads the benchmark starts
+/// inherit both. On destruction the previous affinity and the default
+/// memory policy are restored.
+class PlacementGuard {
+public:
+    /// @param placement Placement to apply.
+    /// @param metadata Receives the effective placement.
+    PlacementGuard(const Placement& placement, ResultMetadata& metadata)
+        :   _previousCpus(CpuTopology::allowedCpus()),
+            _pinned(false),
+            _bound(false)
+    {
+        std::vector<int> cpus = placement.Cpus;
+        if ((cpus.empty()) && (placement.NumaNode >= 0)) {
+            // Keep a narrower affinity, such as a CPU chosen by the
+            // parallel scheduler, if it lies within the node.
+            const std::vector<int> nodeCpus =
+                Placement::nodeCpus(placement.NumaNode);
+            std::set_intersection(_previousCpus.begin(),
+                                  _previousCpus.end(),
+                                  nodeCpus.begin(),
+                                  nodeCpus.end(),
+                                  std::back_inserter(cpus));
+            if (cpus.empty()) {
+                cpus = nodeCpus;
+            }
+        }
+
+        if (!cpus.empty()) {
+            _pinned = CpuTopology::pinCurrentThread(cpus);
+            if (!_pinned) {
+                metadata.push_back(ResultMetadataEntry(
+                    "cpu_affinity_error", strerror(errno)));
+            }
+        }
+
+        if (placement.NumaNode >= 0) {
+            std::string error;
+            _bound = Placement::setMemoryPolicy(placement.NumaNode, error);
+            if (!_bound) {
+                metadata.push_back(ResultMetadataEntry(
+                    "numa_policy_error", error));
+            }
+        }
+
+        std::stringstream node;
+        if (_bound) {
+            node << placement.NumaNode;
+        } else {
+            node << "any";
+        }
+
+        metadata.push_back(ResultMetadataEntry(
+            "cpus", CpuTopology::formatCpuList(CpuTopology::allowedCpus())));
+        metadata.push_back(ResultMetadataEntry("numa_node", node.str()));
+    }
+
+
+    ~PlacementGuard()
+    {
+        if (_pinned) {
+            CpuTopology::pinCurrentThread(_previousCpus);
+        }
+        if (_bound) {
+            std::string error;
+            Placement::setMemoryPolicy(-1, error);
+        }
+    }
+private:
+    PlacementGuard(const PlacementGuard&);
+    PlacementGuard& operator =(const PlacementGuard&);
+private:
+    std::vector<int>  _previousCpus;
+    bool              _pinned;
+    bool              _bound;
+};
+
+}
+#endif
@@ -0,0 +1,348 @@
+#ifndef BENCHMARK_PROFILER_H_
+#define BENCHMARK_PROFILER_H_
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <fcntl.h>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/stat.h>
+#include <sys/time.h>
+#include <sys/types.h>
+#include <unistd.h>
+#if defined(__GLIBC__) || defined(__APPLE__)
+    #include <cxxabi.h>
+    #include <dlfcn.h>
+    #include <execinfo.h>
+    #define BENCHMARK_PROFILER_SUPPORTED 1
+#endif
+
+namespace benchmark {
+
+/// Sampling profiler for timed regions.
+
+/// While a timed region executes, SIGPROF fires at a fixed rate of CPU
+/// time and the signal handler records the call stack of the interrupted
+/// thread into a preallocated buffer. Afterwards the stacks are
+/// symbolized and appended to "<directory>/<name>.folded" as folded
+/// stacks, one "root;...;leaf count" line per distinct stack, ready for
+/// flame graph tools.
+///
+/// Functions are named from the dynamic symbol table, so link the
+/// benchmark with -rdynamic for useful names. Other frames are shown as
+/// module and offset.
+class SamplingProfiler {
+public:
+    /// Sampling frequency in samples per second of CPU time.
+    static const int Frequency = 997;
+
+
+    /// Deepest call stack recorded.
+    static const int MaxDepth = 64;
+
+
+    /// Number of samples buffered per test.
+    static const std::size_t Capacity = 65536;
+
+
+    /// Enable profiling into a directory.
+
+    /// Creates the directory if needed and installs the signal handler.
+    /// @param error Receives a description of the failure, if any.
+    /// @returns true if profiling is enabled.
+    static bool setOutputDirectory(const std::string& directory,
+                                   std::string& error)
+    {
+#if defined(BENCHMARK_PROFILER_SUPPORTED)
+        if ((::mkdir(directory.c_str(), 0777) != 0) && (errno != EEXIST)) {
+            error = std::string("cannot create ") + directory + ": " +
+                strerror(errno);
+            return false;
+        }
+
+        // The first backtrace() may load the unwinder, which is not safe in
+        // a signal handler.
+        void* warmUp[4];
+        ::backtrace(warmUp, 4);
+
+        State& s = state();
+        s.Directory = directory;
+        s.Samples.resize(Capacity);
+
+        struct sigaction action;
+        ::memset(&action, 0, sizeof(action));
+        action.sa_handler = &SamplingProfiler::handle;
+        action.sa_flags = SA_RESTART;
+        sigemptyset(&action.sa_mask);
+        if (::sigaction(SIGPROF, &action, NULL) != 0) {
+            error = std::string("sigaction failed: ") + strerror(errno);
+            return false;
+        }
+
+        s.Enabled = true;
+        return true;
+#else
+        (void)directory;
+        error = "profiling is not supported on this platform";
+        return false;
+#endif
+    }
+
+
+    /// Whether profiling is enabled.
+    static inline bool enabled()
+    {
+        return state().Enabled;
+    }
+
+
+    /// Path of the profile of a test.
+    static std::string outputPath(const std::string& name)
+    {
+        return state().Directory + "/" + name + ".folded";
+    }
+
+
+    /// Start sampling.
+    static void start()
+    {
+        State& s = state();
+        if (!s.Enabled) {
+            return;
+        }
+
+        s.Active = 1;
+        setTimer(1000000 / Frequency);
+    }
+
+
+    /// Stop sampling.
+    static void stop()
+    {
+        State& s = state();
+        if (!s.Enabled) {
+            return;
+        }
+
+        setTimer(0);
+        s.Active = 0;
+    }
+
+
+    /// Discard the samples taken so far.
+    static void discard()
+    {
+        state().Used = 0;
+    }
+
+
+    /// Mark the samples taken so far, for discardSince().
+    static std::size_t mark()
+    {
+        return state().Used;
+    }
+
+
+    /// Discard the samples taken since a mark, e.g. those of a rejected
+    /// run. Sampling must be stopped.
+    static void discardSince(std::size_t mark)
+    {
+        State& s = state();
+        if (s.Used > mark) {
+            s.Used = mark;
+        }
+    }
+
+
+    /// Append the samples taken so far to the profile of a test.
+
+    /// @param name Canonical name of the test.
+    /// @param error Receives a description of the failure, if any.
+    /// @returns true if the profile was written.
+    static bool write(const std::string& name, std::string& error)
+    {
+#if defined(BENCHMARK_PROFILER_SUPPORTED)
+        State& s = state();
+        const std::size_t used = (s.Used < Capacity ? s.Used : Capacity);
+        std::map<std::string, std::size_t> folded;
+        std::map<void*, std::string> symbols;
+
+        for (std::size_t i = 0; i < used; ++i) {
+            const Sample& sample = s.Samples[i];
+            std::string stack;
+
+            // Skip the signal handler and the signal trampoline.
+            for (int frame = sample.Depth - 1; frame >= 2; --frame) {
+                if (!stack.empty()) {
+                    stack += ";";
+                }
+                stack += symbolize(sample.Frames[frame], symbols);
+            }
+            if (!stack.empty()) {
+                ++folded[stack];
+            }
+        }
+        s.Used = 0;
+
+        if (folded.empty()) {
+            return true;
+        }
+
+        std::stringstream text;
+        for (std::map<std::string, std::size_t>::const_iterator it =
+                 folded.begin();
+             it != folded.end();
+             ++it) {
+            text << it->first << " " << it->second << "\n";
+        }
+
+        // Appended in a single write, so concurrent jobs do not interleave.
+        const std::string path = outputPath(name);
+        const std::string data = text.str();
+        const int fd = ::open(path.c_str(),
+                              O_WRONLY | O_CREAT | O_APPEND,
+                              0666);
+        if ((fd < 0) ||
+            (::write(fd, data.data(), data.size()) != ssize_t(data.size()))) {
+            error = std::string("cannot write ") + path + ": " +
+                strerror(errno);
+            if (fd >= 0) {
+                ::close(fd);
+            }
+            return false;
+        }
+        ::close(fd);
+        return true;
+#else
+        (void)name;
+        (void)error;
+        return true;
+#endif
+    }
+
+
+    /// Remove the profile of a test left by an earlier invocation.
+    static void removeOutput(const std::string& name)
+    {
+        ::unlink(outputPath(name).c_str());
+    }
+private:
+    /// Call stack of one sample.
+    struct Sample {
+        Sample()
+            :   Depth(0)
+        {
+
+        }
+
+        int     Depth;
+        void   *Frames[MaxDepth];
+    };
+
+
+    /// Profiler state shared with the signal handler.
+    struct State {
+        State()
+            :   Enabled(false),
+                Active(0),
+                Used(0)
+        {
+
+        }
+
+        bool                  Enabled;
+        volatile sig_atomic_t Active;
+        volatile std::size_t  Used;
+        std::string           Directory;
+        std::vector<Sample>   Samples;
+    };
+
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+
+    static void setTimer(long microseconds)
+    {
+        struct itimerval timer;
+        timer.it_interval.tv_sec = 0;
+        timer.it_interval.tv_usec = microseconds;
+        timer.it_value = timer.it_interval;
+        ::setitimer(ITIMER_PROF, &timer, NULL);
+    }
+
+
+#if defined(BENCHMARK_PROFILER_SUPPORTED)
+    /// Record the stack of the interrupted thread.
+    static void handle(int)
+    {
+        State& s = state();
+        if (!s.Active) {
+            return;
+        }
+
+        const std::size_t slot = __sync_fetch_and_add(&s.Used, 1);
+        if (slot >= Capacity) {
+            return;
+        }
+
+        const int savedErrno = errno;
+        Sample& sample = s.Samples[slot];
+        sample.Depth = ::backtrace(sample.Frames, MaxDepth);
+        errno = savedErrno;
+    }
+
+
+    /// Name of the function containing an address.
+    static const std::string& symbolize(void* address,
+                                        std::map<void*, std::string>& cache)
+    {
+        std::map<void*, std::string>::iterator it = cache.find(address);
+        if (it != cache.end()) {
+            return it->second;
+        }
+
+        std::string name;
+        Dl_info info;
+        if ((::dladdr(address, &info)) && (info.dli_sname)) {
+            int status = 0;
+            char* demangled =
+                abi::__cxa_demangle(info.dli_sname, NULL, NULL, &status);
+            name = ((status == 0) && (demangled) ? demangled : info.dli_sname);
+            ::free(demangled);
+        } else if ((::dladdr(address, &info)) && (info.dli_fname)) {
+            const char* module = strrchr(info.dli_fname, '/');
+            std::stringstream text;
+            text << "[" << (module ? module + 1 : info.dli_fname) << "+0x"
+                 << std::hex
+                 << (static_cast<char*>(address) -
+                     static_cast<char*>(info.dli_fbase))
+                 << "]";
+            name = text.str();
+        } else {
+            std::stringstream text;
+            text << address;
+            name = text.str();
+        }
+
+        // Folded stacks separate frames with ';' and counts with ' '.
+        for (std::size_t i = 0; i < name.size(); ++i) {
+            if (name[i] == ';') {
+                name[i] = ',';
+            }
+        }
+        return (cache[address] = name);
+    }
+#endif
+};
+
+}
+#endif
@@ -0,0 +1,275 @@
+#ifndef BENCHMARK_SOFTWARE_COUNTERS_H_
+#define BENCHMARK_SOFTWARE_COUNTERS_H_
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <stdint.h>
+#include <sys/resource.h>
+#include <sys/time.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sys/syscall.h>
+#endif
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Software event counters of the calling thread.
+
+/// Counts page faults and context switches with getrusage() and, where perf
+/// events are permitted, system calls with the raw_syscalls:sys_enter
+/// tracepoint. Events are counted between begin() and end(), except while
+/// paused, and added as per-iteration counters. Only the calling thread is
+/// counted where the platform allows it, so work handed to other threads is
+/// not included.
+class SoftwareCounters {
+public:
+    SoftwareCounters()
+        :   _active(false),
+            _opened(false),
+            _syscallFd(-1),
+            _pauses(0)
+    {
+
+    }
+
+
+    ~SoftwareCounters()
+    {
+        if (_syscallFd >= 0) {
+            ::close(_syscallFd);
+        }
+    }
+
+
+    /// Enable software counters for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        enabledFlag() = enabled;
+    }
+
+
+    /// Whether software counters are enabled.
+    static bool enabled()
+    {
+        return enabledFlag();
+    }
+
+
+    /// Start counting.
+    void begin()
+    {
+        _active = enabled();
+        if (!_active) {
+            return;
+        }
+
+        if (!_opened) {
+            _opened = true;
+            _syscallFd = openSyscallCounter();
+        }
+
+        _excluded = Snapshot();
+        _pauses = 0;
+        sample(_start, true);
+    }
+
+
+    /// Stop counting until resume(), e.g. while flushing the caches.
+    void pause()
+    {
+        if (!_active) {
+            return;
+        }
+        sample(_paused, false);
+    }
+
+
+    /// Continue counting after pause().
+    void resume()
+    {
+        if (!_active) {
+            return;
+        }
+
+        Snapshot resumed;
+        sample(resumed, true);
+        _excluded.MinorFaults += resumed.MinorFaults - _paused.MinorFaults;
+        _excluded.MajorFaults += resumed.MajorFaults - _paused.MajorFaults;
+        _excluded.VoluntarySwitches +=
+            resumed.VoluntarySwitches - _paused.VoluntarySwitches;
+        _excluded.InvoluntarySwitches +=
+            resumed.InvoluntarySwitches - _paused.InvoluntarySwitches;
+        _excluded.Syscalls += resumed.Syscalls - _paused.Syscalls;
+        ++_pauses;
+    }
+
+
+    /// Stop counting and add the events per iteration.
+
+    /// Nothing is added for runs without iterations.
+    void end(std::size_t iterations)
+    {
+        if (!_active) {
+            return;
+        }
+        _active = false;
+
+        Snapshot stop;
+        sample(stop, false);
+
+        if (!iterations) {
+            return;
+        }
+
+        const double count = double(iterations);
+        _counters["minor_faults_per_iteration"].add(
+            double(stop.MinorFaults - _start.MinorFaults -
+                   _excluded.MinorFaults) / count);
+        _counters["major_faults_per_iteration"].add(
+            double(stop.MajorFaults - _start.MajorFaults -
+                   _excluded.MajorFaults) / count);
+        _counters["voluntary_switches_per_iteration"].add(
+            double(stop.VoluntarySwitches - _start.VoluntarySwitches -
+                   _excluded.VoluntarySwitches) / count);
+        _counters["involuntary_switches_per_iteration"].add(
+            double(stop.InvoluntarySwitches - _start.InvoluntarySwitches -
+                   _excluded.InvoluntarySwitches) / count);
+
+        if (_syscallFd >= 0) {
+            // The reads sampling the stop count and every pause are
+            // counted themselves.
+            const uint64_t syscalls =
+                stop.Syscalls - _start.Syscalls - _excluded.Syscalls;
+            const uint64_t reads = 1 + _pauses;
+            _counters["syscalls_per_iteration"].add(
+                double(syscalls > reads ? syscalls - reads : 0) / count);
+        }
+    }
+
+
+    /// Move the counted events into a set of counters.
+    void collect(ResultCounters& counters)
+    {
+        mergeCounters(counters, _counters);
+        _counters.clear();
+    }
+private:
+    /// Event counts at a point in time.
+    struct Snapshot {
+        Snapshot()
+            :   MinorFaults(0),
+                MajorFaults(0),
+                VoluntarySwitches(0),
+                InvoluntarySwitches(0),
+                Syscalls(0)
+        {
+
+        }
+
+        uint64_t MinorFaults;
+        uint64_t MajorFaults;
+        uint64_t VoluntarySwitches;
+        uint64_t InvoluntarySwitches;
+        uint64_t Syscalls;
+    };
+
+
+    /// Sample the counts.
+
+    /// The system call count is read last when starting or resuming and
+    /// first when stopping or pausing, so only the stopping and pausing
+    /// reads fall inside the interval.
+    void sample(Snapshot& snapshot, bool starting)
+    {
+        if (!starting) {
+            snapshot.Syscalls = readSyscalls();
+        }
+
+        struct rusage usage;
+#if defined(RUSAGE_THREAD)
+        ::getrusage(RUSAGE_THREAD, &usage);
+#else
+        ::getrusage(RUSAGE_SELF, &usage);
+#endif
+        snapshot.MinorFaults = uint64_t(usage.ru_minflt);
+        snapshot.MajorFaults = uint64_t(usage.ru_majflt);
+        snapshot.VoluntarySwitches = uint64_t(usage.ru_nvcsw);
+        snapshot.InvoluntarySwitches = uint64_t(usage.ru_nivcsw);
+
+        if (starting) {
+            snapshot.Syscalls = readSyscalls();
+        }
+    }
+
+
+    uint64_t readSyscalls() const
+    {
+        uint64_t count = 0;
+        if ((_syscallFd < 0) ||
+            (::read(_syscallFd, &count, sizeof(count)) != sizeof(count))) {
+            return 0;
+        }
+        return count;
+    }
+
+
+    /// Open a counter of system calls made by the calling thread.
+
+    /// @returns the perf event descriptor, or -1 if not permitted.
+    static int openSyscallCounter()
+    {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+        static const char* const idPaths[] = {
+            "/sys/kernel/tracing/events/raw_syscalls/sys_enter/id",
+            "/sys/kernel/debug/tracing/events/raw_syscalls/sys_enter/id"
+        };
+
+        std::string id;
+        for (std::size_t i = 0; (i < 2) && (id.empty()); ++i) {
+            std::ifstream file(idPaths[i]);
+            std::getline(file, id);
+        }
+        if (id.empty()) {
+            return -1;
+        }
+
+        struct perf_event_attr attr;
+        ::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_TRACEPOINT;
+        attr.size = sizeof(attr);
+        attr.config = ::strtoull(id.c_str(), NULL, 10);
+
+        return int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+#else
+        return -1;
+#endif
+    }
+
+
+    static bool& enabledFlag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+private:
+    SoftwareCounters(const SoftwareCounters&);
+    SoftwareCounters& operator =(const SoftwareCounters&);
+private:
+    bool            _active;
+    bool            _opened;
+    int             _syscallFd;
+    Snapshot        _start;
+    Snapshot        _paused;
+    Snapshot        _excluded;
+    uint64_t        _pauses;
+    ResultCounters  _counters;
+};
+
+}
+#endif
@@ -0,0 +1,125 @@
+#ifndef BENCHMARK_STEADY_STATE_H_
+#define BENCHMARK_STEADY_STATE_H_
+#include <cerrno>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <fcntl.h>
+#include <signal.h>
+#include <unistd.h>
+
+namespace benchmark {
+
+/// Markers around the steady-state window of a profiled benchmark.
+
+/// Lets an external profiler see only the steady state:
+///
+/// - A perf control FIFO (perf record --control fifo:<ctl>[,<ack>]
+///   --delay=-1) receives "enable" and "disable".
+/// - A line is written to the ftrace trace_marker, where writable, at
+///   either end of the window.
+/// - With pausing enabled, the process stops itself before the window so
+///   a profiler can attach, and continues on SIGCONT.
+class SteadyStateMarkers {
+public:
+    SteadyStateMarkers()
+        :   Pause(false)
+    {
+
+    }
+
+
+    /// Perf control FIFO, or empty for none.
+    std::string PerfControl;
+
+
+    /// Perf acknowledgement FIFO, or empty to not wait for perf.
+    std::string PerfAck;
+
+
+    /// Stop before the window until continued.
+    bool Pause;
+
+
+    /// Mark the beginning of the window.
+    void begin(const std::string& name) const
+    {
+        if (Pause) {
+            std::cerr << "[  PAUSED  ] " << name << ": attach to pid "
+                      << ::getpid() << ", then send SIGCONT to start"
+                      << std::endl;
+            ::raise(SIGSTOP);
+        }
+
+        traceMarker(name + " steady state begin");
+        perfCommand("enable");
+    }
+
+
+    /// Mark the end of the window.
+    void end(const std::string& name) const
+    {
+        perfCommand("disable");
+        traceMarker(name + " steady state end");
+    }
+private:
+    /// Send a command to perf and wait for its acknowledgement.
+    void perfCommand(const char* command) const
+    {
+        if (PerfControl.empty()) {
+            return;
+        }
+
+        // Without a reader, perf is not running: fail instead of blocking.
+        const int fd = ::open(PerfControl.c_str(), O_WRONLY | O_NONBLOCK);
+        if (fd < 0) {
+            std::cerr << "cannot open " << PerfControl << ": "
+                      << strerror(errno) << std::endl;
+            return;
+        }
+        const std::string line = std::string(command) + "\n";
+        if (::write(fd, line.data(), line.size()) < 0) {
+            std::cerr << "cannot write " << PerfControl << ": "
+                      << strerror(errno) << std::endl;
+        }
+        ::close(fd);
+
+        if (!PerfAck.empty()) {
+            const int ack = ::open(PerfAck.c_str(), O_RDONLY);
+            if (ack >= 0) {
+                char buffer[16];
+                while (::read(ack, buffer, sizeof(buffer)) < 0) {
+                    if (errno != EINTR) {
+                        break;
+                    }
+                }
+                ::close(ack);
+            }
+        }
+    }
+
+
+    /// Write a line to the ftrace trace marker, if writable.
+    static void traceMarker(const std::string& text)
+    {
+        static const char* const paths[] = {
+            "/sys/kernel/tracing/trace_marker",
+            "/sys/kernel/debug/tracing/trace_marker"
+        };
+
+        for (std::size_t i = 0; i < 2; ++i) {
+            const int fd = ::open(paths[i], O_WRONLY);
+            if (fd < 0) {
+                continue;
+            }
+            if (::write(fd, text.data(), text.size()) < 0) {
+                // The marker is best effort.
+            }
+            ::close(fd);
+            return;
+        }
+    }
+};
+
+}
+#endif
@@ -0,0 +1,419 @@
+#ifndef BENCHMARK_TABULAR_OUTPUTTER_H_
+#define BENCHMARK_TABULAR_OUTPUTTER_H_
+#include <algorithm>
+#include <cstdio>
+#include <cstdlib>
+#include <string>
+#include <vector>
+#include <benchmark/benchmarker.h>
+#include <benchmark/outputter.h>
+
+namespace benchmark {
+
+/// Writes results as delimiter-separated values.
+
+/// Either one row per test with every statistic of the result, or one
+/// row per run with its raw run time, which requires retained samples.
+/// Every row starts with the fixture, test and parameters followed by one
+/// column per parameter name, so parameters can be filtered and grouped
+/// on directly. Rows are written and flushed as results arrive.
+///
+/// Fields containing the separator, quotes or line breaks are quoted for
+/// CSV. TSV has no quoting, so tabs and line breaks in fields are
+/// replaced by spaces. Numbers are written with full precision.
+class TabularOutputter : public Outputter {
+public:
+    /// @param stream Output stream.
+    /// @param separator Field separator, ',' for CSV or '\t' for TSV.
+    /// @param perRun Whether to write one row per run instead of per test.
+    /// @param parameterNames Names of the parameter columns.
+    TabularOutputter(std::ostream& stream,
+                     char separator,
+                     bool perRun,
+                     const std::vector<std::string>& parameterNames)
+        :   _stream(stream),
+            _separator(separator),
+            _perRun(perRun),
+            _parameterNames(parameterNames)
+    {
+
+    }
+
+
+    /// Names of the parameters of the registered tests.
+
+    /// The variable names of the parameter declarations, in order of
+    /// first appearance.
+    static std::vector<std::string> registeredParameterNames()
+    {
+        std::vector<std::string> names;
+        const std::vector<const TestDescriptor*> tests =
+            BenchMarker::listTests();
+
+        for (std::size_t t = 0; t < tests.size(); ++t) {
+            const std::vector<TestParameterDescriptor>& parameters =
+                tests[t]->Parameters.Parameters();
+            for (std::size_t p = 0; p < parameters.size(); ++p) {
+                const std::string name =
+                    parameterName(parameters[p].Declaration);
+                if (std::find(names.begin(), names.end(), name) ==
+                    names.end()) {
+                    names.push_back(name);
+                }
+            }
+        }
+        return names;
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+        const char* const leading[] = { "fixture", "name", "parameters" };
+        for (std::size_t i = 0; i < 3; ++i) {
+            field(leading[i], i == 0);
+        }
+        for (std::size_t i = 0; i < _parameterNames.size(); ++i) {
+            field(_parameterNames[i]);
+        }
+
+        if (_perRun) {
+            field("run");
+            field("run_time_ns");
+            field("iteration_time_ns");
+        } else {
+            const char* const columns[] = {
+                "status",
+                "reason",
+                "runs",
+                "iterations",
+                "run_time_total_ns",
+                "run_time_mean_ns",
+                "run_time_stddev_ns",
+                "run_time_median_ns",
+                "run_time_q1_ns",
+                "run_time_q3_ns",
+                "run_time_min_ns",
+                "run_time_max_ns",
+                "iteration_time_mean_ns",
+                "iteration_time_stddev_ns",
+                "iteration_time_median_ns",
+                "iteration_time_q1_ns",
+                "iteration_time_q3_ns",
+                "iteration_time_min_ns",
+                "iteration_time_max_ns",
+                "runs_per_second_mean",
+                "runs_per_second_median",
+                "runs_per_second_q1",
+                "runs_per_second_q3",
+                "runs_per_second_min",
+                "runs_per_second_max",
+                "iterations_per_second_mean",
+                "iterations_per_second_median",
+                "iterations_per_second_q1",
+                "iterations_per_second_q3",
+                "iterations_per_second_min",
+                "iterations_per_second_max",
+                "processes",
+                "between_process_stddev_ns",
+                "within_process_stddev_ns",
+                "disturbed_runs",
+                "rejected_runs",
+                "metadata",
+                "counters"
+            };
+            for (std::size_t i = 0;
+                 i < sizeof(columns) / sizeof(columns[0]);
+                 ++i) {
+                field(columns[i]);
+            }
+        }
+        _stream << '\n';
+        _stream.flush();
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        _stream.flush();
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+        if (_perRun) {
+            const std::vector<double>& runTimes = result.runTimes();
+            for (std::size_t i = 0; i < runTimes.size(); ++i) {
+                names(fixtureName, testName, parameters);
+                field(number(double(i)));
+                field(number(runTimes[i]));
+                field(number(runTimes[i] / double(result.iterations())));
+                _stream << '\n';
+            }
+            _stream.flush();
+            return;
+        }
+
+        names(fixtureName, testName, parameters);
+        field("measured");
+        field("");
+        field(number(double(result.runs())));
+        field(number(double(result.iterations())));
+        field(number(result.timeTotal()));
+        field(number(result.runTimeAverage()));
+        field(number(result.runTimeStdDev()));
+        field(number(result.runTimeMedian()));
+        field(number(result.runTimeQuartile1()));
+        field(number(result.runTimeQuartile3()));
+        field(number(result.runTimeMinimum()));
+        field(number(result.runTimeMaximum()));
+        field(number(result.iterationTimeAverage()));
+        field(number(result.iterationTimeStdDev()));
+        field(number(result.iterationTimeMedian()));
+        field(number(result.iterationTimeQuartile1()));
+        field(number(result.iterationTimeQuartile3()));
+        field(number(result.iterationTimeMinimum()));
+        field(number(result.iterationTimeMaximum()));
+        field(number(result.runsPerSecondAverage()));
+        field(number(result.runsPerSecondMedian()));
+        field(number(result.runsPerSecondQuartile1()));
+        field(number(result.runsPerSecondQuartile3()));
+        field(number(result.runsPerSecondMinimum()));
+        field(number(result.runsPerSecondMaximum()));
+        field(number(result.iterationsPerSecondAverage()));
+        field(number(result.iterationsPerSecondMedian()));
+        field(number(result.iterationsPerSecondQuartile1()));
+        field(number(result.iterationsPerSecondQuartile3()));
+        field(number(result.iterationsPerSecondMinimum()));
+        field(number(result.iterationsPerSecondMaximum()));
+        field(number(double(result.processes())));
+        field(number(result.betweenProcessStdDev()));
+        field(number(result.withinProcessStdDev()));
+        field(number(double(result.disturbedRuns())));
+        field(number(double(result.rejectedRuns())));
+
+        // Metadata and counter means as "key=value" lists.
+        std::string metadata;
+        for (std::size_t i = 0; i < result.metadata().size(); ++i) {
+            metadata += (i ? "; " : "") + result.metadata()[i].first + "=" +
+                result.metadata()[i].second;
+        }
+        field(metadata);
+
+        std::string counters;
+        for (ResultCounters::const_iterator it = result.counters().begin();
+             it != result.counters().end();
+             ++it) {
+            counters += (counters.empty() ? "" : "; ") + it->first + "=" +
+                number(it->second.mean());
+        }
+        field(counters);
+
+        _stream << '\n';
+        _stream.flush();
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+        if (_perRun) {
+            return;
+        }
+
+        names(fixtureName, testName, parameters);
+        field("disabled");
+        field("");
+        field(number(double(runsCount)));
+        field(number(double(iterationsCount)));
+        emptyStatistics();
+    }
+
+
+    virtual void failTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          const std::string& reason)
+    {
+        if (_perRun) {
+            return;
+        }
+
+        names(fixtureName, testName, parameters);
+        field("failed");
+        field(reason);
+        field("");
+        field("");
+        emptyStatistics();
+    }
+private:
+    /// Variable name of a parameter declaration, e.g. "speed" for
+    /// "std::size_t speed".
+    static std::string parameterName(const std::string& declaration)
+    {
+        std::string::size_type end = declaration.size();
+        while ((end) && (declaration[end - 1] == ' ')) {
+            --end;
+        }
+
+        std::string::size_type start = end;
+        while ((start) && (identifierCharacter(declaration[start - 1]))) {
+            --start;
+        }
+        return (start < end ?
+                declaration.substr(start, end - start) :
+                declaration);
+    }
+
+
+    static inline bool identifierCharacter(char c)
+    {
+        return (((c >= 'a') && (c <= 'z')) ||
+                ((c >= 'A') && (c <= 'Z')) ||
+                ((c >= '0') && (c <= '9')) ||
+                (c == '_'));
+    }
+
+
+    /// Shortest of 15 or 17 significant digits that reads back exactly.
+    static std::string number(double value)
+    {
+        char buffer[32];
+        ::snprintf(buffer, sizeof(buffer), "%.15g", value);
+        if (::strtod(buffer, NULL) != value) {
+            ::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        }
+        return buffer;
+    }
+
+
+    /// Write the fixture, test, parameters and parameter columns.
+    void names(const std::string& fixtureName,
+               const std::string& testName,
+               const TestParametersDescriptor& parameters)
+    {
+        const std::vector<TestParameterDescriptor>& descs =
+            parameters.Parameters();
+
+        std::string formatted;
+        for (std::size_t i = 0; i < descs.size(); ++i) {
+            formatted += (i ? ", " : "") + descs[i].Declaration + " = " +
+                descs[i].Value;
+        }
+
+        field(fixtureName, true);
+        field(testName);
+        field(formatted);
+
+        for (std::size_t c = 0; c < _parameterNames.size(); ++c) {
+            std::string value;
+            for (std::size_t i = 0; i < descs.size(); ++i) {
+                if (parameterName(descs[i].Declaration) ==
+                    _parameterNames[c]) {
+                    value = descs[i].Value;
+                    break;
+                }
+            }
+            field(value);
+        }
+    }
+
+
+    /// Finish a row without results.
+    void emptyStatistics()
+    {
+        // From run_time_total_ns to counters.
+        for (std::size_t i = 0; i < 34; ++i) {
+            field("");
+        }
+        _stream << '\n';
+        _stream.flush();
+    }
+
+
+    /// Write a field, preceded by the separator unless first in the row.
+    void field(const std::string& value, bool first = false)
+    {
+        if (!first) {
+            _stream << _separator;
+        }
+
+        if (_separator == '\t') {
+            for (std::size_t i = 0; i < value.size(); ++i) {
+                const char c = value[i];
+                _stream << (((c == '\t') || (c == '\n') || (c == '\r')) ?
+                            ' ' :
+                            c);
+            }
+            return;
+        }
+
+        if (value.find_first_of(std::string(1, _separator) + "\"\r\n") ==
+            std::string::npos) {
+            _stream << value;
+            return;
+        }
+
+        _stream << '"';
+        for (std::size_t i = 0; i < value.size(); ++i) {
+            if (value[i] == '"') {
+                _stream << '"';
+            }
+            _stream << value[i];
+        }
+        _stream << '"';
+    }
+private:
+    std::ostream               &_stream;
+    char                        _separator;
+    bool                        _perRun;
+    std::vector<std::string>    _parameterNames;
+};
+
+
+#define TABULAR_OUTPUTTER_IMPLEMENTATION(_prefix, _separator, _perRun)    \
+    class _prefix ## Outputter                                          \
+        :   public TabularOutputter                                     \
+    {                                                                   \
+    public:                                                             \
+        _prefix ## Outputter(std::ostream& stream = std::cout)          \
+            :   TabularOutputter(stream,                                \
+                                 _separator,                            \
+                                 _perRun,                               \
+                                 registeredParameterNames())            \
+        {}                                                              \
+    }
+
+/// One row per test, comma-separated.
+TABULAR_OUTPUTTER_IMPLEMENTATION(Csv, ',', false);
+
+/// One row per test, tab-separated.
+TABULAR_OUTPUTTER_IMPLEMENTATION(Tsv, '\t', false);
+
+/// One row per run, comma-separated.
+TABULAR_OUTPUTTER_IMPLEMENTATION(CsvRuns, ',', true);
+
+/// One row per run, tab-separated.
+TABULAR_OUTPUTTER_IMPLEMENTATION(TsvRuns, '\t', true);
+
+#undef TABULAR_OUTPUTTER_IMPLEMENTATION
+
+}
+#endif
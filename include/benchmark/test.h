@@ -1,9 +1,16 @@
 #ifndef BENCHMARK_TEST_H_
 #define BENCHMARK_TEST_H_
 #include <cstddef>
+#include <benchmark/cache_flusher.h>
 #include <benchmark/clock.h>
 #include <benchmark/test_result.h>
-#include <benchmark/clock.h>
+#include <benchmark/software_counters.h>
+#include <benchmark/allocation_tracker.h>
+#include <benchmark/memory_footprint.h>
+#include <benchmark/profiler.h>
+#include <benchmark/preemption.h>
+#include <benchmark/frequency_meter.h>
+#include <benchmark/trace_recorder.h>
 namespace benchmark{
 
 class Test {
@@ -18,32 +25,158 @@ public:
 
     }
 
-    uint64_t run(std::size_t iterations)
+    virtual uint64_t run(std::size_t iterations)
     {
         std::size_t iteration = iterations;
+        const bool traced = TraceRecorder::enabled();
+        uint64_t traceMark = (traced ? TraceRecorder::now() : 0);
             
         // Set up the testing fixture.
+        beginFootprint();
         setUp();
+        if (traced)
+            traceMark = TraceRecorder::span("setUp", "fixture", traceMark);
+        if (_cacheFlush.Mode == CacheFlushRuns)
+            CacheFlusher::flush(_cacheFlush.Instructions);
+        beginCounting();
 
         // Get the starting time.
         Clock::TimePoint startTime;
         Clock::TimePoint endTime;
+        uint64_t duration = 0;
 
-        startTime = Clock::now();
+        if (_cacheFlush.Mode == CacheFlushIterations) {
+            // Time each iteration on its own, flushing in between. The
+            // clock is then read around every iteration, which is
+            // corrected with the calibration of a single iteration.
+            while (iteration--) {
+                pauseCounting();
+                CacheFlusher::flush(_cacheFlush.Instructions);
+                resumeCounting();
 
-        // Run the test body for each iteration.
-        while (iteration--)
+                startTime = Clock::now();
                 testBody();
+                endTime = Clock::now();
+                duration += Clock::duration(startTime, endTime);
+            }
+        } else if ((traced) &&
+                   (TraceRecorder::iterationInterval()) &&
+                   (!AllocationTracker::enabled())) {
+            // Time every n-th iteration on its own for the trace.
+            const std::size_t interval = TraceRecorder::iterationInterval();
+            std::size_t skip = 0;
+
+            startTime = Clock::now();
+            while (iteration--) {
+                if (skip--) {
+                    testBody();
+                    continue;
+                }
+                skip = interval - 1;
+
+                const uint64_t sampleStart = TraceRecorder::now();
+                testBody();
+                TraceRecorder::span("iteration", "iteration", sampleStart);
+            }
+            endTime = Clock::now();
+            duration = Clock::duration(startTime, endTime);
+        } else {
+            startTime = Clock::now();
+
+            // Run the test body for each iteration.
+            while (iteration--)
+                    testBody();
 
-        // Get the ending time.
-        endTime = Clock::now();
+            // Get the ending time.
+            endTime = Clock::now();
+            duration = Clock::duration(startTime, endTime);
+        }
+        endCounting(iterations);
+        endFootprint();
+        if (traced)
+            traceMark = traceRun(traceMark, iterations, duration);
 
         // Tear down the testing fixture.
         tearDown();
+        if (traced)
+            TraceRecorder::span("tearDown", "fixture", traceMark);
 
         // Return the duration in nanoseconds.
-        return Clock::duration(startTime, endTime);
+        return duration;
+    }
+
+
+    /// Set when to flush the caches around the timed region.
+    virtual void setCacheFlush(const CacheFlush& flush)
+    {
+        _cacheFlush = flush;
+    }
+
+
+    /// When the caches are flushed around the timed region.
+    inline const CacheFlush& cacheFlush() const
+    {
+        return _cacheFlush;
+    }
+
+
+    /// Run a single iteration of the test body.
+
+    /// The fixture is expected to be set up. Used by drivers that schedule
+    /// iterations themselves.
+    inline void runIteration()
+    {
+        testBody();
+    }
+    /// Whether the last run was preempted or migrated.
+    inline bool disturbed() const
+    {
+        return _preemption.disturbed();
+    }
+
+
+    /// Effective CPU frequency of the last run in Hz, or 0 if not
+    /// measured.
+    inline double effectiveFrequency() const
+    {
+        return _frequency.frequency();
+    }
+
+
+    /// Whether the CPU frequency counts user space cycles only.
+    inline bool frequencyUserOnly() const
+    {
+        return _frequency.userOnly();
+    }
+
+
+    /// Why the CPU frequency cannot be measured, if it cannot.
+    inline const std::string& frequencyError() const
+    {
+        return _frequency.error();
+    }
+
+
+    /// Add counters sampled during the last run.
+
+    /// Called once after every run. Tests sampling more than their run
+    /// time merge their samples into the counters here.
+    virtual void collectCounters(ResultCounters& counters)
+    {
+        _softwareCounters.collect(counters);
+        _allocations.collect(counters);
+        _footprint.collect(counters);
+        _frequency.collect(counters);
+    }
+
+
+    Test()
+        :   _elementCount(0)
+    {
+
     }
+
+
     virtual ~Test()
     {
         
@@ -53,6 +186,103 @@ protected:
     {
 
     }
+
+
+    /// Start counting software events and allocations, start profiling,
+    /// watch for preemption and measure the frequency for a run.
+
+    /// Software events are counted innermost, so the system calls of the
+    /// other meters are not counted.
+    inline void beginCounting()
+    {
+        _allocations.begin();
+        SamplingProfiler::start();
+        _preemption.begin();
+        _frequency.begin();
+        _softwareCounters.begin();
+    }
+
+
+    /// Stop counting, profiling, watching for preemption and measuring
+    /// the frequency for a run.
+    inline void endCounting(std::size_t iterations)
+    {
+        _softwareCounters.end(iterations);
+        _frequency.end();
+        _preemption.end();
+        SamplingProfiler::stop();
+        _allocations.end(iterations);
+    }
+
+
+    /// Stop counting, profiling, watching for preemption and measuring
+    /// the frequency until resumeCounting(), for work outside the timed
+    /// region.
+    inline void pauseCounting()
+    {
+        _softwareCounters.pause();
+        _frequency.pause();
+        _preemption.pause();
+        SamplingProfiler::stop();
+    }
+
+
+    /// Continue counting after pauseCounting().
+    inline void resumeCounting()
+    {
+        SamplingProfiler::start();
+        _preemption.resume();
+        _frequency.resume();
+        _softwareCounters.resume();
+    }
+
+
+    /// Record the span of a run for the trace.
+
+    /// @returns the end of the span.
+    static uint64_t traceRun(uint64_t start,
+                             std::size_t iterations,
+                             uint64_t duration)
+    {
+        TraceArguments arguments;
+        arguments.push_back(std::make_pair("iterations", double(iterations)));
+        arguments.push_back(std::make_pair("time_ns", double(duration)));
+        return TraceRecorder::span("run", "run", start, arguments);
+    }
+
+
+    /// Start measuring the memory footprint of a run.
+
+    /// Covers the fixture set up, so memory held by the fixture counts.
+    inline void beginFootprint()
+    {
+        _footprint.begin();
+    }
+
+
+    /// Stop measuring the memory footprint of a run.
+    inline void endFootprint()
+    {
+        _footprint.end(_elementCount);
+    }
+
+
+    /// Report the number of elements the test holds.
+
+    /// The memory footprint is then also reported in bytes per element.
+    /// May be called from setUp() or the test body.
+    inline void setElementCount(std::size_t count)
+    {
+        _elementCount = count;
+    }
+private:
+    SoftwareCounters  _softwareCounters;
+    AllocationTracker _allocations;
+    MemoryFootprint   _footprint;
+    PreemptionDetector _preemption;
+    FrequencyMeter    _frequency;
+    std::size_t       _elementCount;
+    CacheFlush        _cacheFlush;
 };
 
 }
@@ -233,6 +233,14 @@ public:
     }
 
 
+    /// Construct from already parsed parameters.
+    TestParametersDescriptor(const std::vector<TestParameterDescriptor>& parameters)
+        :   _parameters(parameters)
+    {
+
+    }
+
+
     inline const std::vector<TestParameterDescriptor>& Parameters() const
     {
         return _parameters;
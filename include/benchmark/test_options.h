@@ -0,0 +1,152 @@
+#ifndef BENCHMARK_TEST_OPTIONS_H_
+#define BENCHMARK_TEST_OPTIONS_H_
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <benchmark/budget.h>
+#include <benchmark/cache_flusher.h>
+#include <benchmark/cpu_topology.h>
+#include <benchmark/placement.h>
+
+namespace benchmark {
+
+/// Per-benchmark options.
+
+/// Set with BENCHMARK_OPTIONS. Options apply to every parameter instance
+/// of the benchmark and override the corresponding command line options.
+class TestOptions {
+public:
+    TestOptions()
+        :   _cacheFlushSet(false)
+    {
+
+    }
+
+
+    /// Run on a set of CPUs.
+
+    /// @param list CPU list in the kernel's format, e.g. "0-3,8".
+    TestOptions& cpus(const char* list)
+    {
+        std::vector<int> cpus;
+        if ((!CpuTopology::parseCpuList(list, cpus)) || (cpus.empty())) {
+            throw std::invalid_argument(std::string("invalid CPU list: ") +
+                                        list);
+        }
+        _placement.Cpus = cpus;
+        return *this;
+    }
+
+
+    /// Run on and allocate from a NUMA node.
+
+    /// Unless CPUs are given as well, the benchmark runs on all CPUs of
+    /// the node.
+    TestOptions& numaNode(int node)
+    {
+        _placement.NumaNode = node;
+        return *this;
+    }
+
+
+    /// Flush the caches before every run, after the fixture is set up.
+    TestOptions& coldCache()
+    {
+        _cacheFlush.Mode = CacheFlushRuns;
+        _cacheFlushSet = true;
+        return *this;
+    }
+
+
+    /// Flush the caches before every iteration.
+
+    /// Each iteration is then timed on its own, which adds the overhead of
+    /// reading the clock to every iteration. It is subtracted with the
+    /// calibration of a single iteration, which is less precise than
+    /// for a whole run.
+    TestOptions& coldCachePerIteration()
+    {
+        _cacheFlush.Mode = CacheFlushIterations;
+        _cacheFlushSet = true;
+        return *this;
+    }
+
+
+    /// Also evict the instruction caches when flushing.
+
+    /// Flushes before every run unless coldCachePerIteration() is given.
+    TestOptions& flushCode()
+    {
+        if (_cacheFlush.Mode == CacheFlushNone) {
+            _cacheFlush.Mode = CacheFlushRuns;
+        }
+        _cacheFlush.Instructions = true;
+        _cacheFlushSet = true;
+        return *this;
+    }
+
+
+    /// Keep the caches warm even if flushing is enabled for all tests.
+    TestOptions& warmCache()
+    {
+        _cacheFlush = CacheFlush();
+        _cacheFlushSet = true;
+        return *this;
+    }
+
+
+    /// Limit the median time per iteration.
+
+    /// @param nanoseconds Budget in nanoseconds per iteration.
+    TestOptions& medianBudget(double nanoseconds)
+    {
+        _budget.latency(50.0, nanoseconds);
+        return *this;
+    }
+
+
+    /// Limit the 99th percentile of the time per iteration.
+
+    /// @param nanoseconds Budget in nanoseconds per iteration.
+    TestOptions& p99Budget(double nanoseconds)
+    {
+        _budget.latency(99.0, nanoseconds);
+        return *this;
+    }
+
+
+    /// Placement of the benchmark.
+    inline const Placement& placement() const
+    {
+        return _placement;
+    }
+
+
+    /// Cache flushing of the benchmark, or NULL if not set.
+    inline const CacheFlush* cacheFlush() const
+    {
+        return (_cacheFlushSet ? &_cacheFlush : NULL);
+    }
+
+
+    /// Performance budget of the benchmark.
+    inline const Budget& budget() const
+    {
+        return _budget;
+    }
+
+
+    /// Performance budget of the benchmark, to set with BENCHMARK_BUDGET.
+    inline Budget& budget()
+    {
+        return _budget;
+    }
+private:
+    Placement  _placement;
+    CacheFlush _cacheFlush;
+    bool       _cacheFlushSet;
+    Budget     _budget;
+};
+
+}
+#endif
@@ -1,6 +1,10 @@
 #ifndef BENCHMARK_TEST_RESULT_H_
 #define BENCHMARK_TEST_RESULT_H_
 #include <benchmark/clock.h>
+#include <benchmark/statistics.h>
+#include <map>
+#include <string>
+#include <utility>
 #include <vector>
 #include <stdexcept>
 #include <limits>
@@ -8,93 +12,306 @@
 #include <algorithm>
 
 namespace benchmark {
+
+/// Result metadata entry as a key and value.
+typedef std::pair<std::string, std::string> ResultMetadataEntry;
+
+
+/// Ordered result metadata.
+
+/// Describes the conditions a result was measured under, such as the
+/// CPUs it ran on, so that results from different conditions are not
+/// compared by mistake.
+typedef std::vector<ResultMetadataEntry> ResultMetadata;
+
+
+/// Named counters sampled alongside the run times.
+
+/// Names carry their unit, e.g. "operation_latency_ns".
+typedef std::map<std::string, SampleStatistics> ResultCounters;
+
+
+/// Merge counters into another set of counters.
+inline void mergeCounters(ResultCounters& counters,
+                          const ResultCounters& other)
+{
+    for (ResultCounters::const_iterator it = other.begin();
+         it != other.end();
+         ++it) {
+        ResultCounters::iterator existing = counters.find(it->first);
+        if (existing == counters.end()) {
+            counters.insert(*it);
+        } else {
+            existing->second.merge(it->second);
+        }
+    }
+}
+
+
+/// Outcome of checking a result against one limit of its budget.
+class BudgetCheck {
+public:
+    BudgetCheck()
+        :   Limit(0.0),
+            Estimate(0.0),
+            Bound(0.0),
+            Checked(false),
+            Passed(true)
+    {
+
+    }
+
+
+    /// Short name of the limit, e.g. "p99".
+    std::string Name;
+
+
+    /// Human readable outcome, e.g. "p99 812.3 ns/iteration <= 900.0 ns".
+    std::string Description;
+
+
+    /// The limit.
+    double Limit;
+
+
+    /// Point estimate of the measured value.
+    double Estimate;
+
+
+    /// Confidence bound of the measured value the limit is checked against.
+    double Bound;
+
+
+    /// Whether the result had what is needed to check the limit.
+    bool Checked;
+
+
+    /// Whether the limit holds, true if the limit was not checked.
+    bool Passed;
+};
+
+
+/// Budget checks of a result.
+typedef std::vector<BudgetCheck> BudgetChecks;
+
+
+/// Everything measured for a test.
+class TestMeasurement {
+public:
+    TestMeasurement()
+        :   DisturbedRuns(0),
+            RejectedRuns(0)
+    {
+
+    }
+
+
+    /// Run time statistics.
+    SampleStatistics RunTimes;
+
+
+    /// Conditions of the measurement.
+    ResultMetadata Metadata;
+
+
+    /// Counters sampled during the measurement.
+    ResultCounters Counters;
+
+
+    /// Runs kept although preempted or migrated.
+    std::size_t DisturbedRuns;
+
+
+    /// Runs discarded for being preempted or migrated and run again.
+    std::size_t RejectedRuns;
+};
+
+
 class TestResult{
 public: 
     TestResult(const std::vector<uint64_t>& run_times, 
                 std::size_t iterations)
-                :_runTimes(run_times),
-                 _iterations(iterations),
-                 _timeTotal(0),
-                 _timeRunMin(std::numeric_limits<uint64_t>::max()),
-                 _timeRunMax(std::numeric_limits<uint64_t>::min()),
+                :_iterations(iterations),
                  _timeStdDev(0.0),
                  _timeMedian(0.0),
                  _timeQuartile1(0.0),
-                 _timeQuartile3(0.0)
+                 _timeQuartile3(0.0),
+                 _withinProcessVariance(0.0),
+                 _disturbedRuns(0),
+                 _rejectedRuns(0)
     {
-        std::vector<uint64_t>::iterator runIt = _runTimes.begin();
+        _runTimes.retainSamples(true);
 
-        while (runIt != _runTimes.end()) {
-            const uint64_t run = *runIt;
-            _timeTotal += run;
-            if ((runIt == _runTimes.begin()) || (run > _timeRunMax)) {
-                _timeRunMax = run;
-            }
-            if ((runIt == _runTimes.begin()) || (run < _timeRunMin)) {
-                _timeRunMin = run;
-            }
-            ++runIt;
-        }
-        // Calculate standard deviation.
-        const double mean = runTimeAverage();
-        double accu = 0.0;
-        runIt = _runTimes.begin();
-        while (runIt != _runTimes.end()) {
-            const uint64_t run = *runIt;
-            const double diff = double(run) - mean;
-            accu += (diff * diff);
+        std::vector<uint64_t>::const_iterator runIt = run_times.begin();
+        while (runIt != run_times.end()) {
+            _runTimes.add(double(*runIt));
             ++runIt;
         }
 
-        _timeStdDev = std::sqrt(accu / (_runTimes.size() - 1));
+        calculate();
+    }
 
-        // Calculate quartiles.
-        std::vector<uint64_t> sortedRunTimes(_runTimes);
-        std::sort(sortedRunTimes.begin(), sortedRunTimes.end());
 
-        const std::size_t sortedSize = sortedRunTimes.size();
-        const std::size_t sortedSizeHalf = sortedSize / 2;
+    /// Construct a result from streaming run time statistics.
+
+    /// Raw run times are only available through runTimes() if the
+    /// statistics retain samples.
+    TestResult(const SampleStatistics& statistics,
+               std::size_t iterations)
+        :   _runTimes(statistics),
+            _iterations(iterations),
+            _timeStdDev(0.0),
+            _timeMedian(0.0),
+            _timeQuartile1(0.0),
+            _timeQuartile3(0.0),
+            _withinProcessVariance(0.0),
+            _disturbedRuns(0),
+            _rejectedRuns(0)
+    {
+        calculate();
+    }
 
-        if (sortedSize >= 2) {
-            const std::size_t quartile = sortedSizeHalf / 2;
 
-            if ((sortedSize % 2) == 0) {
-                _timeMedian =
-                    (double(sortedRunTimes[sortedSizeHalf - 1]) +
-                     double(sortedRunTimes[sortedSizeHalf])) / 2;
+    /// Construct a result from a measurement.
+    TestResult(const TestMeasurement& measurement,
+               std::size_t iterations)
+        :   _runTimes(measurement.RunTimes),
+            _iterations(iterations),
+            _timeStdDev(0.0),
+            _timeMedian(0.0),
+            _timeQuartile1(0.0),
+            _timeQuartile3(0.0),
+            _withinProcessVariance(0.0),
+            _metadata(measurement.Metadata),
+            _counters(measurement.Counters),
+            _disturbedRuns(measurement.DisturbedRuns),
+            _rejectedRuns(measurement.RejectedRuns)
+    {
+        calculate();
+    }
 
-                _timeQuartile1 =
-                    double(sortedRunTimes[quartile]);
-                _timeQuartile3 =
-                    double(sortedRunTimes[sortedSizeHalf + quartile]);
-            } else {
-                _timeMedian = double(sortedRunTimes[sortedSizeHalf]);
-                _timeQuartile1 = (double(sortedRunTimes[quartile - 1]) +
-                            double(sortedRunTimes[quartile])) / 2;
-                _timeQuartile3 = (double(sortedRunTimes[sortedSizeHalf + (quartile - 1)]) +
-                                 double(sortedRunTimes[sortedSizeHalf + quartile])) / 2;
-            }
-        } else if (sortedSize > 0) {
-            _timeQuartile1 = double(sortedRunTimes[0]);
-            _timeQuartile3 = _timeQuartile1;
-        }
+
+    /// Attach statistics across benchmark processes.
+
+    /// @param processMeans Mean run time of each process.
+    /// @param withinVariance Pooled run time variance within processes.
+    void setProcessStatistics(const RunningStatistics& processMeans,
+                              double withinVariance)
+    {
+        _processMeans = processMeans;
+        _withinProcessVariance = withinVariance;
+    }
+
+
+    /// Attach the outcome of checking the result against its budget.
+    void setBudgetChecks(const BudgetChecks& checks)
+    {
+        _budgetChecks = checks;
+    }
+
+
+    /// Outcome of checking the result against its budget.
+
+    /// Empty unless the test has a budget.
+    inline const BudgetChecks& budgetChecks() const
+    {
+        return _budgetChecks;
+    }
+
+
+    /// Conditions the result was measured under.
+    inline const ResultMetadata& metadata() const
+    {
+        return _metadata;
+    }
+
+
+    /// Counters sampled alongside the run times.
+    inline const ResultCounters& counters() const
+    {
+        return _counters;
+    }
+
+
+    /// Number of runs kept although preempted or migrated.
+    inline std::size_t disturbedRuns() const
+    {
+        return _disturbedRuns;
+    }
+
+
+    /// Number of runs discarded for being preempted or migrated.
+
+    /// Many rejected runs across benchmarks point at a noisy machine
+    /// rather than a noisy benchmark.
+    inline std::size_t rejectedRuns() const
+    {
+        return _rejectedRuns;
     }
+
+
+    /// Number of processes the runs were collected from.
+
+    /// 0 unless results were aggregated across repeated processes.
+    inline std::size_t processes() const
+    {
+        return _processMeans.count();
+    }
+
+
+    /// Standard deviation of the mean run time between processes.
+    inline double betweenProcessStdDev() const
+    {
+        return _processMeans.stdDev();
+    }
+
+
+    /// Pooled standard deviation of run times within a process.
+    inline double withinProcessStdDev() const
+    {
+        return std::sqrt(_withinProcessVariance);
+    }
+
     /// Total time.
     inline double timeTotal() const
     {
-        return static_cast<double>(_timeTotal);
+        return _runTimes.total();
     }
     
-    inline const std::vector<uint64_t>& runTimes() const
+    /// Raw run times.
+
+    /// Empty unless samples were retained.
+    inline const std::vector<double>& runTimes() const
+    {
+        return _runTimes.samples();
+    }
+
+
+    /// Run time statistics.
+    inline const SampleStatistics& runTimeStatistics() const
     {
         return _runTimes;
     }
 
 
+    /// Number of runs.
+    inline std::size_t runs() const
+    {
+        return _runTimes.count();
+    }
+
+
+    /// Iterations per run.
+    inline std::size_t iterations() const
+    {
+        return _iterations;
+    }
+
+
     /// Average time per run.
     inline double runTimeAverage() const
     {
-        return static_cast<double>(_timeTotal) / static_cast<double>(_runTimes.size());
+        return _runTimes.mean();
     }
 
     /// Standard deviation time per run.
@@ -124,14 +341,23 @@ public:
     /// Maximum time per run.
     inline double runTimeMaximum() const
     {
-        return double(_timeRunMax);
+        return _runTimes.maximum();
     }
 
 
     /// Minimum time per run.
     inline double runTimeMinimum() const
     {
-        return double(_timeRunMin);
+        return _runTimes.minimum();
+    }
+
+
+    /// Time per run at an arbitrary quantile.
+
+    /// @param q Quantile in [0, 1], e.g. 0.99 for the 99th percentile.
+    inline double runTimeQuantile(double q) const
+    {
+        return _runTimes.quantile(q);
     }
 
 
@@ -162,14 +388,14 @@ public:
     /// Maximum runs per second.
     inline double runsPerSecondMaximum() const
     {
-        return 1000000000.0 / _timeRunMin;
+        return 1000000000.0 / runTimeMinimum();
     }
 
 
     /// Minimum runs per second.
     inline double runsPerSecondMinimum() const
     {
-        return 1000000000.0 / _timeRunMax;
+        return 1000000000.0 / runTimeMaximum();
     }
 
 
@@ -206,14 +432,21 @@ public:
     /// Minimum time per iteration.
     inline double iterationTimeMinimum() const
     {
-        return _timeRunMin / static_cast<double>(_iterations);
+        return runTimeMinimum() / static_cast<double>(_iterations);
     }
 
 
     /// Maximum time per iteration.
     inline double iterationTimeMaximum() const
     {
-        return _timeRunMax / static_cast<double>(_iterations);
+        return runTimeMaximum() / static_cast<double>(_iterations);
+    }
+
+
+    /// Time per iteration at an arbitrary quantile.
+    inline double iterationTimeQuantile(double q) const
+    {
+        return runTimeQuantile(q) / static_cast<double>(_iterations);
     }
 
 
@@ -255,15 +488,69 @@ public:
     }
 
 private:
-    std::vector<uint64_t>     _runTimes;
+    /// Derive the summary statistics.
+
+    /// Quartiles are computed exactly from the sorted samples while the
+    /// digest still holds every run individually, and are otherwise
+    /// estimated from the digest.
+    void calculate()
+    {
+        _timeStdDev = _runTimes.stdDev();
+
+        const QuantileDigest& digest = _runTimes.digest();
+
+        if (!digest.exact()) {
+            _timeMedian = _runTimes.quantile(0.5);
+            _timeQuartile1 = _runTimes.quantile(0.25);
+            _timeQuartile3 = _runTimes.quantile(0.75);
+            return;
+        }
+
+        const std::vector<QuantileDigest::Centroid>& sortedRunTimes =
+            digest.centroids();
+
+        const std::size_t sortedSize = sortedRunTimes.size();
+        const std::size_t sortedSizeHalf = sortedSize / 2;
+
+        if (sortedSize >= 2) {
+            const std::size_t quartile = sortedSizeHalf / 2;
+
+            if ((sortedSize % 2) == 0) {
+                _timeMedian =
+                    (sortedRunTimes[sortedSizeHalf - 1].Mean +
+                     sortedRunTimes[sortedSizeHalf].Mean) / 2;
+
+                _timeQuartile1 =
+                    sortedRunTimes[quartile].Mean;
+                _timeQuartile3 =
+                    sortedRunTimes[sortedSizeHalf + quartile].Mean;
+            } else {
+                _timeMedian = sortedRunTimes[sortedSizeHalf].Mean;
+                const std::size_t below = (quartile ? quartile - 1 : 0);
+                _timeQuartile1 = (sortedRunTimes[below].Mean +
+                            sortedRunTimes[quartile].Mean) / 2;
+                _timeQuartile3 = (sortedRunTimes[sortedSizeHalf + below].Mean +
+                                 sortedRunTimes[sortedSizeHalf + quartile].Mean) / 2;
+            }
+        } else if (sortedSize > 0) {
+            _timeQuartile1 = sortedRunTimes[0].Mean;
+            _timeQuartile3 = _timeQuartile1;
+        }
+    }
+private:
+    SampleStatistics          _runTimes;
     std::size_t               _iterations;
-    uint64_t                  _timeTotal;
-    uint64_t                  _timeRunMin;
-    uint64_t                  _timeRunMax;
     double                    _timeStdDev;
     double                    _timeMedian;
     double                    _timeQuartile1;
     double                    _timeQuartile3;
+    RunningStatistics         _processMeans;
+    double                    _withinProcessVariance;
+    ResultMetadata            _metadata;
+    ResultCounters            _counters;
+    std::size_t               _disturbedRuns;
+    std::size_t               _rejectedRuns;
+    BudgetChecks              _budgetChecks;
 };
 }
 
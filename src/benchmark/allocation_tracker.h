@@ -0,0 +1,184 @@
+#ifndef BENCHMARK_ALLOCATION_TRACKER_H_
+#define BENCHMARK_ALLOCATION_TRACKER_H_
+#include <cstddef>
+#include <stdint.h>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Heap allocation tracker.
+
+/// Counts heap allocations, frees and bytes while a timed region is being
+/// tracked. The counts are fed by the allocation hooks of benchmark_main,
+/// built only with BENCHMARK_ALLOCATION_HOOKS; without them, or when
+/// tracking is disabled, nothing is counted and the hooks only test a flag.
+/// Allocations by every thread are counted while a region is tracked, so
+/// work handed to other threads is included.
+class AllocationTracker {
+public:
+    AllocationTracker()
+        :   _active(false),
+            _startAllocations(0),
+            _startFrees(0),
+            _startBytes(0)
+    {
+
+    }
+
+
+    /// Enable allocation tracking for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        state().Enabled = enabled;
+    }
+
+
+    /// Whether allocation tracking is enabled.
+    static bool enabled()
+    {
+        return state().Enabled;
+    }
+
+
+    /// Whether the allocation hooks are linked in.
+    static bool available()
+    {
+        return state().Hooked;
+    }
+
+
+    /// Mark the allocation hooks as linked in.
+    static void setAvailable()
+    {
+        state().Hooked = true;
+    }
+
+
+    /// Whether a region is being tracked.
+    static inline bool tracking()
+    {
+        return state().Tracking;
+    }
+
+
+    /// Record an allocation.
+
+    /// @param bytes Usable size of the allocated block.
+    static inline void recordAllocation(std::size_t bytes)
+    {
+        State& s = state();
+        __sync_fetch_and_add(&s.Allocations, 1);
+        __sync_fetch_and_add(&s.Bytes, uint64_t(bytes));
+
+        const int64_t live =
+            __sync_add_and_fetch(&s.LiveBytes, int64_t(bytes));
+        int64_t peak = s.PeakLiveBytes;
+        while ((live > peak) &&
+               (!__sync_bool_compare_and_swap(&s.PeakLiveBytes, peak, live))) {
+            peak = s.PeakLiveBytes;
+        }
+    }
+
+
+    /// Record a free.
+
+    /// @param bytes Usable size of the freed block.
+    static inline void recordFree(std::size_t bytes)
+    {
+        State& s = state();
+        __sync_fetch_and_add(&s.Frees, 1);
+        __sync_fetch_and_sub(&s.LiveBytes, int64_t(bytes));
+    }
+
+
+    /// Start tracking the timed region.
+    void begin()
+    {
+        State& s = state();
+        _active = (s.Enabled && s.Hooked);
+        if (!_active) {
+            return;
+        }
+
+        _startAllocations = s.Allocations;
+        _startFrees = s.Frees;
+        _startBytes = s.Bytes;
+        s.LiveBytes = 0;
+        s.PeakLiveBytes = 0;
+        __sync_synchronize();
+        s.Tracking = true;
+    }
+
+
+    /// Stop tracking and add the counts per iteration.
+
+    /// Nothing is added for runs without iterations.
+    void end(std::size_t iterations)
+    {
+        if (!_active) {
+            return;
+        }
+        _active = false;
+
+        State& s = state();
+        s.Tracking = false;
+        __sync_synchronize();
+
+        if (!iterations) {
+            return;
+        }
+
+        const double count = double(iterations);
+        _counters["allocations_per_iteration"].add(
+            double(s.Allocations - _startAllocations) / count);
+        _counters["frees_per_iteration"].add(
+            double(s.Frees - _startFrees) / count);
+        _counters["allocated_bytes_per_iteration"].add(
+            double(s.Bytes - _startBytes) / count);
+        _counters["peak_live_bytes"].add(double(s.PeakLiveBytes));
+    }
+
+
+    /// Move the counts into a set of counters.
+    void collect(ResultCounters& counters)
+    {
+        mergeCounters(counters, _counters);
+        _counters.clear();
+    }
+private:
+    /// Process-wide counts.
+
+    /// Plain data, so it is usable from the allocation hooks before any
+    /// constructor has run.
+    struct State {
+        volatile bool       Enabled;
+        volatile bool       Hooked;
+        volatile bool       Tracking;
+        uint64_t            Allocations;
+        uint64_t            Frees;
+        uint64_t            Bytes;
+        int64_t             LiveBytes;
+        int64_t             PeakLiveBytes;
+    };
+
+
+    static inline State& state()
+    {
+        static State s;
+        return s;
+    }
+private:
+    AllocationTracker(const AllocationTracker&);
+    AllocationTracker& operator =(const AllocationTracker&);
+private:
+    bool            _active;
+    uint64_t        _startAllocations;
+    uint64_t        _startFrees;
+    uint64_t        _startBytes;
+    ResultCounters  _counters;
+};
+
+}
+#endif
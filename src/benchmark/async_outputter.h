@@ -0,0 +1,358 @@
+#ifndef BENCHMARK_ASYNC_OUTPUTTER_H_
+#define BENCHMARK_ASYNC_OUTPUTTER_H_
+#include <cstddef>
+#include <string>
+#include <vector>
+#include <pthread.h>
+#include <sched.h>
+#include <signal.h>
+#include <benchmark/environment.h>
+#include <benchmark/outputter.h>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Dispatches output events to other outputters on a background thread.
+
+/// Every event is copied into a single-producer, single-consumer ring of
+/// fixed capacity and returns without formatting or writing anything. A
+/// dispatcher thread drains the ring in batches, calling the wrapped
+/// outputters in order, and sleeps on a condition variable when the ring
+/// is empty; the producer only takes the lock to wake it. end() waits for
+/// every event to be dispatched, so all output is written when it returns.
+///
+/// Events must come from one thread. If the dispatcher thread cannot be
+/// started, events are dispatched synchronously instead.
+class AsyncOutputter : public Outputter {
+public:
+    /// @param outputters Outputters to dispatch to. Expected to be
+    /// available during the life time of the outputter.
+    /// @param start Whether to start the dispatcher thread. Events are
+    /// dispatched synchronously otherwise.
+    AsyncOutputter(const std::vector<Outputter*>& outputters,
+                   bool start = true)
+        :   _outputters(outputters),
+            _head(0),
+            _tail(0),
+            _sleeping(false),
+            _stopping(false),
+            _running(false)
+    {
+        for (std::size_t i = 0; i < Capacity; ++i) {
+            _ring[i] = NULL;
+        }
+
+        ::pthread_mutex_init(&_mutex, NULL);
+        ::pthread_cond_init(&_wake, NULL);
+        if (start) {
+            _running =
+                (::pthread_create(&_thread, NULL, dispatch, this) == 0);
+        }
+    }
+
+
+    virtual ~AsyncOutputter()
+    {
+        stop();
+        ::pthread_cond_destroy(&_wake);
+        ::pthread_mutex_destroy(&_mutex);
+    }
+
+
+    virtual void environment(const Environment& environment)
+    {
+        Event* event = new Event(EventEnvironment);
+        event->Environment = environment;
+        push(event);
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+        Event* event = new Event(EventBegin);
+        event->First = enabledCount;
+        event->Second = disabledCount;
+        push(event);
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        Event* event = new Event(EventEnd);
+        event->First = executedCount;
+        event->Second = disabledCount;
+        push(event);
+        stop();
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+        Event* event = new Event(EventBeginTest);
+        event->FixtureName = fixtureName;
+        event->TestName = testName;
+        event->Parameters = parameters;
+        event->First = runsCount;
+        event->Second = iterationsCount;
+        push(event);
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+        Event* event = new Event(EventEndTest);
+        event->FixtureName = fixtureName;
+        event->TestName = testName;
+        event->Parameters = parameters;
+        event->Result = new TestResult(result);
+        push(event);
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+        Event* event = new Event(EventSkipDisabledTest);
+        event->FixtureName = fixtureName;
+        event->TestName = testName;
+        event->Parameters = parameters;
+        event->First = runsCount;
+        event->Second = iterationsCount;
+        push(event);
+    }
+
+
+    virtual void failTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          const std::string& reason)
+    {
+        Event* event = new Event(EventFailTest);
+        event->FixtureName = fixtureName;
+        event->TestName = testName;
+        event->Parameters = parameters;
+        event->Reason = reason;
+        push(event);
+    }
+private:
+    /// Events in the ring at most.
+    static const std::size_t Capacity = 1024;
+
+
+    enum EventKind {
+        EventEnvironment,
+        EventBegin,
+        EventEnd,
+        EventBeginTest,
+        EventEndTest,
+        EventSkipDisabledTest,
+        EventFailTest
+    };
+
+
+    /// Copy of the arguments of an outputter call.
+    struct Event {
+        Event(EventKind kind)
+            :   Kind(kind),
+                First(0),
+                Second(0),
+                Result(NULL)
+        {
+
+        }
+
+
+        ~Event()
+        {
+            delete Result;
+        }
+
+        EventKind                 Kind;
+        ::benchmark::Environment  Environment;
+        std::string               FixtureName;
+        std::string               TestName;
+        TestParametersDescriptor  Parameters;
+        std::size_t               First;
+        std::size_t               Second;
+        TestResult               *Result;
+        std::string               Reason;
+    private:
+        Event(const Event&);
+        Event& operator =(const Event&);
+    };
+
+
+    /// Queue an event, or dispatch it if there is no dispatcher thread.
+    void push(Event* event)
+    {
+        if (!_running) {
+            deliver(*event);
+            delete event;
+            return;
+        }
+
+        // Wait for room; the dispatcher frees a slot per event.
+        const std::size_t tail = _tail;
+        while (tail - _head >= Capacity) {
+            wake();
+            ::sched_yield();
+        }
+
+        _ring[tail % Capacity] = event;
+        __sync_synchronize();
+        _tail = tail + 1;
+
+        // The store to the tail must be visible before the flag is read,
+        // pairing with the dispatcher setting the flag before rechecking.
+        __sync_synchronize();
+        if (_sleeping) {
+            wake();
+        }
+    }
+
+
+    void wake()
+    {
+        ::pthread_mutex_lock(&_mutex);
+        ::pthread_cond_signal(&_wake);
+        ::pthread_mutex_unlock(&_mutex);
+    }
+
+
+    /// Wait for the dispatcher thread to drain the ring and finish.
+    void stop()
+    {
+        if (!_running) {
+            return;
+        }
+
+        ::pthread_mutex_lock(&_mutex);
+        _stopping = true;
+        ::pthread_cond_signal(&_wake);
+        ::pthread_mutex_unlock(&_mutex);
+
+        ::pthread_join(_thread, NULL);
+        _running = false;
+    }
+
+
+    /// Call the outputters for an event.
+    void deliver(const Event& event)
+    {
+        for (std::size_t i = 0; i < _outputters.size(); ++i) {
+            Outputter& outputter = *_outputters[i];
+
+            switch (event.Kind) {
+            case EventEnvironment:
+                outputter.environment(event.Environment);
+                break;
+            case EventBegin:
+                outputter.begin(event.First, event.Second);
+                break;
+            case EventEnd:
+                outputter.end(event.First, event.Second);
+                break;
+            case EventBeginTest:
+                outputter.beginTest(event.FixtureName,
+                                    event.TestName,
+                                    event.Parameters,
+                                    event.First,
+                                    event.Second);
+                break;
+            case EventEndTest:
+                outputter.endTest(event.FixtureName,
+                                  event.TestName,
+                                  event.Parameters,
+                                  *event.Result);
+                break;
+            case EventSkipDisabledTest:
+                outputter.skipDisabledTest(event.FixtureName,
+                                           event.TestName,
+                                           event.Parameters,
+                                           event.First,
+                                           event.Second);
+                break;
+            case EventFailTest:
+                outputter.failTest(event.FixtureName,
+                                   event.TestName,
+                                   event.Parameters,
+                                   event.Reason);
+                break;
+            }
+        }
+    }
+
+
+    /// Dispatcher thread.
+    static void* dispatch(void* context)
+    {
+        AsyncOutputter& self = *static_cast<AsyncOutputter*>(context);
+
+        // Leave signals, including the profiler's, to the runner thread.
+        sigset_t signals;
+        sigfillset(&signals);
+        ::pthread_sigmask(SIG_BLOCK, &signals, NULL);
+
+        for (;;) {
+            // Dispatch the events queued so far as one batch.
+            __sync_synchronize();
+            const std::size_t tail = self._tail;
+            std::size_t head = self._head;
+
+            while (head != tail) {
+                Event* event = self._ring[head % Capacity];
+                self.deliver(*event);
+                delete event;
+                ++head;
+            }
+            __sync_synchronize();
+            self._head = head;
+
+            // Sleep until more events are queued or the outputter stops.
+            ::pthread_mutex_lock(&self._mutex);
+            self._sleeping = true;
+            __sync_synchronize();
+            bool idle = (self._tail == head);
+            if ((idle) && (self._stopping)) {
+                self._sleeping = false;
+                ::pthread_mutex_unlock(&self._mutex);
+                break;
+            }
+            if (idle) {
+                ::pthread_cond_wait(&self._wake, &self._mutex);
+            }
+            self._sleeping = false;
+            ::pthread_mutex_unlock(&self._mutex);
+        }
+        return NULL;
+    }
+private:
+    AsyncOutputter(const AsyncOutputter&);
+    AsyncOutputter& operator =(const AsyncOutputter&);
+private:
+    std::vector<Outputter*>   _outputters;
+    Event                    *_ring[Capacity];
+    volatile std::size_t      _head;
+    volatile std::size_t      _tail;
+    volatile bool             _sleeping;
+    volatile bool             _stopping;
+    bool                      _running;
+    pthread_t                 _thread;
+    pthread_mutex_t           _mutex;
+    pthread_cond_t            _wake;
+};
+
+}
+#endif
@@ -1,10 +1,16 @@
 #ifndef BENCHMARK_BENCHMARK_H_
 #define BENCHMARK_BENCHMARK_H_
 #include <benchmark/test.h>
+#include <benchmark/async_test.h>
 #include <benchmark/benchmarker.h>
 #include <benchmark/default_test_factory.h>
 #include <benchmark/fixture.h>
+#include <benchmark/fixture_memory.h>
 #include <benchmark/console_outputter.h>
+#include <benchmark/columnar_outputter.h>
+#include <benchmark/tabular_outputter.h>
+#include <benchmark/junit_xml_outputter.h>
+#include <benchmark/trace_outputter.h>
 #include <benchmark/clock.h>
 
 #define BENCHMARK_VERSION "1.0.0"
@@ -65,6 +71,70 @@
                runs,                                     \
                iterations)
 
+#define BENCHMARK_ASYNC_(fixture_name,                                  \
+                         benchmark_name,                                \
+                         fixture_class_name,                            \
+                         runs,                                          \
+                         iterations,                                    \
+                         in_flight)                                     \
+    class BENCHMARK_CLASS_NAME_(fixture_name, benchmark_name)           \
+        :   public fixture_class_name                                   \
+    {                                                                   \
+    public:                                                             \
+        BENCHMARK_CLASS_NAME_(fixture_name, benchmark_name)()           \
+        {                                                               \
+            this->setMaxInFlight(in_flight);                            \
+        }                                                               \
+    protected:                                                          \
+        virtual void startOperation(                                    \
+            ::benchmark::AsyncTest::Completion& completion);            \
+    private:                                                            \
+        static const ::benchmark::TestDescriptor* _descriptor;          \
+    };                                                                  \
+                                                                        \
+    const ::benchmark::TestDescriptor*                                  \
+    BENCHMARK_CLASS_NAME_(fixture_name, benchmark_name)::_descriptor =  \
+        ::benchmark::BenchMarker::instance().registerTest(              \
+            #fixture_name,                                              \
+            #benchmark_name,                                            \
+            runs,                                                       \
+            iterations,                                                 \
+            new ::benchmark::TestFactoryDefault<                        \
+                BENCHMARK_CLASS_NAME_(fixture_name, benchmark_name)     \
+            >(),                                                        \
+            ::benchmark::TestParametersDescriptor());                   \
+                                                                        \
+    void BENCHMARK_CLASS_NAME_(fixture_name, benchmark_name)::startOperation( \
+        ::benchmark::AsyncTest::Completion& completion)
+
+/// Asynchronous benchmark with a fixture derived from AsyncTest.
+
+/// The body starts one operation and calls completion.complete() once it
+/// has finished; up to in_flight operations are outstanding at once.
+#define BENCHMARK_ASYNC_F(fixture_name,                  \
+                          benchmark_name,                \
+                          runs,                          \
+                          iterations,                    \
+                          in_flight)                     \
+    BENCHMARK_ASYNC_(fixture_name,                       \
+                     benchmark_name,                     \
+                     fixture_name,                       \
+                     runs,                               \
+                     iterations,                         \
+                     in_flight)
+
+#define BENCHMARK_ASYNC(fixture_name,                    \
+                        benchmark_name,                  \
+                        runs,                            \
+                        iterations,                      \
+                        in_flight)                       \
+    BENCHMARK_ASYNC_(fixture_name,                       \
+                     benchmark_name,                     \
+                     ::benchmark::AsyncTest,             \
+                     runs,                               \
+                     iterations,                         \
+                     in_flight)
+
 #define BENCHMARK_P_(fixture_name,                                      \
                      benchmark_name,                                    \
                      fixture_class_name,                                \
@@ -127,6 +197,43 @@
 #define BENCHMARK_P_INSTANCE(fixture_name, benchmark_name, arguments)   \
     BENCHMARK_P_INSTANCE1(fixture_name, benchmark_name, arguments, BENCHMARK_P_ID_)
 
+#define BENCHMARK_OPTIONS_CLASS_NAME_(fixture_name, benchmark_name)    \
+    fixture_name ## _ ## benchmark_name ## _Options
+
+/// Set options of a benchmark, e.g.
+/// BENCHMARK_OPTIONS(Fixture, Name, cpus("2-3").numaNode(0))
+#define BENCHMARK_OPTIONS(fixture_name, benchmark_name, options)       \
+    class BENCHMARK_OPTIONS_CLASS_NAME_(fixture_name, benchmark_name)   \
+    {                                                                   \
+    private:                                                            \
+        static const ::benchmark::TestOptions* _options;                \
+    };                                                                  \
+                                                                        \
+    const ::benchmark::TestOptions*                                     \
+    BENCHMARK_OPTIONS_CLASS_NAME_(fixture_name, benchmark_name)::_options = \
+        &::benchmark::BenchMarker::testOptions(#fixture_name,           \
+                                               #benchmark_name).options
+
+#define BENCHMARK_BUDGET_CLASS_NAME_(fixture_name, benchmark_name)     \
+    fixture_name ## _ ## benchmark_name ## _Budget
+
+/// Set the performance budget of a benchmark, e.g.
+/// BENCHMARK_BUDGET(Fixture, Name, latency(99, 500).allocations(0))
+///
+/// Budgets are checked after the benchmark ran; a violated budget makes
+/// the benchmark program exit with a failure.
+#define BENCHMARK_BUDGET(fixture_name, benchmark_name, limits)         \
+    class BENCHMARK_BUDGET_CLASS_NAME_(fixture_name, benchmark_name)    \
+    {                                                                   \
+    private:                                                            \
+        static const ::benchmark::Budget* _budget;                      \
+    };                                                                  \
+                                                                        \
+    const ::benchmark::Budget*                                          \
+    BENCHMARK_BUDGET_CLASS_NAME_(fixture_name, benchmark_name)::_budget = \
+        &::benchmark::BenchMarker::testOptions(#fixture_name,           \
+                                               #benchmark_name).budget().limits
+
 
 
 
@@ -1,11 +1,301 @@
 #include <benchmark/benchmark_main.h>
 
+#if defined(BENCHMARK_ALLOCATION_HOOKS) && defined(__GLIBC__)
+#include <errno.h>
+#include <malloc.h>
+#include <new>
+
+// Allocation hooks feeding the allocation tracker. They forward to the
+// glibc allocator, replacing any other linked in, so they are only built
+// with BENCHMARK_ALLOCATION_HOOKS. They only test a flag unless a timed
+// region is tracked.
+extern "C" {
+    void* __libc_malloc(size_t size);
+    void* __libc_calloc(size_t count, size_t size);
+    void* __libc_realloc(void* pointer, size_t size);
+    void* __libc_memalign(size_t alignment, size_t size);
+    void* __libc_valloc(size_t size);
+    void* __libc_pvalloc(size_t size);
+    void __libc_free(void* pointer);
+}
+
+namespace {
+    inline void* trackAllocation(void* pointer)
+    {
+        if ((pointer) && (::benchmark::AllocationTracker::tracking())) {
+            ::benchmark::AllocationTracker::recordAllocation(
+                malloc_usable_size(pointer));
+        }
+        return pointer;
+    }
+
+    inline void trackFree(void* pointer)
+    {
+        if ((pointer) && (::benchmark::AllocationTracker::tracking())) {
+            ::benchmark::AllocationTracker::recordFree(
+                malloc_usable_size(pointer));
+        }
+    }
+}
+
+extern "C" {
+    void* malloc(size_t size)
+    {
+        return trackAllocation(__libc_malloc(size));
+    }
+
+    void* calloc(size_t count, size_t size)
+    {
+        return trackAllocation(__libc_calloc(count, size));
+    }
+
+    void* realloc(void* pointer, size_t size)
+    {
+        // The old block is only freed when realloc succeeds, or when it
+        // frees the block for a size of 0. Its size is unknown afterwards.
+        const bool tracked = ((pointer) &&
+                              (::benchmark::AllocationTracker::tracking()));
+        const size_t previous = (tracked ? malloc_usable_size(pointer) : 0);
+
+        void* result = __libc_realloc(pointer, size);
+        if ((tracked) && ((result) || (!size))) {
+            ::benchmark::AllocationTracker::recordFree(previous);
+        }
+        return trackAllocation(result);
+    }
+
+    void free(void* pointer)
+    {
+        trackFree(pointer);
+        __libc_free(pointer);
+    }
+
+    int posix_memalign(void** result, size_t alignment, size_t size)
+    {
+        if ((!alignment) ||
+            (alignment % sizeof(void*)) ||
+            (alignment & (alignment - 1))) {
+            return EINVAL;
+        }
+
+        void* pointer = trackAllocation(__libc_memalign(alignment, size));
+        if (!pointer) {
+            return ENOMEM;
+        }
+        *result = pointer;
+        return 0;
+    }
+
+    void* aligned_alloc(size_t alignment, size_t size)
+    {
+        return trackAllocation(__libc_memalign(alignment, size));
+    }
+
+    void* memalign(size_t alignment, size_t size)
+    {
+        return trackAllocation(__libc_memalign(alignment, size));
+    }
+
+    void* valloc(size_t size)
+    {
+        return trackAllocation(__libc_valloc(size));
+    }
+
+    void* pvalloc(size_t size)
+    {
+        return trackAllocation(__libc_pvalloc(size));
+    }
+}
+
+void* operator new(std::size_t size)
+{
+    void* pointer = trackAllocation(__libc_malloc(size ? size : 1));
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size)
+{
+    return operator new(size);
+}
+
+void* operator new(std::size_t size, const std::nothrow_t&) bm_noexcept
+{
+    return trackAllocation(__libc_malloc(size ? size : 1));
+}
+
+void* operator new[](std::size_t size, const std::nothrow_t&) bm_noexcept
+{
+    return trackAllocation(__libc_malloc(size ? size : 1));
+}
+
+void operator delete(void* pointer) bm_noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete[](void* pointer) bm_noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer, const std::nothrow_t&) bm_noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete[](void* pointer, const std::nothrow_t&) bm_noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+#if defined(__cpp_sized_deallocation)
+void operator delete(void* pointer, std::size_t) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete[](void* pointer, std::size_t) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+#endif
+
+#if defined(__cpp_aligned_new)
+void* operator new(std::size_t size, std::align_val_t alignment)
+{
+    void* pointer = trackAllocation(
+        __libc_memalign(std::size_t(alignment), size ? size : 1));
+    if (!pointer) {
+        throw std::bad_alloc();
+    }
+    return pointer;
+}
+
+void* operator new[](std::size_t size, std::align_val_t alignment)
+{
+    return operator new(size, alignment);
+}
+
+void* operator new(std::size_t size,
+                   std::align_val_t alignment,
+                   const std::nothrow_t&) noexcept
+{
+    return trackAllocation(
+        __libc_memalign(std::size_t(alignment), size ? size : 1));
+}
+
+void* operator new[](std::size_t size,
+                     std::align_val_t alignment,
+                     const std::nothrow_t&) noexcept
+{
+    return trackAllocation(
+        __libc_memalign(std::size_t(alignment), size ? size : 1));
+}
+
+void operator delete(void* pointer, std::align_val_t) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete[](void* pointer, std::align_val_t) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete(void* pointer,
+                     std::align_val_t,
+                     const std::nothrow_t&) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+
+void operator delete[](void* pointer,
+                       std::align_val_t,
+                       const std::nothrow_t&) noexcept
+{
+    trackFree(pointer);
+    __libc_free(pointer);
+}
+#endif
+#endif
+
+#if defined(__GNUC__)
+// Code region executed to evict the instruction caches, micro-op cache
+// and branch predictors. Unified caches are already evicted by the data
+// flush. A binary tree of templates instantiates 256 distinct leaf
+// functions of about a kilobyte each.
+#define BENCHMARK_CODE_STEP(_shift)                                     \
+    sink = sink * 33 + (N >> (_shift));                                 \
+    sink = sink ^ (N << (_shift));
+#define BENCHMARK_CODE_STEPS(_shift)                                    \
+    BENCHMARK_CODE_STEP(_shift) BENCHMARK_CODE_STEP(_shift + 1)         \
+    BENCHMARK_CODE_STEP(_shift + 2) BENCHMARK_CODE_STEP(_shift + 3)     \
+    BENCHMARK_CODE_STEP(_shift + 4) BENCHMARK_CODE_STEP(_shift + 5)     \
+    BENCHMARK_CODE_STEP(_shift + 6) BENCHMARK_CODE_STEP(_shift + 7)
+
+namespace {
+    template<unsigned N>
+    __attribute__((noinline)) void codeLeaf(volatile unsigned& sink)
+    {
+        BENCHMARK_CODE_STEPS(0)
+        BENCHMARK_CODE_STEPS(8)
+        BENCHMARK_CODE_STEPS(16)
+        BENCHMARK_CODE_STEPS(24)
+    }
+
+    template<unsigned Depth, unsigned N>
+    struct CodeTree {
+        static void run(volatile unsigned& sink)
+        {
+            CodeTree<Depth - 1, 2 * N>::run(sink);
+            CodeTree<Depth - 1, 2 * N + 1>::run(sink);
+        }
+    };
+
+    template<unsigned N>
+    struct CodeTree<0, N> {
+        static void run(volatile unsigned& sink)
+        {
+            codeLeaf<N>(sink);
+        }
+    };
+
+    void flushCode()
+    {
+        volatile unsigned sink = 0;
+        CodeTree<8, 0>::run(sink);
+    }
+}
+
+#undef BENCHMARK_CODE_STEPS
+#undef BENCHMARK_CODE_STEP
+#endif
+
 int main(int argc, char** argv)
 {
+#if defined(BENCHMARK_ALLOCATION_HOOKS) && defined(__GLIBC__)
+    ::benchmark::AllocationTracker::setAvailable();
+#endif
+#if defined(__GNUC__)
+    ::benchmark::CacheFlusher::setCodeFlush(&flushCode);
+#endif
+
     ::benchmark::MainRunner runner;
     int result = runner.ParseArgs(argc, argv);
     if(result) {
         return result;
     }
     return runner.run();
-}
\ No newline at end of file
+}
@@ -1,19 +1,47 @@
 #ifndef BENCHMARK_BENCHMARKER_H_
 #define BENCHMARK_BENCHMARKER_H_
 #include <algorithm>
+#include <map>
 #include <vector>
 #include <limits>
 #include <iomanip>
+#include <sstream>
 #include <string>
 #include <cstring>
+#include <cmath>
 #include <assert.h>
+#include <regex.h>
 #include <benchmark/test_factory.h>
 #include <benchmark/test_descriptor.h>
 #include <benchmark/test_result.h>
+#include <benchmark/async_outputter.h>
 #include <benchmark/console_outputter.h>
+#include <benchmark/environment.h>
+#include <benchmark/binary_encoding.h>
+#include <benchmark/isolation.h>
+#include <benchmark/parallel_scheduler.h>
+#include <benchmark/load_generator.h>
+#include <benchmark/placement.h>
+#include <benchmark/realtime.h>
+#include <benchmark/steady_state.h>
+#include <benchmark/test_options.h>
+#include <benchmark/trace_recorder.h>
 
 namespace benchmark {
 
+enum IsolationMode {
+    /// Run all tests in the benchmark process.
+    IsolationNone,
+
+
+    /// Run each test in its own forked child.
+    IsolationPerTest,
+
+
+    /// Run each individual run of a test in its own forked child.
+    IsolationPerRun
+};
+
 class BenchMarker {
 public:
     static BenchMarker& instance()
@@ -51,6 +79,64 @@ public:
         return descriptor;
     }
 
+    /// Options of a benchmark.
+
+    /// Shared by all parameter instances of the benchmark, whether or not
+    /// it is disabled.
+    static TestOptions& testOptions(const char* fixtureName,
+                                    const char* testName)
+    {
+        if ((::strlen(testName) >= 9) &&
+            (!::memcmp(testName, "DISABLED_", 9))) {
+            testName += 9;
+        }
+        return instance()._options[std::string(fixtureName) + "." + testName];
+    }
+
+    /// Performance budget of a benchmark.
+
+    /// Empty unless set with BENCHMARK_BUDGET.
+    static Budget testBudget(const std::string& fixtureName,
+                             const std::string& testName)
+    {
+        const BenchMarker& ins = instance();
+        std::map<std::string, TestOptions>::const_iterator options =
+            ins._options.find(fixtureName + "." + testName);
+        return (options == ins._options.end() ?
+                Budget() :
+                options->second.budget());
+    }
+
+
+    /// Check a result against the budget of its test.
+
+    /// The checks are attached to the result and violated limits are
+    /// counted.
+    static void checkBudget(const std::string& fixtureName,
+                            const std::string& testName,
+                            TestResult& result)
+    {
+        const Budget budget = testBudget(fixtureName, testName);
+        if (budget.empty()) {
+            return;
+        }
+
+        const BudgetChecks checks = budget.evaluate(result);
+        for (std::size_t i = 0; i < checks.size(); ++i) {
+            if (!checks[i].Passed) {
+                ++instance()._budgetViolations;
+            }
+        }
+        result.setBudgetChecks(checks);
+    }
+
+
+    /// Number of budget limits violated so far.
+    static std::size_t budgetViolations()
+    {
+        return instance()._budgetViolations;
+    }
+
     static void addOutputter(Outputter & out)
     {
         instance()._outputters.push_back(&out);  
@@ -75,24 +161,59 @@ public:
                 positive = "*";
         }
 
-        // Iterate across all tests and test them against the patterns.
-        std::size_t index = 0;
-        while (index < ins._tests.size()) {
+        // Keep the tests matching the patterns in a single pass.
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < ins._tests.size(); ++index) {
             TestDescriptor* desc = ins._tests[index];
 
-            if ((!filterMatchesString(positive.c_str(),
-                                        desc->CanonicalName)) ||
-                (filterMatchesString(negative.c_str(),
-                                        desc->CanonicalName))) {
-                ins._tests.erase(
-                    ins._tests.begin() +
-                    std::vector<TestDescriptor*>::difference_type(index)
-                );
+            if ((filterMatchesString(positive.c_str(),
+                                     desc->CanonicalName)) &&
+                (!filterMatchesString(negative.c_str(),
+                                      desc->CanonicalName))) {
+                ins._tests[kept++] = desc;
+            } else {
                 delete desc;
+            }
+        }
+        ins._tests.resize(kept);
+    }
+
+
+    /// Keep only the tests whose name matches a regular expression.
+
+    /// @param expression POSIX extended regular expression, matched
+    /// anywhere in the name unless anchored.
+    /// @returns false if the expression is invalid, in which case error
+    /// describes why.
+    static bool applyRegexFilter(const char* expression, std::string& error)
+    {
+        BenchMarker& ins = instance();
+
+        regex_t regex;
+        const int status = ::regcomp(&regex,
+                                     expression,
+                                     REG_EXTENDED | REG_NOSUB);
+        if (status) {
+            char message[256];
+            ::regerror(status, &regex, message, sizeof(message));
+            error = message;
+            return false;
+        }
+
+        std::size_t kept = 0;
+        for (std::size_t index = 0; index < ins._tests.size(); ++index) {
+            TestDescriptor* desc = ins._tests[index];
+
+            if (!::regexec(&regex, desc->CanonicalName.c_str(), 0, NULL, 0)) {
+                ins._tests[kept++] = desc;
             } else {
-                ++index;
+                delete desc;
             }
         }
+        ins._tests.resize(kept);
+
+        ::regfree(&regex);
+        return true;
     }
 
     static void runAllTests()
@@ -101,11 +222,22 @@ public:
         std::vector<Outputter*>   defaultOutputters;
         BenchMarker              &ins = instance();
         defaultOutputters.push_back(&defaultOutputter);
-        std::vector<Outputter*>& outputters =
+        std::vector<Outputter*>& targets =
                 (ins._outputters.empty() ?
                  defaultOutputters :
                  ins._outputters);
 
+        // Dispatch the output on a background thread if enabled. Allocation
+        // tracking counts every thread, so it keeps the output synchronous.
+        // Started before the runner is placed, so the thread is not pinned
+        // to the CPU of the runner.
+        const bool async = ((ins._asyncOutput) &&
+                            (!AllocationTracker::enabled()));
+        AsyncOutputter asyncOutputter(targets, async);
+        std::vector<Outputter*> asyncOutputters(1, &asyncOutputter);
+        std::vector<Outputter*>& outputters =
+                (async ? asyncOutputters : targets);
+
         // Get the tests for execution.
         std::vector<TestDescriptor*> tests = ins.getTests();
 
@@ -124,16 +256,30 @@ public:
 
         const std::size_t enabledCount = totalCount - disabledCount;
 
-        // Calibrate the tests.
+        // Place the runner. Concurrent tests are pinned by the scheduler
+        // instead.
+        ResultMetadata runnerMetadata;
+        PlacementGuard runnerPlacement(ins.basePlacement(), runnerMetadata);
+
+        // Calibrate the tests. The calibration runs are traced as a whole.
+        TraceRecorder::nameThread("runner");
+        const bool tracing = TraceRecorder::enabled();
+        const uint64_t calibrationStart = TraceRecorder::now();
+        TraceRecorder::setEnabled(false);
         const CalibrationModel calibrationModel = getCalibrationModel();
+        TraceRecorder::setEnabled(tracing);
+        TraceRecorder::span("calibration", "runner", calibrationStart);
 
         // Begin output.
         for (std::size_t outputterIndex = 0;
                 outputterIndex < outputters.size();
-                outputterIndex++)
+                outputterIndex++) {
+                outputters[outputterIndex]->environment(ins._environment);
                 outputters[outputterIndex]->begin(enabledCount, disabledCount);
+        }
 
-        // Run through all the tests in ascending order.
+        // Select the tests matching the include filters.
+        std::vector<TestDescriptor*> selected;
         std::size_t index = 0;
 
         while (index < tests.size()) {
@@ -159,83 +305,138 @@ public:
                 }
             }
 
-            // Check if test is not disabled.
-            if (descriptor->IsDisabled) {
-                for (std::size_t outputterIndex = 0;
-                        outputterIndex < outputters.size();
-                        outputterIndex++) {
-                    outputters[outputterIndex]->skipDisabledTest(
-                        descriptor->FixtureName,
-                        descriptor->TestName,
-                        descriptor->Parameters,
-                        descriptor->Runs,
-                        descriptor->Iterations
-                    );
+            selected.push_back(descriptor);
+        }
+
+        // Run through all the tests in ascending order. Offered load is
+        // never generated concurrently, as the tests would compete.
+        if ((ins._jobs > 1) && (ins._loadRates.empty())) {
+            runParallel(selected, calibrationModel, outputters);
+        } else {
+            index = 0;
+            while (index < selected.size()) {
+                TestDescriptor* descriptor = selected[index++];
+
+                // Check if test is not disabled.
+                if (descriptor->IsDisabled) {
+                    reportDisabled(*descriptor, outputters);
+                    continue;
                 }
 
-                continue;
-            }
+                if (!ins._loadRates.empty()) {
+                    runLoad(*descriptor, outputters);
+                    continue;
+                }
 
-            // Describe the beginning of the run.
-            for (std::size_t outputterIndex = 0;
-                     outputterIndex < outputters.size();
-                     outputterIndex++) {
-                outputters[outputterIndex]->beginTest(
-                    descriptor->FixtureName,
-                    descriptor->TestName,
-                    descriptor->Parameters,
-                    descriptor->Runs,
-                    descriptor->Iterations
-                );
-            }
+                reportBegin(*descriptor, outputters);
 
-            // Execute each individual run.
-            std::vector<uint64_t> runTimes(descriptor->Runs);
-            uint64_t overheadCalibration =
-                    calibrationModel.getCalibration(descriptor->Iterations);
+                // Execute the runs, in child processes if isolated.
+                TestMeasurement measurement;
+                std::string failure;
 
-            std::size_t run = 0;
-            while (run < descriptor->Runs) {
-                // Construct a test instance.
-                Test* test = descriptor->Factory->createTest();
+                if (!executeRuns(*descriptor,
+                                 calibrationModel,
+                                 measurement,
+                                 failure)) {
+                    reportFailure(*descriptor, failure, outputters);
+                    continue;
+                }
 
-                // Run the test.
-                uint64_t time = test->run(descriptor->Iterations);
+                reportResult(*descriptor, measurement, outputters);
+            }
+        }
 
-                // Store the test time.
-                runTimes[run] = (time > overheadCalibration ?
-                                    time - overheadCalibration :
-                                    0);
+        // End output.
+        for (std::size_t outputterIndex = 0;
+             outputterIndex < outputters.size();
+             outputterIndex++) {
+            outputters[outputterIndex]->end(enabledCount,
+                                            disabledCount);
+        }
+    }
 
-                // Dispose of the test instance.
-                delete test;
+        /// Run one benchmark in a steady state for a fixed time.
+
+        /// Meant for external profilers: calibration is skipped, the
+        /// fixture is set up once and the test body is then looped for the
+        /// given time between the markers.
+        /// @param name Canonical name of the benchmark. Its first enabled
+        /// instance is run.
+        /// @param seconds Time to loop the test body for.
+        /// @param markers Markers around the steady-state window.
+        /// @param stream Stream to describe the run on.
+        /// @param failure Receives a description of the failure, if any.
+        /// @returns true if the benchmark was run.
+        static bool runSteadyState(const std::string& name,
+                                   double seconds,
+                                   const SteadyStateMarkers& markers,
+                                   std::ostream& stream,
+                                   std::string& failure)
+        {
+            BenchMarker& ins = instance();
 
-                ++run;
+            const TestDescriptor* descriptor = NULL;
+            for (std::size_t i = 0; (i < ins._tests.size()) && (!descriptor); ++i) {
+                if ((!ins._tests[i]->IsDisabled) &&
+                    (ins._tests[i]->CanonicalName == name)) {
+                    descriptor = ins._tests[i];
+                }
+            }
+            if (!descriptor) {
+                failure = "no enabled benchmark named " + name;
+                return false;
             }
 
-            // Calculate the test result.
-            TestResult testResult(runTimes, descriptor->Iterations);
-
-            // Describe the end of the run.
-            for (std::size_t outputterIndex = 0;
-                     outputterIndex < outputters.size();
-                     outputterIndex++)
-                    outputters[outputterIndex]->endTest(
-                        descriptor->FixtureName,
-                        descriptor->TestName,
-                        descriptor->Parameters,
-                        testResult
-                    );
+            ResultMetadata metadata;
+            PlacementGuard placementGuard(ins.testPlacement(*descriptor),
+                                          metadata);
+            RealtimeGuard realtimeGuard(
+                ins._realtime,
+                ins.testPlacement(*descriptor).Cpus.empty(),
+                ins.testPlacement(*descriptor).NumaNode,
+                metadata);
+
+            const uint64_t limit = uint64_t(seconds * 1000000000.0);
+            uint64_t iterations = 0;
+            uint64_t elapsed = 0;
+            Test* test = descriptor->Factory->createTest();
+
+            try {
+                test->setUp();
+                markers.begin(historyName(*descriptor));
+
+                // Loop in batches growing up to about a millisecond, so
+                // reading the clock does not show up in the profile.
+                const Clock::TimePoint start = Clock::now();
+                std::size_t batch = 1;
+                while (elapsed < limit) {
+                    for (std::size_t i = 0; i < batch; ++i) {
+                        test->runIteration();
+                    }
+                    iterations += batch;
 
-            }
+                    const uint64_t now = Clock::duration(start, Clock::now());
+                    if ((now - elapsed < 1000000) && (batch < (1U << 30))) {
+                        batch *= 2;
+                    }
+                    elapsed = now;
+                }
 
-            // End output.
-            for (std::size_t outputterIndex = 0;
-                 outputterIndex < outputters.size();
-                 outputterIndex++) {
-                outputters[outputterIndex]->end(enabledCount,
-                                                disabledCount);
+                markers.end(historyName(*descriptor));
+                test->tearDown();
+            } catch (std::exception& e) {
+                failure = e.what();
+                delete test;
+                return false;
             }
+            delete test;
+
+            stream << "[ PROFILED ] " << historyName(*descriptor) << ": "
+                   << iterations << " iterations in "
+                   << (double(elapsed) / 1000000000.0) << " s ("
+                   << (iterations ? double(elapsed) / double(iterations) : 0.0)
+                   << " ns/iteration)" << std::endl;
+            return true;
         }
 
         static std::vector<const TestDescriptor*> listTests()
@@ -251,6 +452,176 @@ public:
             return tests;
         }
 
+        /// Set the environment described to the outputters.
+        static void setEnvironment(const Environment& environment)
+        {
+            instance()._environment = environment;
+        }
+
+        /// Dispatch the output on a background thread.
+
+        /// Events are queued by the runner and written by the outputters
+        /// on a dispatcher thread, so formatting and I/O do not take place
+        /// between the measurements. Ignored while allocations are
+        /// tracked. Disabled by default.
+        static void setAsyncOutput(bool async)
+        {
+            instance()._asyncOutput = async;
+        }
+
+        /// Retain raw run times.
+
+        /// By default only streaming statistics are kept for each test,
+        /// so memory use does not grow with the number of runs.
+        static void setRetainSamples(bool retain)
+        {
+            instance()._retainSamples = retain;
+        }
+
+        /// Set process isolation.
+
+        /// @param mode Isolation mode.
+        /// @param timeoutSeconds Time limit for each child process, or 0
+        /// for none. A child exceeding it is killed and reported as failed.
+        static void setIsolation(IsolationMode mode, unsigned timeoutSeconds)
+        {
+            instance()._isolation = mode;
+            instance()._isolationTimeout = timeoutSeconds;
+        }
+
+        /// Run tests concurrently.
+
+        /// Each test runs in its own forked child, pinned to a CPU that
+        /// shares neither a physical core nor an L2 cache with the others
+        /// where possible.
+        /// @param jobs Number of tests to run at once.
+        /// @param cpus CPUs to choose from, or empty for all allowed CPUs.
+        /// @param historyPath File with historical test durations used to
+        /// start the longest tests first, or empty for none. Updated after
+        /// the run.
+        static void setParallelism(std::size_t jobs,
+                                   const std::vector<int>& cpus,
+                                   const std::string& historyPath)
+        {
+            instance()._jobs = jobs;
+            instance()._cpus = cpus;
+            instance()._historyPath = historyPath;
+        }
+
+        /// Set the placement of the runner and all tests.
+
+        /// Overridden per test by TestOptions. When tests run
+        /// concurrently, the CPUs of the placement are ignored in favour of
+        /// those chosen by setParallelism.
+        static void setPlacement(const Placement& placement)
+        {
+            instance()._placement = placement;
+        }
+
+        /// Generate open-loop load instead of timing back-to-back runs.
+
+        /// Each test is driven at every offered rate in turn, producing one
+        /// result per rate with the rate as an extra parameter. Run times
+        /// are then per-call latencies measured from the intended start.
+        /// @param rates Offered rates in calls per second, or empty for
+        /// closed-loop runs.
+        /// @param durationSeconds Time to offer each rate for.
+        /// @param threads Number of driver threads.
+        static void setLoad(const std::vector<double>& rates,
+                            double durationSeconds,
+                            std::size_t threads)
+        {
+            instance()._loadRates = rates;
+            instance()._loadDuration = durationSeconds;
+            instance()._loadThreads = threads;
+        }
+
+        /// Apply real-time measures while measuring every test.
+
+        /// Calibration and output run with the normal policy. When tests
+        /// run concurrently, they stay on the CPUs chosen by the
+        /// scheduler instead of moving to isolated CPUs.
+        static void setRealtime(const Realtime& realtime)
+        {
+            instance()._realtime = realtime;
+        }
+
+        /// Record a timeline of the runs for the trace outputter.
+
+        /// @param enabled Whether to record the timeline.
+        /// @param iterationInterval Record every n-th iteration of a run,
+        /// or 0 for none.
+        static void setTracing(bool enabled, std::size_t iterationInterval)
+        {
+            TraceRecorder::setEnabled(enabled);
+            TraceRecorder::setIterationInterval(iterationInterval);
+        }
+
+        /// Measure the effective CPU frequency of every run.
+
+        /// @param enabled Whether to measure the frequency.
+        /// @param normalize Whether to scale run times to the nominal
+        /// frequency, as if every run ran at it. Not done where only user
+        /// space cycles can be counted.
+        /// @param thresholdPercent Deviation from the median frequency of
+        /// a test beyond which runs are flagged.
+        static void setFrequencyMeasurement(bool enabled,
+                                            bool normalize,
+                                            double thresholdPercent)
+        {
+            FrequencyMeter::setEnabled(enabled);
+            instance()._normalizeFrequency = normalize;
+            instance()._frequencyThreshold = thresholdPercent;
+        }
+
+        /// Detect runs that were preempted or migrated.
+
+        /// @param enabled Whether to detect such runs. Detected runs are
+        /// counted in the result.
+        /// @param retries Number of detected runs per test to discard and
+        /// run again. Detected runs beyond it are kept.
+        static void setPreemptionDetection(bool enabled, std::size_t retries)
+        {
+            PreemptionDetector::setEnabled(enabled);
+            instance()._preemptionRetries = retries;
+        }
+
+        /// Flush the caches around the timed region of every test.
+
+        /// Overridden per test by TestOptions.
+        static void setCacheFlush(const CacheFlush& flush)
+        {
+            instance()._cacheFlush = flush;
+        }
+
+        /// Count software events around every run.
+
+        /// Page faults, context switches and, where permitted, system
+        /// calls are reported per iteration as counters.
+        static void setSoftwareCounters(bool enabled)
+        {
+            SoftwareCounters::setEnabled(enabled);
+        }
+
+        /// Track heap allocations in the timed region of every run.
+
+        /// Allocations, frees and bytes are reported per iteration, along
+        /// with the peak live bytes of each run. Requires the allocation
+        /// hooks of benchmark_main.
+        static void setAllocationTracking(bool enabled)
+        {
+            AllocationTracker::setEnabled(enabled);
+        }
+
+        /// Measure the memory footprint of every run.
+
+        /// Reports the RSS delta, peak RSS and, for tests reporting their
+        /// element count, bytes per element.
+        static void setMemoryFootprint(bool enabled)
+        {
+            MemoryFootprint::setEnabled(enabled);
+        }
+
          static void shuffleTests()
         {
             BenchMarker& ins = instance();
@@ -282,8 +653,124 @@ private:
             return YIntercept + (iterations * Slope) / Scale;
         }
     };
+private:
+    /// Runs of a test measured in a child process.
+    class IsolatedRuns : public IsolatedTask {
+    public:
+        IsolatedRuns(const TestDescriptor& descriptor,
+                     const CalibrationModel& calibrationModel,
+                     std::size_t runs,
+                     std::size_t retries)
+            :   _descriptor(descriptor),
+                _calibrationModel(calibrationModel),
+                _runs(runs),
+                _retries(retries)
+        {
+
+        }
+
+
+        virtual void run(std::string& payload)
+        {
+            // Events inherited from the parent are recorded there already.
+            TraceRecorder::clear();
+            TraceRecorder::nameThread("isolated runner");
+
+            BinaryWriter writer(payload);
+            writer.writeMeasurement(
+                measureRuns(_descriptor, _calibrationModel, _runs, _retries)
+            );
+            writer.writeTrace(TraceRecorder::events());
+        }
+    private:
+        const TestDescriptor     &_descriptor;
+        const CalibrationModel   &_calibrationModel;
+        std::size_t               _runs;
+        std::size_t               _retries;
+    };
+
+    /// Reports tests run by the parallel scheduler in test order.
+    class ParallelReporter : public ParallelScheduler::Listener {
+    public:
+        ParallelReporter(const std::vector<TestDescriptor*>& tests,
+                         const std::vector<std::size_t>& positions,
+                         const std::vector<Outputter*>& outputters,
+                         DurationHistory& history)
+            :   _tests(tests),
+                _positions(positions),
+                _outputters(outputters),
+                _history(history),
+                _reported(0)
+        {
+
+        }
+
+
+        virtual void taskCompleted(std::size_t index,
+                                   bool success,
+                                   const std::string& payload,
+                                   const std::string& failure,
+                                   double seconds)
+        {
+            const std::size_t position = _positions[index];
+            reportDisabledUpTo(position);
+
+            const TestDescriptor& descriptor = *_tests[position];
+            reportBegin(descriptor, _outputters);
+
+            if (!success) {
+                reportFailure(descriptor, failure, _outputters);
+            } else {
+                try {
+                    BinaryReader reader(payload.data(), payload.size());
+                    const TestMeasurement measurement =
+                        reader.readMeasurement();
+                    TraceRecorder::add(reader.readTrace());
+                    reportResult(descriptor, measurement, _outputters);
+                    _history.record(historyName(descriptor), seconds);
+                } catch (std::exception& e) {
+                    reportFailure(descriptor, e.what(), _outputters);
+                }
+            }
+            _reported = position + 1;
+        }
+
+
+        /// Report the disabled tests following the last task.
+        void finish()
+        {
+            reportDisabledUpTo(_tests.size());
+        }
+    private:
+        void reportDisabledUpTo(std::size_t position)
+        {
+            while (_reported < position) {
+                if (_tests[_reported]->IsDisabled) {
+                    reportDisabled(*_tests[_reported], _outputters);
+                }
+                ++_reported;
+            }
+        }
+    private:
+        const std::vector<TestDescriptor*>   &_tests;
+        const std::vector<std::size_t>       &_positions;
+        const std::vector<Outputter*>        &_outputters;
+        DurationHistory                      &_history;
+        std::size_t                           _reported;
+    };
 private:  
     BenchMarker()
+        :   _retainSamples(false),
+            _asyncOutput(false),
+            _isolation(IsolationNone),
+            _isolationTimeout(0),
+            _jobs(1),
+            _loadDuration(10.0),
+            _loadThreads(1),
+            _preemptionRetries(0),
+            _normalizeFrequency(false),
+            _frequencyThreshold(5.0),
+            _budgetViolations(0)
     {
 
     }
@@ -309,6 +796,538 @@ private:
     }
 
 
+    /// Describe a skipped disabled test.
+    static void reportDisabled(const TestDescriptor& descriptor,
+                               const std::vector<Outputter*>& outputters)
+    {
+        for (std::size_t outputterIndex = 0;
+                outputterIndex < outputters.size();
+                outputterIndex++) {
+            outputters[outputterIndex]->skipDisabledTest(
+                descriptor.FixtureName,
+                descriptor.TestName,
+                descriptor.Parameters,
+                descriptor.Runs,
+                descriptor.Iterations
+            );
+        }
+    }
+
+
+    /// Describe the beginning of the run.
+    static void reportBegin(const TestDescriptor& descriptor,
+                            const std::vector<Outputter*>& outputters)
+    {
+        for (std::size_t outputterIndex = 0;
+                 outputterIndex < outputters.size();
+                 outputterIndex++) {
+            outputters[outputterIndex]->beginTest(
+                descriptor.FixtureName,
+                descriptor.TestName,
+                descriptor.Parameters,
+                descriptor.Runs,
+                descriptor.Iterations
+            );
+        }
+    }
+
+
+    /// Describe a test that failed to produce a result.
+    static void reportFailure(const TestDescriptor& descriptor,
+                              const std::string& failure,
+                              const std::vector<Outputter*>& outputters)
+    {
+        for (std::size_t outputterIndex = 0;
+                 outputterIndex < outputters.size();
+                 outputterIndex++)
+                outputters[outputterIndex]->failTest(
+                    descriptor.FixtureName,
+                    descriptor.TestName,
+                    descriptor.Parameters,
+                    failure
+                );
+    }
+
+
+    /// Calculate the test result and describe the end of the run.
+    static void reportResult(const TestDescriptor& descriptor,
+                             const TestMeasurement& measurement,
+                             const std::vector<Outputter*>& outputters)
+    {
+        TestResult testResult(measurement, descriptor.Iterations);
+        checkBudget(descriptor.FixtureName, descriptor.TestName, testResult);
+
+        for (std::size_t outputterIndex = 0;
+                 outputterIndex < outputters.size();
+                 outputterIndex++)
+                outputters[outputterIndex]->endTest(
+                    descriptor.FixtureName,
+                    descriptor.TestName,
+                    descriptor.Parameters,
+                    testResult
+                );
+    }
+
+
+    /// Name identifying a test in the duration history.
+    static std::string historyName(const TestDescriptor& descriptor)
+    {
+        std::string name = descriptor.CanonicalName;
+        const std::vector<TestParameterDescriptor>& parameters =
+            descriptor.Parameters.Parameters();
+
+        for (std::size_t i = 0; i < parameters.size(); ++i) {
+            name += (i ? ", " : "(");
+            name += parameters[i].Value;
+        }
+        if (!parameters.empty()) {
+            name += ")";
+        }
+        return name;
+    }
+
+
+    /// Run the tests concurrently on isolated CPUs.
+
+    /// Each enabled test runs in a forked child pinned to its own CPU.
+    /// Results are reported in test order regardless of completion order.
+    static void runParallel(const std::vector<TestDescriptor*>& tests,
+                            const CalibrationModel& calibrationModel,
+                            const std::vector<Outputter*>& outputters)
+    {
+        BenchMarker& ins = instance();
+
+        std::vector<int> candidates = ins._cpus;
+        if (candidates.empty()) {
+            candidates = CpuTopology::allowedCpus();
+        }
+        const std::vector<int> cpus =
+            CpuTopology::selectIsolatedCpus(candidates, ins._jobs);
+
+        DurationHistory history;
+        if (!ins._historyPath.empty()) {
+            history.load(ins._historyPath);
+        }
+
+        std::vector<IsolatedTask*> tasks;
+        std::vector<double> expectedSeconds;
+        std::vector<std::size_t> positions;
+
+        for (std::size_t i = 0; i < tests.size(); ++i) {
+            if (tests[i]->IsDisabled) {
+                continue;
+            }
+            tasks.push_back(new IsolatedRuns(*tests[i],
+                                             calibrationModel,
+                                             tests[i]->Runs,
+                                             ins._preemptionRetries));
+            expectedSeconds.push_back(history.duration(historyName(*tests[i])));
+            positions.push_back(i);
+        }
+
+        ParallelReporter reporter(tests, positions, outputters, history);
+        ParallelScheduler scheduler(cpus, ins._isolationTimeout);
+        scheduler.run(tasks, expectedSeconds, reporter);
+        reporter.finish();
+
+        for (std::size_t i = 0; i < tasks.size(); ++i) {
+            delete tasks[i];
+        }
+
+        if (!ins._historyPath.empty()) {
+            history.save(ins._historyPath);
+        }
+    }
+
+
+    /// Placement of the runner.
+    Placement basePlacement() const
+    {
+        Placement placement = _placement;
+        if (_jobs > 1) {
+            placement.Cpus.clear();
+        }
+        return placement;
+    }
+
+
+    /// Placement of a test.
+    Placement testPlacement(const TestDescriptor& descriptor) const
+    {
+        std::map<std::string, TestOptions>::const_iterator options =
+            _options.find(descriptor.CanonicalName);
+        return (options == _options.end() ?
+                basePlacement() :
+                basePlacement().overriddenBy(options->second.placement()));
+    }
+
+
+    /// Cache flushing of a test.
+    CacheFlush testCacheFlush(const TestDescriptor& descriptor) const
+    {
+        std::map<std::string, TestOptions>::const_iterator options =
+            _options.find(descriptor.CanonicalName);
+        return ((options == _options.end()) ||
+                (!options->second.cacheFlush()) ?
+                _cacheFlush :
+                *options->second.cacheFlush());
+    }
+
+
+    /// Drive a test at each offered rate and report a result per rate.
+    static void runLoad(const TestDescriptor& descriptor,
+                        const std::vector<Outputter*>& outputters)
+    {
+        BenchMarker& ins = instance();
+
+        for (std::size_t r = 0; r < ins._loadRates.size(); ++r) {
+            const double rate = ins._loadRates[r];
+
+            std::stringstream value;
+            value << rate << "/s";
+            std::vector<TestParameterDescriptor> parameters =
+                descriptor.Parameters.Parameters();
+            parameters.push_back(TestParameterDescriptor("rate", value.str()));
+            const TestParametersDescriptor rateParameters(parameters);
+
+            const std::size_t calls =
+                std::size_t(rate * ins._loadDuration + 0.5);
+            for (std::size_t i = 0; i < outputters.size(); ++i) {
+                outputters[i]->beginTest(descriptor.FixtureName,
+                                         descriptor.TestName,
+                                         rateParameters,
+                                         calls,
+                                         1);
+            }
+
+            TestMeasurement measurement;
+            std::string failure;
+            bool success;
+            const uint64_t traceStart = TraceRecorder::now();
+            {
+                PlacementGuard placementGuard(ins.testPlacement(descriptor),
+                                              measurement.Metadata);
+                LoadGenerator generator(*descriptor.Factory,
+                                        rate,
+                                        ins._loadDuration,
+                                        ins._loadThreads);
+                success = generator.run(ins._retainSamples,
+                                        measurement,
+                                        failure);
+            }
+            TraceRecorder::span(historyName(descriptor),
+                                "test",
+                                traceStart,
+                                TraceArguments(1, std::make_pair("rate",
+                                                                 rate)));
+
+            if (!success) {
+                for (std::size_t i = 0; i < outputters.size(); ++i) {
+                    outputters[i]->failTest(descriptor.FixtureName,
+                                            descriptor.TestName,
+                                            rateParameters,
+                                            failure);
+                }
+                continue;
+            }
+
+            TestResult result(measurement, 1);
+            checkBudget(descriptor.FixtureName, descriptor.TestName, result);
+            for (std::size_t i = 0; i < outputters.size(); ++i) {
+                outputters[i]->endTest(descriptor.FixtureName,
+                                       descriptor.TestName,
+                                       rateParameters,
+                                       result);
+            }
+        }
+    }
+
+
+    /// Measure runs of a test in the current process.
+
+    /// The test is placed according to its options for the duration of
+    /// the runs, so that fixture memory is allocated on its NUMA node.
+    /// @param retries Preempted or migrated runs to run again at most.
+    static TestMeasurement measureRuns(const TestDescriptor& descriptor,
+                                       const CalibrationModel& calibrationModel,
+                                       std::size_t runs,
+                                       std::size_t retries)
+    {
+        BenchMarker& ins = instance();
+        const uint64_t traceStart = TraceRecorder::now();
+        TestMeasurement measurement;
+        SampleStatistics& runTimes = measurement.RunTimes;
+        runTimes.retainSamples(ins._retainSamples);
+
+        PlacementGuard placementGuard(ins.testPlacement(descriptor),
+                                      measurement.Metadata);
+        RealtimeGuard realtimeGuard(
+            ins._realtime,
+            (ins._jobs <= 1) && (ins.testPlacement(descriptor).Cpus.empty()),
+            ins.testPlacement(descriptor).NumaNode,
+            measurement.Metadata);
+        SamplingProfiler::discard();
+
+        const CacheFlush cacheFlush = ins.testCacheFlush(descriptor);
+        if (cacheFlush.Mode != CacheFlushNone) {
+            CacheFlusher::prepare();
+        }
+        // Tests may flush less often than requested, e.g. asynchronous
+        // ones, so the flush applied by the first test is recorded.
+        CacheFlush appliedFlush;
+
+
+        const double nominalFrequency = FrequencyMeter::nominalFrequency();
+        SampleStatistics frequencies;
+        frequencies.retainSamples(true);
+        std::string frequencyError;
+        bool frequencyUserOnly = false;
+
+        std::size_t run = 0;
+        while (run < runs) {
+            // Construct a test instance.
+            Test* test = descriptor.Factory->createTest();
+            test->setCacheFlush(cacheFlush);
+            appliedFlush = test->cacheFlush();
+
+            // Iterations timed one by one each carry the overhead of
+            // reading the clock.
+            const uint64_t overheadCalibration =
+                (appliedFlush.Mode == CacheFlushIterations ?
+                 descriptor.Iterations * calibrationModel.getCalibration(1) :
+                 calibrationModel.getCalibration(descriptor.Iterations));
+
+            // Run the test.
+            const std::size_t profileMark = SamplingProfiler::mark();
+            uint64_t time = test->run(descriptor.Iterations);
+
+            // Run a preempted or migrated run again, up to the limit. Its
+            // profile samples are discarded with it.
+            if (test->disturbed()) {
+                if (measurement.RejectedRuns < retries) {
+                    ++measurement.RejectedRuns;
+                    SamplingProfiler::discardSince(profileMark);
+                    delete test;
+                    continue;
+                }
+                ++measurement.DisturbedRuns;
+            }
+
+            // Scale the time to the nominal frequency if requested.
+            double netTime = double(time > overheadCalibration ?
+                                    time - overheadCalibration :
+                                    0);
+            // User space cycles underestimate the frequency of runs
+            // spending time in the kernel, so they are not normalized.
+            const double frequency = test->effectiveFrequency();
+            if (frequency > 0.0) {
+                frequencies.add(frequency);
+                frequencyUserOnly = test->frequencyUserOnly();
+                if ((ins._normalizeFrequency) &&
+                    (nominalFrequency > 0.0) &&
+                    (!frequencyUserOnly)) {
+                    netTime *= frequency / nominalFrequency;
+                }
+            } else if (frequencyError.empty()) {
+                frequencyError = test->frequencyError();
+            }
+
+            // Store the test time and the counters of the test.
+            runTimes.add(netTime);
+            test->collectCounters(measurement.Counters);
+
+            // Dispose of the test instance.
+            delete test;
+
+            ++run;
+        }
+
+        if (appliedFlush.Mode != CacheFlushNone) {
+            measurement.Metadata.push_back(ResultMetadataEntry(
+                "cold_cache",
+                std::string(appliedFlush.Mode == CacheFlushRuns ?
+                            "runs" :
+                            "iterations") +
+                (appliedFlush.Instructions ? "+code" : "")));
+        }
+
+        if (frequencies.count()) {
+            flagFrequencyDeviation(frequencies.samples(), measurement);
+            if (frequencyUserOnly) {
+                measurement.Metadata.push_back(
+                    ResultMetadataEntry("cpu_frequency_user_only", "yes"));
+            } else if ((ins._normalizeFrequency) && (nominalFrequency > 0.0)) {
+                std::stringstream value;
+                value << (nominalFrequency / 1000000.0);
+                measurement.Metadata.push_back(
+                    ResultMetadataEntry("normalized_to_mhz", value.str()));
+            }
+        } else if (!frequencyError.empty()) {
+            measurement.Metadata.push_back(
+                ResultMetadataEntry("cpu_frequency_error", frequencyError));
+        }
+
+        if (SamplingProfiler::enabled()) {
+            std::string error;
+            if (SamplingProfiler::write(descriptor.CanonicalName, error)) {
+                measurement.Metadata.push_back(ResultMetadataEntry(
+                    "profile",
+                    SamplingProfiler::outputPath(descriptor.CanonicalName)));
+            } else {
+                measurement.Metadata.push_back(
+                    ResultMetadataEntry("profile_error", error));
+            }
+        }
+
+        if (TraceRecorder::enabled()) {
+            TraceArguments arguments;
+            arguments.push_back(std::make_pair("runs", double(runs)));
+            arguments.push_back(std::make_pair("iterations",
+                                               double(descriptor.Iterations)));
+            TraceRecorder::span(historyName(descriptor),
+                                "test",
+                                traceStart,
+                                arguments);
+        }
+        return measurement;
+    }
+
+
+    /// Flag runs whose frequency deviates from the median of the test.
+
+    /// A single run cannot deviate, so runs measured one per child are
+    /// compared by the parent once their frequencies are merged.
+    static void flagFrequencyDeviation(const std::vector<double>& frequencies,
+                                       TestMeasurement& measurement)
+    {
+        if (frequencies.size() < 2) {
+            return;
+        }
+
+        BenchMarker& ins = instance();
+        std::vector<double> sorted(frequencies);
+        std::sort(sorted.begin(), sorted.end());
+        const std::size_t middle = sorted.size() / 2;
+        const double median = (sorted.size() % 2 ?
+                               sorted[middle] :
+                               (sorted[middle - 1] + sorted[middle]) / 2.0);
+
+        std::size_t deviating = 0;
+        for (std::size_t i = 0; i < frequencies.size(); ++i) {
+            const double deviation =
+                std::fabs(frequencies[i] - median) / median * 100.0;
+            measurement.Counters["cpu_frequency_deviation_pct"].add(
+                deviation);
+            if (deviation > ins._frequencyThreshold) {
+                ++deviating;
+            }
+        }
+
+        if (deviating) {
+            std::stringstream value;
+            value << deviating << " beyond " << ins._frequencyThreshold
+                  << "% of the median";
+            measurement.Metadata.push_back(
+                ResultMetadataEntry("frequency_deviating_runs",
+                                    value.str()));
+        }
+    }
+
+
+    /// Measure runs of a test in a child process.
+    static bool measureIsolated(const TestDescriptor& descriptor,
+                                const CalibrationModel& calibrationModel,
+                                std::size_t runs,
+                                std::size_t retries,
+                                TestMeasurement& measurement,
+                                std::string& failure)
+    {
+        IsolatedRuns task(descriptor, calibrationModel, runs, retries);
+        std::string payload;
+
+        if (!ChildProcess::run(task,
+                               instance()._isolationTimeout,
+                               payload,
+                               failure)) {
+            return false;
+        }
+
+        try {
+            BinaryReader reader(payload.data(), payload.size());
+            measurement = reader.readMeasurement();
+            TraceRecorder::add(reader.readTrace());
+        } catch (std::exception& e) {
+            failure = e.what();
+            return false;
+        }
+        return true;
+    }
+
+
+    /// Execute all runs of a test according to the isolation mode.
+
+    /// @returns false if an isolated child failed, in which case failure
+    /// describes why.
+    static bool executeRuns(const TestDescriptor& descriptor,
+                            const CalibrationModel& calibrationModel,
+                            TestMeasurement& measurement,
+                            std::string& failure)
+    {
+        BenchMarker& ins = instance();
+        std::vector<double> frequencies;
+
+        switch (ins._isolation) {
+        case IsolationPerTest:
+            return measureIsolated(descriptor,
+                                   calibrationModel,
+                                   descriptor.Runs,
+                                   ins._preemptionRetries,
+                                   measurement,
+                                   failure);
+
+        case IsolationPerRun:
+            // The retries are shared by the runs of the test, as when the
+            // runs are measured in one process.
+            measurement.RunTimes.retainSamples(ins._retainSamples);
+            for (std::size_t run = 0; run < descriptor.Runs; ++run) {
+                TestMeasurement single;
+                if (!measureIsolated(descriptor,
+                                     calibrationModel,
+                                     1,
+                                     (ins._preemptionRetries -
+                                      measurement.RejectedRuns),
+                                     single,
+                                     failure)) {
+                    return false;
+                }
+                measurement.RunTimes.merge(single.RunTimes);
+                mergeCounters(measurement.Counters, single.Counters);
+                measurement.DisturbedRuns += single.DisturbedRuns;
+                measurement.RejectedRuns += single.RejectedRuns;
+                if (!run) {
+                    measurement.Metadata = single.Metadata;
+                }
+
+                // The frequency of the single run of the child.
+                ResultCounters::const_iterator frequency =
+                    single.Counters.find("cpu_frequency_mhz");
+                if (frequency != single.Counters.end()) {
+                    frequencies.push_back(frequency->second.mean());
+                }
+            }
+            flagFrequencyDeviation(frequencies, measurement);
+            return true;
+
+        default:
+            measurement = measureRuns(descriptor,
+                                      calibrationModel,
+                                      descriptor.Runs,
+                                      ins._preemptionRetries);
+            return true;
+        }
+    }
+
+
         /// Test if a filter matches a string.
 
         /// Adapted from gtest. All rights reserved by original authors.
@@ -336,24 +1355,41 @@ private:
 
     /// Test if pattern matches a string.
 
-    /// Adapted from gtest. All rights reserved by original authors.
+    /// '?' matches any character and '*' any substring. The pattern ends
+    /// at '\0' or ':'. On a mismatch only the last '*' is retried one
+    /// character further, since an earlier '*' can never match more than
+    /// the last one can absorb. This takes at most pattern length times
+    /// string length steps, where backtracking every '*' is exponential
+    /// in the number of stars.
     static bool patternMatchesString(const char* pattern, const char *str)
     {
-        switch (*pattern) {
-        case '\0':
-        case ':':
-            return (*str == '\0');
-        case '?':  // Matches any single character.
-            return ((*str != '\0') &&
-                    (patternMatchesString(pattern + 1, str + 1)));
-        case '*':  // Matches any string (possibly empty) of characters.
-            return (((*str != '\0') &&
-                        (patternMatchesString(pattern, str + 1))) ||
-                    (patternMatchesString(pattern + 1, str)));
-        default:
-            return ((*pattern == *str) &&
-                    (patternMatchesString(pattern + 1, str + 1)));
+        const char* star = NULL;
+        const char* starStr = NULL;
+
+        while (*str) {
+            if (*pattern == '*') {
+                // Let the star match nothing at first.
+                star = pattern++;
+                starStr = str;
+            } else if ((*pattern) &&
+                       (*pattern != ':') &&
+                       ((*pattern == '?') || (*pattern == *str))) {
+                ++pattern;
+                ++str;
+            } else if (star) {
+                // Let the last star match one more character.
+                pattern = star + 1;
+                str = ++starStr;
+            } else {
+                return false;
+            }
+        }
+
+        // Trailing stars match the empty rest.
+        while (*pattern == '*') {
+            ++pattern;
         }
+        return ((*pattern == '\0') || (*pattern == ':'));
     }
 
  /// Get calibration model.
@@ -466,6 +1502,25 @@ private:
     std::vector<Outputter*>       _outputters; ///< Registered outputters.
     std::vector<TestDescriptor*>  _tests; ///< Registered tests.
     std::vector<std::string>      _include; ///< Test filters.
+    Environment                   _environment; ///< Machine and build.
+    bool                          _retainSamples; ///< Keep raw run times.
+    bool                          _asyncOutput; ///< Output off the runner.
+    IsolationMode                 _isolation; ///< Process isolation.
+    unsigned                      _isolationTimeout; ///< Child time limit.
+    std::size_t                   _jobs; ///< Tests run concurrently.
+    std::vector<int>              _cpus; ///< CPUs for concurrent tests.
+    std::string                   _historyPath; ///< Test duration history.
+    Placement                     _placement; ///< Runner placement.
+    CacheFlush                    _cacheFlush; ///< Cache flushing.
+    Realtime                      _realtime; ///< Real-time measures.
+    std::map<std::string, TestOptions> _options; ///< Per-test options.
+    std::vector<double>           _loadRates; ///< Offered rates, if any.
+    double                        _loadDuration; ///< Seconds per rate.
+    std::size_t                   _loadThreads; ///< Load driver threads.
+    std::size_t                   _preemptionRetries; ///< Reruns per test.
+    bool                          _normalizeFrequency; ///< Scale run times.
+    double                        _frequencyThreshold; ///< Percent.
+    std::size_t                   _budgetViolations; ///< Limits violated.
 
 
 };
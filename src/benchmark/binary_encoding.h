@@ -0,0 +1,308 @@
+#ifndef BENCHMARK_BINARY_ENCODING_H_
+#define BENCHMARK_BINARY_ENCODING_H_
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+#include <stdint.h>
+#include <benchmark/statistics.h>
+#include <benchmark/test_result.h>
+#include <benchmark/trace_recorder.h>
+
+namespace benchmark {
+
+/// Compact binary writer.
+
+/// Appends fixed-width values in native byte order to a buffer. The
+/// encoding is only meant to travel between processes of the same
+/// executable on the same machine.
+class BinaryWriter {
+public:
+    /// @param buffer Buffer to append to. Expected to be available during
+    /// the life time of the writer.
+    BinaryWriter(std::string& buffer)
+        :   _buffer(buffer)
+    {
+
+    }
+
+
+    /// Write a plain value.
+    template<typename T>
+    inline void write(const T& value)
+    {
+        _buffer.append(reinterpret_cast<const char*>(&value), sizeof(T));
+    }
+
+
+    /// Write a length-prefixed string.
+    inline void writeString(const std::string& value)
+    {
+        write<uint32_t>(uint32_t(value.size()));
+        _buffer.append(value);
+    }
+
+
+    /// Write sample statistics.
+    void writeStatistics(const SampleStatistics& statistics)
+    {
+        const RunningStatistics& moments = statistics.moments();
+
+        write<uint64_t>(moments.count());
+        write<double>(moments.mean());
+        write<double>(moments.m2());
+        write<double>(moments.total());
+        write<double>(moments.minimum());
+        write<double>(moments.maximum());
+
+        const std::vector<QuantileDigest::Centroid>& centroids =
+            statistics.digest().centroids();
+
+        write<uint8_t>(statistics.digest().exact() ? 1 : 0);
+        write<uint32_t>(uint32_t(centroids.size()));
+        for (std::size_t i = 0; i < centroids.size(); ++i) {
+            write<double>(centroids[i].Mean);
+            write<double>(centroids[i].Weight);
+        }
+
+        const std::vector<double>& samples = statistics.samples();
+
+        write<uint8_t>(statistics.retainsSamples() ? 1 : 0);
+        write<uint64_t>(samples.size());
+        if (!samples.empty()) {
+            _buffer.append(reinterpret_cast<const char*>(&samples[0]),
+                           samples.size() * sizeof(double));
+        }
+    }
+
+
+    /// Write result metadata.
+    void writeMetadata(const ResultMetadata& metadata)
+    {
+        write<uint32_t>(uint32_t(metadata.size()));
+        for (std::size_t i = 0; i < metadata.size(); ++i) {
+            writeString(metadata[i].first);
+            writeString(metadata[i].second);
+        }
+    }
+
+
+    /// Write result counters.
+    void writeCounters(const ResultCounters& counters)
+    {
+        write<uint32_t>(uint32_t(counters.size()));
+        for (ResultCounters::const_iterator it = counters.begin();
+             it != counters.end();
+             ++it) {
+            writeString(it->first);
+            writeStatistics(it->second);
+        }
+    }
+
+
+    /// Write a test measurement.
+    void writeMeasurement(const TestMeasurement& measurement)
+    {
+        writeStatistics(measurement.RunTimes);
+        writeMetadata(measurement.Metadata);
+        writeCounters(measurement.Counters);
+        write<uint64_t>(measurement.DisturbedRuns);
+        write<uint64_t>(measurement.RejectedRuns);
+    }
+
+
+    /// Write trace events.
+    void writeTrace(const std::vector<TraceEvent>& events)
+    {
+        write<uint64_t>(events.size());
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            const TraceEvent& event = events[i];
+            write<char>(event.Phase);
+            writeString(event.Name);
+            writeString(event.Category);
+            write<uint64_t>(event.Start);
+            write<uint64_t>(event.Duration);
+            write<int64_t>(event.Process);
+            write<int64_t>(event.Thread);
+            write<uint32_t>(uint32_t(event.Arguments.size()));
+            for (std::size_t a = 0; a < event.Arguments.size(); ++a) {
+                writeString(event.Arguments[a].first);
+                write<double>(event.Arguments[a].second);
+            }
+        }
+    }
+private:
+    std::string& _buffer;
+};
+
+
+/// Compact binary reader.
+
+/// Reads values written by BinaryWriter. Throws std::runtime_error when
+/// the data is truncated.
+class BinaryReader {
+public:
+    BinaryReader(const char* data, std::size_t size)
+        :   _position(data),
+            _end(data + size)
+    {
+
+    }
+
+
+    /// Whether all data has been consumed.
+    inline bool atEnd() const
+    {
+        return _position >= _end;
+    }
+
+
+    /// Read a plain value.
+    template<typename T>
+    inline T read()
+    {
+        T value;
+        require(sizeof(T));
+        ::memcpy(&value, _position, sizeof(T));
+        _position += sizeof(T);
+        return value;
+    }
+
+
+    /// Read a length-prefixed string.
+    inline std::string readString()
+    {
+        const uint32_t size = read<uint32_t>();
+        require(size);
+        std::string value(_position, size);
+        _position += size;
+        return value;
+    }
+
+
+    /// Read sample statistics.
+    SampleStatistics readStatistics()
+    {
+        const uint64_t count = read<uint64_t>();
+        const double mean = read<double>();
+        const double m2 = read<double>();
+        const double total = read<double>();
+        const double minimum = read<double>();
+        const double maximum = read<double>();
+
+        RunningStatistics moments =
+            RunningStatistics::fromState(std::size_t(count),
+                                         mean,
+                                         m2,
+                                         total,
+                                         minimum,
+                                         maximum);
+
+        QuantileDigest digest;
+        const bool exact = (read<uint8_t>() != 0);
+        const uint32_t centroidCount = read<uint32_t>();
+        for (uint32_t i = 0; i < centroidCount; ++i) {
+            const double centroidMean = read<double>();
+            const double centroidWeight = read<double>();
+            if (exact) {
+                digest.add(centroidMean);
+            } else {
+                digest.add(centroidMean, centroidWeight);
+            }
+        }
+
+        const bool retainSamples = (read<uint8_t>() != 0);
+        const std::size_t sampleCount = std::size_t(read<uint64_t>());
+        require(sampleCount * sizeof(double));
+
+        std::vector<double> samples(sampleCount);
+        if (sampleCount) {
+            ::memcpy(&samples[0], _position, samples.size() * sizeof(double));
+            _position += samples.size() * sizeof(double);
+        }
+
+        return SampleStatistics::fromParts(moments,
+                                           digest,
+                                           samples,
+                                           retainSamples);
+    }
+
+
+    /// Read result metadata.
+    ResultMetadata readMetadata()
+    {
+        ResultMetadata metadata;
+        const uint32_t count = read<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            const std::string key = readString();
+            const std::string value = readString();
+            metadata.push_back(ResultMetadataEntry(key, value));
+        }
+        return metadata;
+    }
+
+
+    /// Read result counters.
+    ResultCounters readCounters()
+    {
+        ResultCounters counters;
+        const uint32_t count = read<uint32_t>();
+        for (uint32_t i = 0; i < count; ++i) {
+            const std::string name = readString();
+            counters[name] = readStatistics();
+        }
+        return counters;
+    }
+
+
+    /// Read a test measurement.
+    TestMeasurement readMeasurement()
+    {
+        TestMeasurement measurement;
+        measurement.RunTimes = readStatistics();
+        measurement.Metadata = readMetadata();
+        measurement.Counters = readCounters();
+        measurement.DisturbedRuns = std::size_t(read<uint64_t>());
+        measurement.RejectedRuns = std::size_t(read<uint64_t>());
+        return measurement;
+    }
+
+
+    /// Read trace events.
+    std::vector<TraceEvent> readTrace()
+    {
+        std::vector<TraceEvent> events;
+        const uint64_t count = read<uint64_t>();
+        for (uint64_t i = 0; i < count; ++i) {
+            TraceEvent event;
+            event.Phase = read<char>();
+            event.Name = readString();
+            event.Category = readString();
+            event.Start = read<uint64_t>();
+            event.Duration = read<uint64_t>();
+            event.Process = read<int64_t>();
+            event.Thread = read<int64_t>();
+            const uint32_t arguments = read<uint32_t>();
+            for (uint32_t a = 0; a < arguments; ++a) {
+                const std::string name = readString();
+                event.Arguments.push_back(std::make_pair(name,
+                                                         read<double>()));
+            }
+            events.push_back(event);
+        }
+        return events;
+    }
+private:
+    inline void require(std::size_t size) const
+    {
+        if (std::size_t(_end - _position) < size) {
+            throw std::runtime_error("truncated binary data");
+        }
+    }
+private:
+    const char  *_position;
+    const char  *_end;
+};
+
+}
+#endif
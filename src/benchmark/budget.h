@@ -0,0 +1,204 @@
+#ifndef BENCHMARK_BUDGET_H_
+#define BENCHMARK_BUDGET_H_
+#include <algorithm>
+#include <cmath>
+#include <limits>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <utility>
+#include <vector>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Performance budget of a benchmark.
+
+/// Limits on the time per iteration at percentiles, on the throughput and
+/// on the allocations per iteration, set with BENCHMARK_BUDGET.
+///
+/// Measurements are noisy, so a limit is only violated when it is
+/// exceeded with 95% confidence: percentiles are checked against the
+/// lower confidence bound of the percentile, throughput against the upper
+/// bound of the mean and allocations against the lower bound of the mean.
+/// A benchmark just at its limit therefore passes rather than flaps.
+class Budget {
+public:
+    Budget()
+        :   _minItemsPerSecond(0.0),
+            _itemsPerIteration(1.0),
+            _maxAllocationsPerIteration(-1.0)
+    {
+
+    }
+
+
+    /// Limit the time per iteration at a percentile.
+
+    /// @param percentile Percentile between 0 and 100, e.g. 99.
+    /// @param nanoseconds Budget in nanoseconds per iteration.
+    Budget& latency(double percentile, double nanoseconds)
+    {
+        if ((percentile < 0.0) || (percentile > 100.0)) {
+            throw std::invalid_argument("percentile out of range");
+        }
+
+        for (std::size_t i = 0; i < _latencies.size(); ++i) {
+            if (_latencies[i].first == percentile) {
+                _latencies[i].second = nanoseconds;
+                return *this;
+            }
+        }
+        _latencies.push_back(std::make_pair(percentile, nanoseconds));
+        return *this;
+    }
+
+
+    /// Require a minimum throughput.
+
+    /// @param itemsPerSecond Minimum items processed per second.
+    /// @param itemsPerIteration Items processed by one iteration.
+    Budget& throughput(double itemsPerSecond, double itemsPerIteration = 1.0)
+    {
+        if (itemsPerIteration <= 0.0) {
+            throw std::invalid_argument("items per iteration must be "
+                                        "positive");
+        }
+        _minItemsPerSecond = itemsPerSecond;
+        _itemsPerIteration = itemsPerIteration;
+        return *this;
+    }
+
+
+    /// Limit the heap allocations per iteration.
+
+    /// Checked only with --track-allocations.
+    Budget& allocations(double perIteration)
+    {
+        _maxAllocationsPerIteration = perIteration;
+        return *this;
+    }
+
+
+    /// Whether no limit is set.
+    inline bool empty() const
+    {
+        return ((_latencies.empty()) &&
+                (_minItemsPerSecond <= 0.0) &&
+                (_maxAllocationsPerIteration < 0.0));
+    }
+
+
+    /// Check a result against every limit of the budget.
+    BudgetChecks evaluate(const TestResult& result) const
+    {
+        BudgetChecks checks;
+        const double runs = double(result.runs());
+
+        for (std::size_t i = 0; i < _latencies.size(); ++i) {
+            const double p = _latencies[i].first / 100.0;
+            const double margin = (runs > 0.0 ?
+                                   z() * std::sqrt(p * (1.0 - p) / runs) :
+                                   0.0);
+
+            std::stringstream name;
+            name << "p" << _latencies[i].first;
+
+            BudgetCheck check;
+            check.Name = name.str();
+            check.Limit = _latencies[i].second;
+            check.Estimate = result.iterationTimeQuantile(p);
+            check.Bound = result.iterationTimeQuantile(
+                std::max(0.0, p - margin));
+            check.Checked = true;
+            check.Passed = (check.Bound <= check.Limit);
+            describe(check, "ns/iteration", "<=", "ns");
+            checks.push_back(check);
+        }
+
+        if (_minItemsPerSecond > 0.0) {
+            const double mean = result.iterationTimeAverage();
+            const double margin = (runs > 1.0 ?
+                                   z() * result.iterationTimeStdDev() /
+                                   std::sqrt(runs) :
+                                   0.0);
+
+            BudgetCheck check;
+            check.Name = "items/s";
+            check.Limit = _minItemsPerSecond;
+            check.Estimate = itemsPerSecond(mean);
+            check.Bound = itemsPerSecond(mean - margin);
+            check.Checked = true;
+            check.Passed = (check.Bound >= check.Limit);
+            describe(check, "items/s", ">=", "items/s");
+            checks.push_back(check);
+        }
+
+        if (_maxAllocationsPerIteration >= 0.0) {
+            BudgetCheck check;
+            check.Name = "allocations";
+            check.Limit = _maxAllocationsPerIteration;
+
+            ResultCounters::const_iterator counter =
+                result.counters().find("allocations_per_iteration");
+            if (counter == result.counters().end()) {
+                check.Description = "allocations not measured, run with "
+                                    "--track-allocations";
+            } else {
+                const SampleStatistics& allocations = counter->second;
+                const double count = double(allocations.count());
+                const double margin = (count > 1.0 ?
+                                       z() * allocations.moments().stdDev() /
+                                       std::sqrt(count) :
+                                       0.0);
+                check.Estimate = allocations.mean();
+                check.Bound = check.Estimate - margin;
+                check.Checked = true;
+                check.Passed = (check.Bound <= check.Limit);
+                describe(check, "allocations/iteration", "<=", "");
+            }
+            checks.push_back(check);
+        }
+        return checks;
+    }
+private:
+    /// One-sided 95% quantile of the standard normal distribution.
+    static inline double z()
+    {
+        return 1.645;
+    }
+
+
+    inline double itemsPerSecond(double iterationNs) const
+    {
+        return (iterationNs > 0.0 ?
+                _itemsPerIteration * 1000000000.0 / iterationNs :
+                std::numeric_limits<double>::infinity());
+    }
+
+
+    /// Describe a checked limit, e.g.
+    /// "p99 812.3 ns/iteration, budget <= 900.0 ns, 95% bound 790.1".
+    static void describe(BudgetCheck& check,
+                         const char* unit,
+                         const char* relation,
+                         const char* limitUnit)
+    {
+        std::stringstream message;
+        message.setf(std::ios::fixed);
+        message.precision(1);
+        message << check.Name << " " << check.Estimate << " " << unit
+                << ", budget " << relation << " " << check.Limit
+                << (*limitUnit ? " " : "") << limitUnit
+                << ", 95% bound " << check.Bound;
+        check.Description = message.str();
+    }
+private:
+    std::vector<std::pair<double, double> >  _latencies;
+    double                                   _minItemsPerSecond;
+    double                                   _itemsPerIteration;
+    double                                   _maxAllocationsPerIteration;
+};
+
+}
+#endif
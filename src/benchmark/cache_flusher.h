@@ -0,0 +1,195 @@
+#ifndef BENCHMARK_CACHE_FLUSHER_H_
+#define BENCHMARK_CACHE_FLUSHER_H_
+#include <cstddef>
+#include <cstdlib>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <benchmark/cpu_topology.h>
+
+namespace benchmark {
+
+/// When to flush the caches.
+enum CacheFlushMode {
+    /// Leave the caches warm.
+    CacheFlushNone,
+
+
+    /// Flush before every run, after the fixture is set up.
+    CacheFlushRuns,
+
+
+    /// Flush before every iteration.
+    CacheFlushIterations
+};
+
+
+/// Cache state in which a benchmark starts.
+class CacheFlush {
+public:
+    CacheFlush()
+        :   Mode(CacheFlushNone),
+            Instructions(false)
+    {
+
+    }
+
+
+    /// When to flush.
+    CacheFlushMode Mode;
+
+
+    /// Also execute a large code region to evict the instruction caches.
+    bool Instructions;
+};
+
+
+/// Evicts the caches between runs or iterations.
+
+/// Data caches are evicted by writing a buffer one and a half times the
+/// size of all data and unified caches of the allowed CPUs, as listed in
+/// /sys/devices/system/cpu/cpu*/cache. The instruction cache, micro-op
+/// cache and branch predictors are evicted by executing a code region
+/// registered by benchmark_main, since it is far too large to instantiate
+/// in every benchmark.
+class CacheFlusher {
+public:
+    /// Allocate the flush buffer.
+
+    /// Called before the measured runs, so the buffer is neither counted
+    /// in their memory footprint nor faulted in during them.
+    static void prepare()
+    {
+        std::vector<char>& buffer = state().Buffer;
+        if (buffer.empty()) {
+            buffer.resize(bufferBytes(), 0);
+        }
+    }
+
+
+    /// Evict the caches.
+
+    /// @param instructions Also execute the code region, if registered.
+    static void flush(bool instructions)
+    {
+        State& s = state();
+        prepare();
+
+        // Read and write every cache line, so each is loaded and owned.
+        volatile char* data = &s.Buffer[0];
+        const std::size_t size = s.Buffer.size();
+        for (std::size_t i = 0; i < size; i += LineBytes) {
+            data[i] = char(data[i] + 1);
+        }
+
+        if ((instructions) && (s.CodeFlush)) {
+            s.CodeFlush();
+        }
+    }
+
+
+    /// Register the code region executed to evict the instruction caches.
+    static void setCodeFlush(void (*codeFlush)())
+    {
+        state().CodeFlush = codeFlush;
+    }
+
+
+    /// Whether a code region is registered.
+    static bool codeFlushAvailable()
+    {
+        return (state().CodeFlush != NULL);
+    }
+
+
+    /// Size of the flush buffer in bytes.
+    static std::size_t bufferBytes()
+    {
+        // Largest cache of each level, so caches shared by several of the
+        // allowed CPUs are counted once.
+        std::vector<std::size_t> levels;
+        const std::vector<int> cpus = CpuTopology::allowedCpus();
+
+        for (std::size_t c = 0; c < cpus.size(); ++c) {
+            for (int index = 0; index < 8; ++index) {
+                std::stringstream path;
+                path << "/sys/devices/system/cpu/cpu" << cpus[c]
+                     << "/cache/index" << index;
+
+                const std::string level =
+                    CpuTopology::readLine(path.str() + "/level");
+                if (level.empty()) {
+                    break;
+                }
+                if (CpuTopology::readLine(path.str() + "/type") ==
+                    "Instruction") {
+                    continue;
+                }
+
+                const std::size_t l = std::size_t(::atoi(level.c_str()));
+                const std::size_t size =
+                    parseSize(CpuTopology::readLine(path.str() + "/size"));
+                if (levels.size() <= l) {
+                    levels.resize(l + 1, 0);
+                }
+                if (size > levels[l]) {
+                    levels[l] = size;
+                }
+            }
+        }
+
+        std::size_t total = 0;
+        for (std::size_t l = 0; l < levels.size(); ++l) {
+            total += levels[l];
+        }
+        if (!total) {
+            total = DefaultCacheBytes;
+        }
+        return total + total / 2;
+    }
+private:
+    /// Cache line size assumed when walking the buffer.
+    static const std::size_t LineBytes = 64;
+
+
+    /// Cache size assumed when the caches are not listed.
+    static const std::size_t DefaultCacheBytes = 32 * 1024 * 1024;
+
+
+    struct State {
+        State()
+            :   CodeFlush(NULL)
+        {
+
+        }
+
+        std::vector<char> Buffer;
+        void (*CodeFlush)();
+    };
+
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+
+    /// Parse a cache size such as "48K" or "32M".
+    static std::size_t parseSize(const std::string& text)
+    {
+        char* end = NULL;
+        std::size_t size = std::size_t(::strtoul(text.c_str(), &end, 10));
+        if (*end == 'K') {
+            size *= 1024;
+        } else if (*end == 'M') {
+            size *= 1024 * 1024;
+        } else if (*end == 'G') {
+            size *= 1024 * 1024 * 1024;
+        }
+        return size;
+    }
+};
+
+}
+#endif
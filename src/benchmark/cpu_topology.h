@@ -0,0 +1,257 @@
+#ifndef BENCHMARK_CPU_TOPOLOGY_H_
+#define BENCHMARK_CPU_TOPOLOGY_H_
+#include <algorithm>
+#include <cstdlib>
+#include <fstream>
+#include <set>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sched.h>
+#endif
+
+namespace benchmark {
+
+/// CPU topology queries and thread pinning.
+
+/// Topology is read from /sys/devices/system/cpu. On systems without it
+/// every CPU is treated as its own core with a private L2 cache, and
+/// pinning is a no-op.
+class CpuTopology {
+public:
+    /// Parse a CPU list.
+
+    /// @param text List in the kernel's format, e.g. "0-3,8,10-11".
+    /// @param cpus Receives the CPUs in ascending order.
+    /// @returns true if the list is valid and every CPU is below
+    /// MaxCpus.
+    static bool parseCpuList(const std::string& text, std::vector<int>& cpus)
+    {
+        std::set<int> parsed;
+        std::stringstream stream(text);
+        std::string range;
+
+        while (std::getline(stream, range, ',')) {
+            while ((!range.empty()) &&
+                   ((range[range.size() - 1] == '\n') ||
+                    (range[range.size() - 1] == ' '))) {
+                range.erase(range.size() - 1);
+            }
+            if (range.empty()) {
+                continue;
+            }
+
+            char* end = NULL;
+            const long first = ::strtol(range.c_str(), &end, 10);
+            long last = first;
+
+            if (end == range.c_str()) {
+                return false;
+            }
+            if (*end == '-') {
+                const char* lastStart = end + 1;
+                last = ::strtol(lastStart, &end, 10);
+                if (end == lastStart) {
+                    return false;
+                }
+            }
+            if ((*end) || (first < 0) || (last < first) ||
+                (last >= MaxCpus)) {
+                return false;
+            }
+
+            for (long cpu = first; cpu <= last; ++cpu) {
+                parsed.insert(int(cpu));
+            }
+        }
+
+        cpus.assign(parsed.begin(), parsed.end());
+        return true;
+    }
+
+
+    /// Number of CPUs a CPU list may address.
+#if defined(CPU_SETSIZE)
+    static const long MaxCpus = CPU_SETSIZE;
+#else
+    static const long MaxCpus = 1024;
+#endif
+
+
+    /// Format a CPU list in the kernel's format.
+    static std::string formatCpuList(const std::vector<int>& cpus)
+    {
+        std::stringstream text;
+        std::size_t i = 0;
+
+        while (i < cpus.size()) {
+            std::size_t j = i;
+            while ((j + 1 < cpus.size()) && (cpus[j + 1] == cpus[j] + 1)) {
+                ++j;
+            }
+            if (i) {
+                text << ",";
+            }
+            text << cpus[i];
+            if (j > i) {
+                text << "-" << cpus[j];
+            }
+            i = j + 1;
+        }
+        return text.str();
+    }
+
+
+    /// CPUs the calling thread may run on.
+    static std::vector<int> allowedCpus()
+    {
+        std::vector<int> cpus;
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        if (::sched_getaffinity(0, sizeof(set), &set) == 0) {
+            for (int cpu = 0; cpu < CPU_SETSIZE; ++cpu) {
+                if (CPU_ISSET(cpu, &set)) {
+                    cpus.push_back(cpu);
+                }
+            }
+            return cpus;
+        }
+#endif
+        const long count = ::sysconf(_SC_NPROCESSORS_ONLN);
+        for (long cpu = 0; cpu < count; ++cpu) {
+            cpus.push_back(int(cpu));
+        }
+        return cpus;
+    }
+
+
+    /// Lowest CPU sharing the physical core with a CPU.
+    static int coreId(int cpu)
+    {
+        return firstOf(cpuPath(cpu) + "/topology/thread_siblings_list", cpu);
+    }
+
+
+    /// Lowest CPU sharing the L2 cache with a CPU.
+    static int l2Id(int cpu)
+    {
+        for (int index = 0; index < 8; ++index) {
+            std::stringstream cache;
+            cache << cpuPath(cpu) << "/cache/index" << index;
+
+            if (readLine(cache.str() + "/level") == "2") {
+                return firstOf(cache.str() + "/shared_cpu_list", cpu);
+            }
+        }
+        return coreId(cpu);
+    }
+
+
+    /// Select CPUs for independent jobs.
+
+    /// Picks CPUs that share neither an L2 cache nor a physical core with
+    /// each other first, then CPUs on distinct physical cores, and only
+    /// then SMT siblings of already selected CPUs.
+    /// @param candidates CPUs to choose from.
+    /// @param count Number of CPUs wanted.
+    /// @returns up to count CPUs in ascending order.
+    static std::vector<int> selectIsolatedCpus(const std::vector<int>& candidates,
+                                               std::size_t count)
+    {
+        std::vector<int> selected;
+        std::set<int> usedCpus;
+        std::set<int> usedCores;
+        std::set<int> usedL2;
+
+        for (int pass = 0; pass < 3; ++pass) {
+            for (std::size_t i = 0; i < candidates.size(); ++i) {
+                if (selected.size() >= count) {
+                    break;
+                }
+
+                const int cpu = candidates[i];
+                const int core = coreId(cpu);
+                const int l2 = l2Id(cpu);
+
+                if ((usedCpus.count(cpu)) ||
+                    ((pass < 2) && (usedCores.count(core))) ||
+                    ((pass < 1) && (usedL2.count(l2)))) {
+                    continue;
+                }
+
+                selected.push_back(cpu);
+                usedCpus.insert(cpu);
+                usedCores.insert(core);
+                usedL2.insert(l2);
+            }
+        }
+
+        std::sort(selected.begin(), selected.end());
+        return selected;
+    }
+
+
+    /// Pin the calling thread to a single CPU.
+
+    /// @returns true if the affinity was applied.
+    static bool pinCurrentThread(int cpu)
+    {
+        return pinCurrentThread(std::vector<int>(1, cpu));
+    }
+
+
+    /// Restrict the calling thread to a set of CPUs.
+
+    /// @returns true if the affinity was applied.
+    static bool pinCurrentThread(const std::vector<int>& cpus)
+    {
+#if defined(__linux__)
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        for (std::size_t i = 0; i < cpus.size(); ++i) {
+            if ((cpus[i] >= 0) && (cpus[i] < CPU_SETSIZE)) {
+                CPU_SET(cpus[i], &set);
+            }
+        }
+        return (::sched_setaffinity(0, sizeof(set), &set) == 0);
+#else
+        return false;
+#endif
+    }
+
+
+    /// Read the first line of a file.
+
+    /// @returns the line, or an empty string if the file is unreadable.
+    static std::string readLine(const std::string& path)
+    {
+        std::ifstream file(path.c_str());
+        std::string line;
+        std::getline(file, line);
+        return line;
+    }
+private:
+    static std::string cpuPath(int cpu)
+    {
+        std::stringstream path;
+        path << "/sys/devices/system/cpu/cpu" << cpu;
+        return path.str();
+    }
+
+
+    /// First CPU of a CPU list file, or a fallback if unavailable.
+    static int firstOf(const std::string& path, int fallback)
+    {
+        std::vector<int> cpus;
+        if ((!parseCpuList(readLine(path), cpus)) || (cpus.empty())) {
+            return fallback;
+        }
+        return cpus[0];
+    }
+};
+
+}
+#endif
@@ -0,0 +1,374 @@
+#ifndef BENCHMARK_FREQUENCY_METER_H_
+#define BENCHMARK_FREQUENCY_METER_H_
+#include <cerrno>
+#include <cstddef>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <sstream>
+#include <string>
+#include <stdint.h>
+#include <fcntl.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <linux/perf_event.h>
+    #include <sched.h>
+    #include <sys/syscall.h>
+#endif
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Effective core frequency of the calling thread.
+
+/// Measures the frequency over the timed region of a run as CPU cycles
+/// divided by the time the thread was running, using a perf cycles
+/// counter. Where perf events are not permitted, the APERF/MPERF ratio
+/// from /dev/cpu/<cpu>/msr, scaled by the nominal frequency, is used
+/// instead if readable; runs migrating to another CPU then have no
+/// frequency. Failing both, a perf counter of user space cycles only is
+/// used, as perf_event_paranoid 2 permits. It is divided by a running
+/// time that includes the kernel, so it underestimates the frequency of
+/// runs making system calls or taking page faults; see userOnly(). Each
+/// measured run adds the cpu_frequency_mhz counter.
+class FrequencyMeter {
+public:
+    FrequencyMeter()
+        :   _active(false),
+            _opened(false),
+            _userOnly(false),
+            _cyclesFd(-1),
+            _msrFd(-1),
+            _msrCpu(-1),
+            _startCpu(-1),
+            _frequency(0.0)
+    {
+
+    }
+
+
+    ~FrequencyMeter()
+    {
+        if (_cyclesFd >= 0) {
+            ::close(_cyclesFd);
+        }
+        if (_msrFd >= 0) {
+            ::close(_msrFd);
+        }
+    }
+
+
+    /// Enable frequency measurement for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        enabledFlag() = enabled;
+    }
+
+
+    /// Whether frequency measurement is enabled.
+    static bool enabled()
+    {
+        return enabledFlag();
+    }
+
+
+    /// Nominal frequency of the CPUs in Hz, or 0 if unknown.
+
+    /// Read from the base frequency in cpufreq or else from the CPU model
+    /// name, e.g. "... @ 2.40GHz".
+    static double nominalFrequency()
+    {
+        static double nominal = -1.0;
+        if (nominal >= 0.0) {
+            return nominal;
+        }
+        nominal = 0.0;
+
+        std::ifstream base(
+            "/sys/devices/system/cpu/cpu0/cpufreq/base_frequency");
+        double kilohertz = 0.0;
+        if ((base >> kilohertz) && (kilohertz > 0.0)) {
+            nominal = kilohertz * 1000.0;
+            return nominal;
+        }
+
+        std::ifstream cpuinfo("/proc/cpuinfo");
+        std::string line;
+        while (std::getline(cpuinfo, line)) {
+            if (line.compare(0, 10, "model name") != 0) {
+                continue;
+            }
+            const std::string::size_type at = line.rfind('@');
+            if (at != std::string::npos) {
+                const double gigahertz = ::atof(line.c_str() + at + 1);
+                if (line.find("GHz", at) != std::string::npos) {
+                    nominal = gigahertz * 1000000000.0;
+                }
+            }
+            break;
+        }
+        return nominal;
+    }
+
+
+    /// Start measuring.
+    void begin()
+    {
+        _frequency = 0.0;
+        _active = enabled();
+        if (!_active) {
+            return;
+        }
+
+        if (!_opened) {
+            _opened = true;
+            open();
+        }
+
+        _excluded = Sample();
+        if (_cyclesFd >= 0) {
+            readCycles(_start);
+        } else if (_msrFd >= 0) {
+            _startCpu = currentCpu();
+            if (_startCpu == _msrCpu) {
+                readMsr(_start);
+            }
+        }
+    }
+
+
+    /// Stop measuring until resume(), e.g. while flushing the caches.
+    void pause()
+    {
+        if (!_active) {
+            return;
+        }
+
+        if (_cyclesFd >= 0) {
+            readCycles(_paused);
+        } else if ((_msrFd >= 0) && (currentCpu() == _msrCpu)) {
+            readMsr(_paused);
+        } else {
+            _startCpu = -1;
+        }
+    }
+
+
+    /// Continue measuring after pause().
+    void resume()
+    {
+        if (!_active) {
+            return;
+        }
+
+        Sample resumed;
+        if (_cyclesFd >= 0) {
+            readCycles(resumed);
+        } else if ((_msrFd >= 0) && (currentCpu() == _msrCpu)) {
+            readMsr(resumed);
+        } else {
+            _startCpu = -1;
+            return;
+        }
+        _excluded.Cycles += resumed.Cycles - _paused.Cycles;
+        _excluded.Time += resumed.Time - _paused.Time;
+    }
+
+
+    /// Stop measuring and add the frequency of the run.
+    void end()
+    {
+        if (!_active) {
+            return;
+        }
+        _active = false;
+
+        Sample stop;
+        if (_cyclesFd >= 0) {
+            readCycles(stop);
+            stop.Cycles -= _excluded.Cycles;
+            stop.Time -= _excluded.Time;
+            if (stop.Time > _start.Time) {
+                _frequency = double(stop.Cycles - _start.Cycles) /
+                    double(stop.Time - _start.Time) * 1000000000.0;
+            }
+        } else if ((_msrFd >= 0) &&
+                   (_startCpu == _msrCpu) &&
+                   (currentCpu() == _msrCpu)) {
+            readMsr(stop);
+            stop.Cycles -= _excluded.Cycles;
+            stop.Time -= _excluded.Time;
+            if (stop.Time > _start.Time) {
+                _frequency = double(stop.Cycles - _start.Cycles) /
+                    double(stop.Time - _start.Time) * nominalFrequency();
+            }
+        }
+
+        if (_frequency > 0.0) {
+            _counters["cpu_frequency_mhz"].add(_frequency / 1000000.0);
+        }
+    }
+
+
+    /// Frequency of the last run in Hz, or 0 if not measured.
+    inline double frequency() const
+    {
+        return _frequency;
+    }
+
+
+    /// Whether only cycles in user space are counted.
+
+    /// The frequency is then underestimated for runs spending time in
+    /// the kernel, and not fit for normalizing run times.
+    inline bool userOnly() const
+    {
+        return _userOnly;
+    }
+
+
+    /// Why the frequency cannot be measured, if it cannot.
+    inline const std::string& error() const
+    {
+        return _error;
+    }
+
+
+    /// Move the measured frequencies into a set of counters.
+    void collect(ResultCounters& counters)
+    {
+        mergeCounters(counters, _counters);
+        _counters.clear();
+    }
+private:
+    /// Cycles and reference at a point in time.
+
+    /// The reference is the running time in nanoseconds for perf, or the
+    /// MPERF count for the MSRs.
+    struct Sample {
+        Sample()
+            :   Cycles(0),
+                Time(0)
+        {
+
+        }
+
+        uint64_t Cycles;
+        uint64_t Time;
+    };
+
+
+    /// Open a perf cycles counter, or else the MSRs of the current CPU,
+    /// or else a perf counter of user space cycles.
+    void open()
+    {
+#if defined(__linux__) && defined(SYS_perf_event_open)
+        struct perf_event_attr attr;
+        ::memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = PERF_COUNT_HW_CPU_CYCLES;
+        attr.read_format = PERF_FORMAT_TOTAL_TIME_ENABLED |
+            PERF_FORMAT_TOTAL_TIME_RUNNING;
+        attr.exclude_hv = 1;
+
+        _cyclesFd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (_cyclesFd >= 0) {
+            return;
+        }
+        const std::string perfError = strerror(errno);
+
+        std::stringstream path;
+        _msrCpu = currentCpu();
+        path << "/dev/cpu/" << _msrCpu << "/msr";
+        _msrFd = ::open(path.str().c_str(), O_RDONLY);
+        if ((_msrFd >= 0) && (nominalFrequency() > 0.0)) {
+            return;
+        }
+        const std::string msrError =
+            (_msrFd >= 0 ? "nominal frequency unknown" : strerror(errno));
+        if (_msrFd >= 0) {
+            ::close(_msrFd);
+            _msrFd = -1;
+        }
+
+        // Counting user space only may still be permitted.
+        attr.exclude_kernel = 1;
+        _cyclesFd = int(::syscall(SYS_perf_event_open, &attr, 0, -1, -1, 0));
+        if (_cyclesFd >= 0) {
+            _userOnly = true;
+            return;
+        }
+
+        _error = "perf_event_open: " + perfError + "; " + path.str() + ": " +
+            msrError;
+#else
+        _error = "not supported on this platform";
+#endif
+    }
+
+
+    void readCycles(Sample& sample) const
+    {
+        uint64_t values[3] = { 0, 0, 0 };
+        if (::read(_cyclesFd, values, sizeof(values)) ==
+            ssize_t(sizeof(values))) {
+            sample.Cycles = values[0];
+            sample.Time = values[2];
+        }
+    }
+
+
+    void readMsr(Sample& sample) const
+    {
+        // IA32_MPERF and IA32_APERF.
+        uint64_t mperf = 0;
+        uint64_t aperf = 0;
+        if ((::pread(_msrFd, &mperf, sizeof(mperf), 0xE7) ==
+             ssize_t(sizeof(mperf))) &&
+            (::pread(_msrFd, &aperf, sizeof(aperf), 0xE8) ==
+             ssize_t(sizeof(aperf)))) {
+            sample.Cycles = aperf;
+            sample.Time = mperf;
+        }
+    }
+
+
+    static int currentCpu()
+    {
+#if defined(__linux__)
+        return ::sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+
+    static bool& enabledFlag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+private:
+    FrequencyMeter(const FrequencyMeter&);
+    FrequencyMeter& operator =(const FrequencyMeter&);
+private:
+    bool            _active;
+    bool            _opened;
+    bool            _userOnly;
+    int             _cyclesFd;
+    int             _msrFd;
+    int             _msrCpu;
+    int             _startCpu;
+    double          _frequency;
+    Sample          _start;
+    Sample          _paused;
+    Sample          _excluded;
+    std::string     _error;
+    ResultCounters  _counters;
+};
+
+}
+#endif
@@ -0,0 +1,346 @@
+#ifndef BENCHMARK_JUNIT_XML_OUTPUTTER_H_
+#define BENCHMARK_JUNIT_XML_OUTPUTTER_H_
+#include <cstdio>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <benchmark/outputter.h>
+
+namespace benchmark {
+
+/// Writes results as JUnit-compatible XML.
+
+/// Each fixture is a test suite and each benchmark a test case, so CI
+/// dashboards show benchmarks next to unit tests. A benchmark exceeding
+/// its performance budget, set with BENCHMARK_BUDGET, is a failure;
+/// one that did not produce a result is an error and a disabled one is
+/// skipped. The environment is attached to every suite as properties.
+/// The document is written at end(), since suites carry their totals.
+class JUnitXmlOutputter : public Outputter {
+public:
+    JUnitXmlOutputter(std::ostream& stream = std::cout)
+        :   _stream(stream)
+    {
+
+    }
+
+
+    virtual void environment(const Environment& environment)
+    {
+        _properties = environment.Properties;
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        Counts all;
+        for (std::size_t i = 0; i < _suites.size(); ++i) {
+            all.add(_suites[i].Totals);
+        }
+
+        _stream << "<?xml version=\"1.0\" encoding=\"UTF-8\"?>\n"
+                << "<testsuites name=\"benchmarks\"";
+        writeTotals(all);
+        _stream << ">\n";
+
+        for (std::size_t s = 0; s < _suites.size(); ++s) {
+            const Suite& suite = _suites[s];
+
+            _stream << "  <testsuite name=\"" << escape(suite.Name) << "\"";
+            writeTotals(suite.Totals);
+            _stream << ">\n";
+
+            if (!_properties.empty()) {
+                _stream << "    <properties>\n";
+                for (std::size_t p = 0; p < _properties.size(); ++p) {
+                    _stream << "      <property name=\""
+                            << escape(_properties[p].first)
+                            << "\" value=\""
+                            << escape(_properties[p].second) << "\"/>\n";
+                }
+                _stream << "    </properties>\n";
+            }
+
+            for (std::size_t c = 0; c < suite.Cases.size(); ++c) {
+                writeCase(suite.Name, suite.Cases[c]);
+            }
+            _stream << "  </testsuite>\n";
+        }
+
+        _stream << "</testsuites>\n";
+        _stream.flush();
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+        Case testCase(caseName(testName, parameters), CasePassed);
+        testCase.Seconds = result.timeTotal() / 1000000000.0;
+
+        const BudgetChecks& checks = result.budgetChecks();
+        for (std::size_t i = 0; i < checks.size(); ++i) {
+            if (!checks[i].Passed) {
+                testCase.Outcome = CaseFailed;
+                testCase.Message += (testCase.Message.empty() ? "" : "; ") +
+                    checks[i].Description;
+            }
+        }
+
+        std::stringstream summary;
+        summary.setf(std::ios::fixed);
+        summary.precision(3);
+        summary << "runs: " << result.runs()
+                << ", iterations: " << result.iterations()
+                << ", median: " << result.iterationTimeMedian()
+                << " ns/iteration, p99: "
+                << result.iterationTimeQuantile(0.99)
+                << " ns/iteration, mean: " << result.iterationTimeAverage()
+                << " ns/iteration, stddev: "
+                << result.iterationTimeStdDev() << " ns/iteration";
+        for (std::size_t i = 0; i < result.metadata().size(); ++i) {
+            summary << "\n" << result.metadata()[i].first << ": "
+                    << result.metadata()[i].second;
+        }
+        testCase.Output = summary.str();
+
+        suite(fixtureName).add(testCase);
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+        Case testCase(caseName(testName, parameters), CaseSkipped);
+        testCase.Message = "disabled";
+        suite(fixtureName).add(testCase);
+    }
+
+
+    virtual void failTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          const std::string& reason)
+    {
+        Case testCase(caseName(testName, parameters), CaseError);
+        testCase.Message = reason;
+        suite(fixtureName).add(testCase);
+    }
+private:
+    enum CaseOutcome {
+        CasePassed,
+        CaseFailed,
+        CaseError,
+        CaseSkipped
+    };
+
+
+    struct Case {
+        Case(const std::string& name, CaseOutcome outcome)
+            :   Name(name),
+                Outcome(outcome),
+                Seconds(0.0)
+        {
+
+        }
+
+        std::string  Name;
+        CaseOutcome  Outcome;
+        double       Seconds;
+        std::string  Message;
+        std::string  Output;
+    };
+
+
+    struct Counts {
+        Counts()
+            :   Tests(0),
+                Failures(0),
+                Errors(0),
+                Skipped(0),
+                Seconds(0.0)
+        {
+
+        }
+
+
+        void add(const Counts& other)
+        {
+            Tests += other.Tests;
+            Failures += other.Failures;
+            Errors += other.Errors;
+            Skipped += other.Skipped;
+            Seconds += other.Seconds;
+        }
+
+        std::size_t  Tests;
+        std::size_t  Failures;
+        std::size_t  Errors;
+        std::size_t  Skipped;
+        double       Seconds;
+    };
+
+
+    struct Suite {
+        Suite(const std::string& name)
+            :   Name(name)
+        {
+
+        }
+
+
+        void add(const Case& testCase)
+        {
+            Cases.push_back(testCase);
+            ++Totals.Tests;
+            Totals.Seconds += testCase.Seconds;
+            if (testCase.Outcome == CaseFailed) {
+                ++Totals.Failures;
+            } else if (testCase.Outcome == CaseError) {
+                ++Totals.Errors;
+            } else if (testCase.Outcome == CaseSkipped) {
+                ++Totals.Skipped;
+            }
+        }
+
+        std::string        Name;
+        std::vector<Case>  Cases;
+        Counts             Totals;
+    };
+
+
+    /// Suite of a fixture, in order of first appearance.
+    Suite& suite(const std::string& fixtureName)
+    {
+        for (std::size_t i = 0; i < _suites.size(); ++i) {
+            if (_suites[i].Name == fixtureName) {
+                return _suites[i];
+            }
+        }
+        _suites.push_back(Suite(fixtureName));
+        return _suites.back();
+    }
+
+
+    /// Test name with its parameters, e.g. "test(int speed = 1)".
+    static std::string caseName(const std::string& testName,
+                                const TestParametersDescriptor& parameters)
+    {
+        const std::vector<TestParameterDescriptor>& descs =
+            parameters.Parameters();
+        if (descs.empty()) {
+            return testName;
+        }
+
+        std::string name = testName + "(";
+        for (std::size_t i = 0; i < descs.size(); ++i) {
+            name += (i ? ", " : "") + descs[i].Declaration + " = " +
+                descs[i].Value;
+        }
+        return name + ")";
+    }
+
+
+    void writeTotals(const Counts& totals)
+    {
+        char seconds[32];
+        ::snprintf(seconds, sizeof(seconds), "%.6f", totals.Seconds);
+        _stream << " tests=\"" << totals.Tests << "\""
+                << " failures=\"" << totals.Failures << "\""
+                << " errors=\"" << totals.Errors << "\""
+                << " skipped=\"" << totals.Skipped << "\""
+                << " time=\"" << seconds << "\"";
+    }
+
+
+    void writeCase(const std::string& suiteName, const Case& testCase)
+    {
+        char seconds[32];
+        ::snprintf(seconds, sizeof(seconds), "%.6f", testCase.Seconds);
+        _stream << "    <testcase classname=\"" << escape(suiteName)
+                << "\" name=\"" << escape(testCase.Name)
+                << "\" time=\"" << seconds << "\"";
+
+        if ((testCase.Outcome == CasePassed) && (testCase.Output.empty())) {
+            _stream << "/>\n";
+            return;
+        }
+        _stream << ">\n";
+
+        if (testCase.Outcome == CaseFailed) {
+            _stream << "      <failure type=\"budget\" message=\""
+                    << escape(testCase.Message) << "\">"
+                    << escape(testCase.Message) << "</failure>\n";
+        } else if (testCase.Outcome == CaseError) {
+            _stream << "      <error message=\""
+                    << escape(testCase.Message) << "\"/>\n";
+        } else if (testCase.Outcome == CaseSkipped) {
+            _stream << "      <skipped message=\""
+                    << escape(testCase.Message) << "\"/>\n";
+        }
+
+        if (!testCase.Output.empty()) {
+            _stream << "      <system-out>" << escape(testCase.Output)
+                    << "</system-out>\n";
+        }
+        _stream << "    </testcase>\n";
+    }
+
+
+    /// Escape text for attributes and character data.
+
+    /// Control characters XML cannot represent are dropped.
+    static std::string escape(const std::string& text)
+    {
+        std::string escaped;
+        for (std::size_t i = 0; i < text.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(text[i]);
+            if (c == '&') {
+                escaped += "&amp;";
+            } else if (c == '<') {
+                escaped += "&lt;";
+            } else if (c == '>') {
+                escaped += "&gt;";
+            } else if (c == '"') {
+                escaped += "&quot;";
+            } else if (c == '\'') {
+                escaped += "&apos;";
+            } else if (c == '\n') {
+                escaped += "&#10;";
+            } else if ((c >= 0x20) || (c == '\t') || (c == '\r')) {
+                escaped += char(c);
+            }
+        }
+        return escaped;
+    }
+private:
+    std::ostream       &_stream;
+    ResultMetadata      _properties;
+    std::vector<Suite>  _suites;
+};
+
+}
+#endif
@@ -0,0 +1,361 @@
+#ifndef BENCHMARK_PARALLEL_SCHEDULER_H_
+#define BENCHMARK_PARALLEL_SCHEDULER_H_
+#include <algorithm>
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <fstream>
+#include <map>
+#include <string>
+#include <vector>
+#include <poll.h>
+#include <benchmark/clock.h>
+#include <benchmark/isolation.h>
+
+namespace benchmark {
+
+/// Historical test durations.
+
+/// Stored as one "<seconds> <test name>" line per test.
+class DurationHistory {
+public:
+    /// Load durations from a file.
+
+    /// A missing or unreadable file leaves the history empty.
+    void load(const std::string& path)
+    {
+        std::ifstream file(path.c_str());
+        std::string line;
+
+        while (std::getline(file, line)) {
+            const std::string::size_type space = line.find(' ');
+            if (space == std::string::npos) {
+                continue;
+            }
+            _durations[line.substr(space + 1)] =
+                ::strtod(line.substr(0, space).c_str(), NULL);
+        }
+    }
+
+
+    /// Save durations to a file.
+
+    /// @returns false if the file could not be written.
+    bool save(const std::string& path) const
+    {
+        std::ofstream file(path.c_str(),
+                           std::ios_base::out | std::ios_base::trunc);
+        for (std::map<std::string, double>::const_iterator it =
+                 _durations.begin();
+             it != _durations.end();
+             ++it) {
+            file << it->second << " " << it->first << "\n";
+        }
+        return file.good();
+    }
+
+
+    /// Duration of a test in seconds, or a negative value if unknown.
+    double duration(const std::string& name) const
+    {
+        std::map<std::string, double>::const_iterator it =
+            _durations.find(name);
+        return (it == _durations.end() ? -1.0 : it->second);
+    }
+
+
+    /// Record the duration of a test in seconds.
+    void record(const std::string& name, double seconds)
+    {
+        _durations[name] = seconds;
+    }
+private:
+    std::map<std::string, double> _durations;
+};
+
+
+/// Runs independent isolated tasks concurrently on dedicated CPUs.
+
+/// Each task runs in its own forked child pinned to one of the given
+/// CPUs, at most one task per CPU at a time. Tasks are started longest
+/// expected duration first, with tasks of unknown duration ahead of all
+/// others, but completions are reported strictly in task order so that
+/// the output does not depend on scheduling.
+class ParallelScheduler {
+public:
+    /// Receives completed tasks in task order.
+    class Listener {
+    public:
+        virtual ~Listener()
+        {
+
+        }
+
+
+        /// A task has completed.
+
+        /// @param index Index of the task.
+        /// @param success Whether the task produced a payload.
+        /// @param payload Payload produced by the task.
+        /// @param failure Description of the failure, if any.
+        /// @param seconds Wall time the task took.
+        virtual void taskCompleted(std::size_t index,
+                                   bool success,
+                                   const std::string& payload,
+                                   const std::string& failure,
+                                   double seconds) = 0;
+    };
+
+
+    /// @param cpus CPUs to run tasks on, one task per CPU at a time.
+    /// @param timeoutSeconds Time limit for each task, or 0 for none.
+    ParallelScheduler(const std::vector<int>& cpus, unsigned timeoutSeconds)
+        :   _cpus(cpus),
+            _timeoutSeconds(timeoutSeconds)
+    {
+        if (_cpus.empty()) {
+            _cpus.push_back(-1);
+        }
+    }
+
+
+    /// Run all tasks.
+
+    /// @param tasks Tasks to run.
+    /// @param expectedSeconds Expected duration of each task, negative
+    /// if unknown.
+    /// @param listener Listener to report completed tasks to.
+    void run(const std::vector<IsolatedTask*>& tasks,
+             const std::vector<double>& expectedSeconds,
+             Listener& listener)
+    {
+        const std::size_t count = tasks.size();
+
+        // Order the tasks longest first.
+        std::vector<std::size_t> order(count);
+        for (std::size_t i = 0; i < count; ++i) {
+            order[i] = i;
+        }
+        std::stable_sort(order.begin(),
+                         order.end(),
+                         LongestFirst(expectedSeconds));
+
+        std::vector<Completion> completions(count);
+        std::vector<Slot> slots(_cpus.size());
+        const Clock::TimeDiff limit =
+            Clock::TimeDiff(_timeoutSeconds) * 1000000000ULL;
+
+        std::size_t next = 0;
+        std::size_t reported = 0;
+        std::size_t running = 0;
+
+        while (reported < count) {
+            // Fill idle CPUs.
+            for (std::size_t s = 0; (s < slots.size()) && (next < count); ++s) {
+                if (slots[s].Child) {
+                    continue;
+                }
+
+                const std::size_t index = order[next++];
+                Slot& slot = slots[s];
+                slot.Child = new ChildProcess();
+                slot.Index = index;
+
+                std::string failure;
+                if (!slot.Child->start(*tasks[index], _cpus[s], failure)) {
+                    delete slot.Child;
+                    slot.Child = NULL;
+                    completions[index].complete(false,
+                                                std::string(),
+                                                failure,
+                                                0.0);
+                    continue;
+                }
+                ++running;
+            }
+
+            // Wait for output from running children.
+            if (running) {
+                std::vector<struct pollfd> fds;
+                std::vector<std::size_t> fdSlots;
+                int timeoutMs = -1;
+
+                for (std::size_t s = 0; s < slots.size(); ++s) {
+                    if (!slots[s].Child) {
+                        continue;
+                    }
+
+                    struct pollfd pfd;
+                    pfd.fd = slots[s].Child->fd();
+                    pfd.events = POLLIN;
+                    pfd.revents = 0;
+                    fds.push_back(pfd);
+                    fdSlots.push_back(s);
+
+                    if (_timeoutSeconds) {
+                        const Clock::TimeDiff elapsed =
+                            slots[s].Child->elapsed();
+                        const int remaining = (elapsed >= limit ?
+                            0 :
+                            int((limit - elapsed) / 1000000) + 1);
+                        if ((timeoutMs < 0) || (remaining < timeoutMs)) {
+                            timeoutMs = remaining;
+                        }
+                    }
+                }
+
+                const int ready = ::poll(&fds[0], fds.size(), timeoutMs);
+                if ((ready < 0) && (errno != EINTR)) {
+                    // No child can be waited for any more, so the running
+                    // and remaining tasks fail.
+                    const std::string failure =
+                        std::string("poll failed: ") + strerror(errno);
+                    for (std::size_t s = 0; s < slots.size(); ++s) {
+                        if (!slots[s].Child) {
+                            continue;
+                        }
+                        completions[slots[s].Index].complete(
+                            false,
+                            std::string(),
+                            failure,
+                            double(slots[s].Child->elapsed()) / 1000000000.0);
+                        delete slots[s].Child;
+                        slots[s].Child = NULL;
+                    }
+                    while (next < count) {
+                        completions[order[next++]].complete(false,
+                                                            std::string(),
+                                                            failure,
+                                                            0.0);
+                    }
+                    running = 0;
+                    continue;
+                }
+
+                for (std::size_t f = 0; f < fds.size(); ++f) {
+                    Slot& slot = slots[fdSlots[f]];
+                    bool done = false;
+                    bool timedOut = false;
+
+                    if ((ready > 0) && (fds[f].revents)) {
+                        done = !slot.Child->read();
+                    }
+                    if ((!done) &&
+                        (_timeoutSeconds) &&
+                        (slot.Child->elapsed() >= limit)) {
+                        done = true;
+                        timedOut = true;
+                    }
+                    if (!done) {
+                        continue;
+                    }
+
+                    const double seconds =
+                        double(slot.Child->elapsed()) / 1000000000.0;
+                    std::string payload;
+                    std::string failure;
+                    const bool success = slot.Child->finish(timedOut,
+                                                            _timeoutSeconds,
+                                                            payload,
+                                                            failure);
+                    completions[slot.Index].complete(success,
+                                                     payload,
+                                                     failure,
+                                                     seconds);
+                    delete slot.Child;
+                    slot.Child = NULL;
+                    --running;
+                }
+            }
+
+            // Report completions in task order.
+            while ((reported < count) && (completions[reported].Done)) {
+                const Completion& completion = completions[reported];
+                listener.taskCompleted(reported,
+                                       completion.Success,
+                                       completion.Payload,
+                                       completion.Failure,
+                                       completion.Seconds);
+                completions[reported].Payload.clear();
+                ++reported;
+            }
+        }
+
+        for (std::size_t s = 0; s < slots.size(); ++s) {
+            delete slots[s].Child;
+        }
+    }
+private:
+    /// A CPU and the child running on it.
+    struct Slot {
+        Slot()
+            :   Child(NULL),
+                Index(0)
+        {
+
+        }
+
+        ChildProcess  *Child;
+        std::size_t    Index;
+    };
+
+
+    /// Outcome of a task awaiting its turn to be reported.
+    struct Completion {
+        Completion()
+            :   Done(false),
+                Success(false),
+                Seconds(0.0)
+        {
+
+        }
+
+        void complete(bool success,
+                      const std::string& payload,
+                      const std::string& failure,
+                      double seconds)
+        {
+            Done = true;
+            Success = success;
+            Payload = payload;
+            Failure = failure;
+            Seconds = seconds;
+        }
+
+        bool          Done;
+        bool          Success;
+        std::string   Payload;
+        std::string   Failure;
+        double        Seconds;
+    };
+
+
+    /// Orders task indices by descending expected duration.
+    class LongestFirst {
+    public:
+        LongestFirst(const std::vector<double>& expectedSeconds)
+            :   _expectedSeconds(expectedSeconds)
+        {
+
+        }
+
+        bool operator ()(std::size_t a, std::size_t b) const
+        {
+            const double da = _expectedSeconds[a];
+            const double db = _expectedSeconds[b];
+
+            if ((da < 0) || (db < 0)) {
+                return ((da < 0) && (db >= 0));
+            }
+            return (da > db);
+        }
+    private:
+        const std::vector<double>& _expectedSeconds;
+    };
+private:
+    std::vector<int>   _cpus;
+    unsigned           _timeoutSeconds;
+};
+
+}
+#endif
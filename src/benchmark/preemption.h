@@ -0,0 +1,150 @@
+#ifndef BENCHMARK_PREEMPTION_H_
+#define BENCHMARK_PREEMPTION_H_
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/resource.h>
+    #include <sys/time.h>
+#endif
+
+namespace benchmark {
+
+/// Detects runs disturbed by the scheduler.
+
+/// A run is disturbed if the thread was preempted, seen as an involuntary
+/// context switch, or migrated to another CPU, seen by sched_getcpu()
+/// differing before and after the timed region or any part of it between
+/// pauses. Only the thread running the test body is observed. Detection is
+/// available on Linux only.
+class PreemptionDetector {
+public:
+    PreemptionDetector()
+        :   _active(false),
+            _disturbed(false),
+            _migrated(false),
+            _startSwitches(0),
+            _pausedSwitches(0),
+            _excludedSwitches(0),
+            _startCpu(-1)
+    {
+
+    }
+
+
+    /// Enable detection for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        enabledFlag() = enabled;
+    }
+
+
+    /// Whether detection is enabled.
+    static bool enabled()
+    {
+        return enabledFlag();
+    }
+
+
+    /// Start observing the timed region.
+    inline void begin()
+    {
+        _disturbed = false;
+        _active = enabled();
+        if (!_active) {
+            return;
+        }
+
+        _migrated = false;
+        _excludedSwitches = 0;
+        _startSwitches = involuntarySwitches();
+        _startCpu = currentCpu();
+    }
+
+
+    /// Stop observing until resume(), e.g. while flushing the caches.
+    inline void pause()
+    {
+        if (!_active) {
+            return;
+        }
+
+        if (currentCpu() != _startCpu) {
+            _migrated = true;
+        }
+        _pausedSwitches = involuntarySwitches();
+    }
+
+
+    /// Continue observing after pause().
+    inline void resume()
+    {
+        if (!_active) {
+            return;
+        }
+
+        _excludedSwitches += involuntarySwitches() - _pausedSwitches;
+        _startCpu = currentCpu();
+    }
+
+
+    /// Stop observing the timed region.
+    inline void end()
+    {
+        if (!_active) {
+            return;
+        }
+        _active = false;
+
+        _disturbed = ((_migrated) ||
+                      (involuntarySwitches() - _excludedSwitches !=
+                       _startSwitches) ||
+                      (currentCpu() != _startCpu));
+    }
+
+
+    /// Whether the last observed region was disturbed.
+    inline bool disturbed() const
+    {
+        return _disturbed;
+    }
+private:
+    static long involuntarySwitches()
+    {
+#if defined(__linux__) && defined(RUSAGE_THREAD)
+        struct rusage usage;
+        if (::getrusage(RUSAGE_THREAD, &usage) == 0) {
+            return usage.ru_nivcsw;
+        }
+#endif
+        return 0;
+    }
+
+
+    static int currentCpu()
+    {
+#if defined(__linux__)
+        return ::sched_getcpu();
+#else
+        return -1;
+#endif
+    }
+
+
+    static bool& enabledFlag()
+    {
+        static bool enabled = false;
+        return enabled;
+    }
+private:
+    bool    _active;
+    bool    _disturbed;
+    bool    _migrated;
+    long    _startSwitches;
+    long    _pausedSwitches;
+    long    _excludedSwitches;
+    int     _startCpu;
+};
+
+}
+#endif
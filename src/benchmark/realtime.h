@@ -0,0 +1,230 @@
+#ifndef BENCHMARK_REALTIME_H_
+#define BENCHMARK_REALTIME_H_
+#include <algorithm>
+#include <cerrno>
+#include <iterator>
+#include <cstring>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sched.h>
+    #include <sys/prctl.h>
+#endif
+#include <benchmark/cpu_topology.h>
+#include <benchmark/placement.h>
+#include <benchmark/test_result.h>
+
+namespace benchmark {
+
+/// Real-time measures against preemption and interrupts.
+class Realtime {
+public:
+    Realtime()
+        :   Enabled(false),
+            Priority(50)
+    {
+
+    }
+
+
+    /// Whether to apply the measures.
+    bool Enabled;
+
+
+    /// SCHED_FIFO priority, from 1 to 99.
+    int Priority;
+
+
+    /// CPUs isolated from the scheduler or from the timer tick.
+
+    /// Read from /sys/devices/system/cpu/isolated and nohz_full. Only CPUs
+    /// listed in both are returned if there are any.
+    static std::vector<int> isolatedCpus()
+    {
+        std::vector<int> isolated;
+        std::vector<int> nohzFull;
+        CpuTopology::parseCpuList(
+            CpuTopology::readLine("/sys/devices/system/cpu/isolated"),
+            isolated);
+        CpuTopology::parseCpuList(
+            CpuTopology::readLine("/sys/devices/system/cpu/nohz_full"),
+            nohzFull);
+
+        std::vector<int> both;
+        std::set_intersection(isolated.begin(),
+                              isolated.end(),
+                              nohzFull.begin(),
+                              nohzFull.end(),
+                              std::back_inserter(both));
+        if (!both.empty()) {
+            return both;
+        }
+
+        std::vector<int> either;
+        std::set_union(isolated.begin(),
+                       isolated.end(),
+                       nohzFull.begin(),
+                       nohzFull.end(),
+                       std::back_inserter(either));
+        return either;
+    }
+};
+
+
+/// Applies real-time measures for the life time of the guard.
+
+/// Each measure is tried on its own and falls back to doing nothing if
+/// not permitted. What was actually applied is recorded as result
+/// metadata:
+///
+/// - realtime_scheduler: "fifo:<priority>" for SCHED_FIFO. The kernel's
+///   real-time throttling still leaves other tasks a share of the CPU.
+/// - timer_slack_ns: 1 when the timer slack of the thread was reduced, so
+///   timed sleeps in the benchmark wake up on time.
+/// - isolated_cpu: the isolcpus or nohz_full CPU the thread moved to, if
+///   the benchmark has no CPUs of its own and such CPUs exist, on its NUMA
+///   node if it has one. The cpus entry is then updated to the new
+///   affinity.
+///
+/// The previous policy, timer slack and affinity are restored on
+/// destruction.
+class RealtimeGuard {
+public:
+    /// @param realtime Measures to apply.
+    /// @param moveToIsolated Whether the thread may move to an isolated CPU.
+    /// @param numaNode NUMA node the isolated CPU must be on, or -1.
+    /// @param metadata Receives the applied measures.
+    RealtimeGuard(const Realtime& realtime,
+                  bool moveToIsolated,
+                  int numaNode,
+                  ResultMetadata& metadata)
+        :   _scheduled(false),
+            _slackSet(false),
+            _moved(false),
+            _previousPolicy(0),
+            _previousPriority(0),
+            _previousSlack(0)
+    {
+        if (!realtime.Enabled) {
+            return;
+        }
+
+#if defined(__linux__)
+        // Scheduling policy.
+        _previousPolicy = ::sched_getscheduler(0);
+        struct sched_param previous;
+        if (::sched_getparam(0, &previous) == 0) {
+            _previousPriority = previous.sched_priority;
+        }
+
+        struct sched_param param;
+        ::memset(&param, 0, sizeof(param));
+        param.sched_priority = realtime.Priority;
+        if (::sched_setscheduler(0, SCHED_FIFO, &param) == 0) {
+            _scheduled = true;
+            std::stringstream value;
+            value << "fifo:" << realtime.Priority;
+            metadata.push_back(ResultMetadataEntry("realtime_scheduler",
+                                                   value.str()));
+        } else {
+            metadata.push_back(ResultMetadataEntry(
+                "realtime_scheduler_error",
+                std::string("SCHED_FIFO: ") + strerror(errno)));
+        }
+
+        // Timer slack.
+        const int slack = ::prctl(PR_GET_TIMERSLACK, 0, 0, 0, 0);
+        if ((slack >= 0) && (::prctl(PR_SET_TIMERSLACK, 1, 0, 0, 0) == 0)) {
+            _previousSlack = slack;
+            _slackSet = true;
+            metadata.push_back(ResultMetadataEntry("timer_slack_ns", "1"));
+        } else {
+            metadata.push_back(ResultMetadataEntry(
+                "timer_slack_error",
+                std::string("PR_SET_TIMERSLACK: ") + strerror(errno)));
+        }
+
+        // Isolated CPUs, on the node memory is bound to.
+        std::vector<int> isolated = Realtime::isolatedCpus();
+        if (numaNode >= 0) {
+            const std::vector<int> nodeCpus = Placement::nodeCpus(numaNode);
+            std::vector<int> onNode;
+            std::set_intersection(isolated.begin(),
+                                  isolated.end(),
+                                  nodeCpus.begin(),
+                                  nodeCpus.end(),
+                                  std::back_inserter(onNode));
+            isolated.swap(onNode);
+        }
+        if ((moveToIsolated) && (!isolated.empty())) {
+            _previousCpus = CpuTopology::allowedCpus();
+            if (CpuTopology::pinCurrentThread(isolated[0])) {
+                _moved = true;
+                std::stringstream value;
+                value << isolated[0];
+                metadata.push_back(ResultMetadataEntry("isolated_cpu",
+                                                       value.str()));
+                recordCpus(metadata);
+            } else {
+                metadata.push_back(ResultMetadataEntry(
+                    "isolated_cpu_error", strerror(errno)));
+            }
+        }
+#else
+        (void)moveToIsolated;
+        (void)numaNode;
+        metadata.push_back(ResultMetadataEntry(
+            "realtime_scheduler_error",
+            "real-time measures are not supported on this platform"));
+#endif
+    }
+
+
+    ~RealtimeGuard()
+    {
+#if defined(__linux__)
+        if (_moved) {
+            CpuTopology::pinCurrentThread(_previousCpus);
+        }
+        if (_slackSet) {
+            ::prctl(PR_SET_TIMERSLACK, _previousSlack, 0, 0, 0);
+        }
+        if (_scheduled) {
+            struct sched_param param;
+            ::memset(&param, 0, sizeof(param));
+            param.sched_priority = _previousPriority;
+            ::sched_setscheduler(0, _previousPolicy, &param);
+        }
+#endif
+    }
+private:
+    /// Record the effective CPUs, replacing those recorded on placement.
+    static void recordCpus(ResultMetadata& metadata)
+    {
+        const std::string cpus =
+            CpuTopology::formatCpuList(CpuTopology::allowedCpus());
+        for (std::size_t i = 0; i < metadata.size(); ++i) {
+            if (metadata[i].first == "cpus") {
+                metadata[i].second = cpus;
+                return;
+            }
+        }
+        metadata.push_back(ResultMetadataEntry("cpus", cpus));
+    }
+private:
+    RealtimeGuard(const RealtimeGuard&);
+    RealtimeGuard& operator =(const RealtimeGuard&);
+private:
+    bool              _scheduled;
+    bool              _slackSet;
+    bool              _moved;
+    int               _previousPolicy;
+    int               _previousPriority;
+    int               _previousSlack;
+    std::vector<int>  _previousCpus;
+};
+
+}
+#endif
@@ -0,0 +1,596 @@
+#ifndef BENCHMARK_REPETITION_H_
+#define BENCHMARK_REPETITION_H_
+#include <cerrno>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <signal.h>
+#include <stdint.h>
+#include <sys/types.h>
+#include <sys/wait.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sys/personality.h>
+#endif
+#include <benchmark/benchmarker.h>
+#include <benchmark/binary_encoding.h>
+#include <benchmark/outputter.h>
+#include <benchmark/test_descriptor.h>
+#include <benchmark/test_result.h>
+#include <benchmark/trace_recorder.h>
+
+/// Environment variable padding the environment block of a repetition.
+#define BENCHMARK_LAYOUT_PADDING_ENV "BENCHMARK_LAYOUT_PADDING"
+
+/// Environment variable seeding the stack and heap padding of a repetition.
+#define BENCHMARK_LAYOUT_SEED_ENV "BENCHMARK_LAYOUT_SEED"
+
+namespace benchmark {
+
+/// Memory layout perturbation of a repeated benchmark process.
+
+/// Each repetition is started with a random layout seed, from which the
+/// stack and heap offsets of the benchmark process are derived.
+class ProcessLayout {
+public:
+    /// Layout seed of this process, or 0 if not a repetition.
+    static unsigned long seed()
+    {
+        const char* value = ::getenv(BENCHMARK_LAYOUT_SEED_ENV);
+        return (value ? ::strtoul(value, NULL, 10) : 0);
+    }
+
+
+    /// Bytes to offset the stack by before running benchmarks.
+    static std::size_t stackPadding()
+    {
+        return std::size_t(seed() % 4096);
+    }
+
+
+    /// Bytes to offset the heap by before running benchmarks.
+    static std::size_t heapPadding()
+    {
+        return std::size_t((seed() / 4096) % 65536);
+    }
+};
+
+
+/// Outputter shipping results of a repeated process to its parent.
+
+/// Writes one compact binary record per finished, failed or disabled
+/// test to a file descriptor inherited from the parent, and the recorded
+/// timeline at the end if tracing.
+class RepetitionOutputter : public Outputter {
+public:
+    enum RecordType {
+        /// Test result.
+        RecordResult = 'R',
+
+
+        /// Failed test.
+        RecordFailure = 'F',
+
+
+        /// Disabled test.
+        RecordDisabled = 'D',
+
+
+        /// Timeline of the process.
+        RecordTrace = 'T'
+    };
+
+
+    /// @param fd File descriptor to write records to.
+    RepetitionOutputter(int fd)
+        :   _fd(fd)
+    {
+
+    }
+
+
+    virtual ~RepetitionOutputter()
+    {
+        ::close(_fd);
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        if (!TraceRecorder::enabled()) {
+            return;
+        }
+
+        std::string record;
+        BinaryWriter writer(record);
+        writer.write<uint8_t>(uint8_t(RecordTrace));
+        writer.writeTrace(TraceRecorder::events());
+        send(record);
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+        std::string record;
+        BinaryWriter writer(record);
+        writeHeader(writer, RecordDisabled, fixtureName, testName, parameters);
+        writer.write<uint64_t>(runsCount);
+        writer.write<uint64_t>(iterationsCount);
+        send(record);
+    }
+
+
+    virtual void failTest(const std::string& fixtureName,
+                          const std::string& testName,
+                          const TestParametersDescriptor& parameters,
+                          const std::string& reason)
+    {
+        std::string record;
+        BinaryWriter writer(record);
+        writeHeader(writer, RecordFailure, fixtureName, testName, parameters);
+        writer.writeString(reason);
+        send(record);
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+        std::string record;
+        BinaryWriter writer(record);
+        writeHeader(writer, RecordResult, fixtureName, testName, parameters);
+        writer.write<uint64_t>(result.iterations());
+        writer.writeStatistics(result.runTimeStatistics());
+        writer.writeMetadata(result.metadata());
+        writer.writeCounters(result.counters());
+        writer.write<uint64_t>(result.disturbedRuns());
+        writer.write<uint64_t>(result.rejectedRuns());
+        send(record);
+    }
+private:
+    static void writeHeader(BinaryWriter& writer,
+                            RecordType type,
+                            const std::string& fixtureName,
+                            const std::string& testName,
+                            const TestParametersDescriptor& parameters)
+    {
+        writer.write<uint8_t>(uint8_t(type));
+        writer.writeString(fixtureName);
+        writer.writeString(testName);
+
+        const std::vector<TestParameterDescriptor>& descs =
+            parameters.Parameters();
+
+        writer.write<uint32_t>(uint32_t(descs.size()));
+        for (std::size_t i = 0; i < descs.size(); ++i) {
+            writer.writeString(descs[i].Declaration);
+            writer.writeString(descs[i].Value);
+        }
+    }
+
+
+    void send(const std::string& record)
+    {
+        std::string framed;
+        BinaryWriter writer(framed);
+        writer.write<uint32_t>(uint32_t(record.size()));
+        framed.append(record);
+
+        const char* data = framed.data();
+        std::size_t remaining = framed.size();
+
+        while (remaining) {
+            const ssize_t written = ::write(_fd, data, remaining);
+            if (written < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                throw std::runtime_error(
+                    std::string("failed to send result: ") + strerror(errno)
+                );
+            }
+            data += written;
+            remaining -= std::size_t(written);
+        }
+    }
+private:
+    int _fd;
+};
+
+
+/// Runs the benchmark executable repeatedly and aggregates the results.
+
+/// Every repetition is a fresh execution of the benchmark binary with a
+/// randomly sized environment block and a random stack and heap offset,
+/// and with address space randomization enabled, so that each process
+/// sees a different memory layout. Runs from all processes are merged,
+/// and each result additionally carries the variance of the mean run
+/// time between processes next to the pooled variance within them.
+class RepetitionRunner {
+public:
+    /// @param arguments Arguments to execute each repetition with,
+    /// including the executable name.
+    /// @param repetitions Number of processes to execute.
+    RepetitionRunner(const std::vector<std::string>& arguments,
+                     std::size_t repetitions)
+        :   _arguments(arguments),
+            _repetitions(repetitions)
+    {
+
+    }
+
+
+    /// Execute the repetitions and report to the outputters.
+
+    /// @returns true if every repetition completed successfully.
+    bool run(const std::vector<Outputter*>& outputters)
+    {
+        bool success = true;
+        std::srand(static_cast<unsigned>(std::time(0)) ^
+                   static_cast<unsigned>(::getpid()));
+
+        for (std::size_t repetition = 0;
+             repetition < _repetitions;
+             ++repetition) {
+            std::string data;
+            std::string failure;
+
+            if ((!execute(data, failure)) || (!decode(data, failure))) {
+                std::cerr << "repetition " << (repetition + 1) << " of "
+                          << _repetitions << " failed: " << failure
+                          << std::endl;
+                success = false;
+            }
+        }
+
+        report(outputters);
+        return success;
+    }
+private:
+    /// Aggregated results of one test across processes.
+    struct Entry {
+        Entry()
+            :   Iterations(0),
+                Runs(0),
+                Disabled(false),
+                WithinM2(0.0),
+                WithinDegrees(0)
+        {
+
+        }
+
+        std::string                         FixtureName;
+        std::string                         TestName;
+        std::vector<TestParameterDescriptor> Parameters;
+        std::size_t                         Iterations;
+        std::size_t                         Runs;
+        bool                                Disabled;
+        TestMeasurement                     Measurement;
+        RunningStatistics                   ProcessMeans;
+        double                              WithinM2;
+        std::size_t                         WithinDegrees;
+        std::vector<std::string>            Failures;
+    };
+
+
+    /// Execute a single repetition and collect its records.
+    bool execute(std::string& data, std::string& failure)
+    {
+        int fds[2];
+        if (::pipe(fds) != 0) {
+            failure = std::string("pipe failed: ") + strerror(errno);
+            return false;
+        }
+
+        std::stringstream fd;
+        fd << fds[1];
+
+        std::stringstream seed;
+        seed << ((unsigned long)(std::rand()) * 4096UL +
+                 (unsigned long)(std::rand() % 4096));
+
+        const std::string padding(std::size_t(std::rand() % 4096), 'x');
+
+        std::vector<std::string> arguments(_arguments);
+        arguments.push_back("--repetition-output");
+        arguments.push_back(fd.str());
+
+        std::cout.flush();
+        std::cerr.flush();
+        ::fflush(NULL);
+
+        const pid_t pid = ::fork();
+        if (pid < 0) {
+            failure = std::string("fork failed: ") + strerror(errno);
+            ::close(fds[0]);
+            ::close(fds[1]);
+            return false;
+        }
+
+        if (pid == 0) {
+            ::close(fds[0]);
+
+            ::setenv(BENCHMARK_LAYOUT_PADDING_ENV, padding.c_str(), 1);
+            ::setenv(BENCHMARK_LAYOUT_SEED_ENV, seed.str().c_str(), 1);
+
+#if defined(__linux__)
+            // Make sure the address space is randomized even if the parent
+            // runs with randomization disabled, e.g. under a debugger.
+            const int persona = ::personality(0xffffffff);
+            if ((persona != -1) && (persona & ADDR_NO_RANDOMIZE)) {
+                ::personality((unsigned long)(persona & ~ADDR_NO_RANDOMIZE));
+            }
+#endif
+
+            std::vector<char*> argv;
+            for (std::size_t i = 0; i < arguments.size(); ++i) {
+                argv.push_back(const_cast<char*>(arguments[i].c_str()));
+            }
+            argv.push_back(NULL);
+
+            ::execv("/proc/self/exe", &argv[0]);
+            ::execvp(argv[0], &argv[0]);
+            ::_exit(127);
+        }
+
+        ::close(fds[1]);
+
+        char buffer[65536];
+        while (true) {
+            const ssize_t got = ::read(fds[0], buffer, sizeof(buffer));
+            if (got < 0) {
+                if (errno == EINTR) {
+                    continue;
+                }
+                break;
+            }
+            if (got == 0) {
+                break;
+            }
+            data.append(buffer, std::size_t(got));
+        }
+        ::close(fds[0]);
+
+        int status = 0;
+        while ((::waitpid(pid, &status, 0) < 0) && (errno == EINTR)) {
+        }
+
+        std::stringstream error;
+        if (WIFSIGNALED(status)) {
+            error << "terminated by signal " << WTERMSIG(status)
+                  << " (" << strsignal(WTERMSIG(status)) << ")";
+        } else if ((WIFEXITED(status)) && (WEXITSTATUS(status) != 0)) {
+            error << "exited with status " << WEXITSTATUS(status);
+        } else {
+            return true;
+        }
+
+        failure = error.str();
+        return false;
+    }
+
+
+    /// Decode the records of a repetition and merge them.
+    bool decode(const std::string& data, std::string& failure)
+    {
+        try {
+            BinaryReader frames(data.data(), data.size());
+
+            while (!frames.atEnd()) {
+                const std::string record = frames.readString();
+                BinaryReader reader(record.data(), record.size());
+
+                const uint8_t type = reader.read<uint8_t>();
+                if (type == RepetitionOutputter::RecordTrace) {
+                    TraceRecorder::add(reader.readTrace());
+                    continue;
+                }
+
+                Entry& entry =
+                    lookup(reader, type == RepetitionOutputter::RecordDisabled);
+
+                switch (type) {
+                case RepetitionOutputter::RecordDisabled:
+                    entry.Disabled = true;
+                    entry.Runs = std::size_t(reader.read<uint64_t>());
+                    entry.Iterations = std::size_t(reader.read<uint64_t>());
+                    break;
+
+                case RepetitionOutputter::RecordFailure:
+                    entry.Failures.push_back(reader.readString());
+                    break;
+
+                case RepetitionOutputter::RecordResult:
+                    {
+                        entry.Iterations =
+                            std::size_t(reader.read<uint64_t>());
+                        const SampleStatistics runTimes =
+                            reader.readStatistics();
+                        const ResultMetadata metadata = reader.readMetadata();
+                        const ResultCounters counters = reader.readCounters();
+                        const std::size_t disturbedRuns =
+                            std::size_t(reader.read<uint64_t>());
+                        const std::size_t rejectedRuns =
+                            std::size_t(reader.read<uint64_t>());
+                        const RunningStatistics& moments = runTimes.moments();
+
+                        // Metadata is kept from the first process.
+                        if (entry.Measurement.RunTimes.count()) {
+                            entry.Measurement.RunTimes.merge(runTimes);
+                        } else {
+                            entry.Measurement.RunTimes = runTimes;
+                            entry.Measurement.Metadata = metadata;
+                        }
+                        mergeCounters(entry.Measurement.Counters, counters);
+                        entry.Measurement.DisturbedRuns += disturbedRuns;
+                        entry.Measurement.RejectedRuns += rejectedRuns;
+                        entry.Runs += runTimes.count();
+                        entry.ProcessMeans.add(moments.mean());
+                        entry.WithinM2 += moments.m2();
+                        if (moments.count()) {
+                            entry.WithinDegrees += moments.count() - 1;
+                        }
+                    }
+                    break;
+
+                default:
+                    throw std::runtime_error("invalid record type");
+                }
+            }
+        } catch (std::exception& e) {
+            failure = e.what();
+            return false;
+        }
+        return true;
+    }
+
+
+    /// Find or create the entry for the test named in a record.
+
+    /// Disabled tests are kept apart, as they may share their name with
+    /// an enabled test.
+    Entry& lookup(BinaryReader& reader, bool disabled)
+    {
+        Entry candidate;
+        candidate.FixtureName = reader.readString();
+        candidate.TestName = reader.readString();
+
+        std::stringstream key;
+        key << (disabled ? "-" : "+")
+            << candidate.FixtureName << "." << candidate.TestName;
+
+        const uint32_t parameterCount = reader.read<uint32_t>();
+        for (uint32_t i = 0; i < parameterCount; ++i) {
+            const std::string declaration = reader.readString();
+            const std::string value = reader.readString();
+            candidate.Parameters.push_back(
+                TestParameterDescriptor(declaration, value)
+            );
+            key << (i ? ", " : "(") << declaration << " = " << value;
+        }
+
+        std::map<std::string, std::size_t>::iterator it =
+            _index.find(key.str());
+        if (it != _index.end()) {
+            return _entries[it->second];
+        }
+
+        _index[key.str()] = _entries.size();
+        _entries.push_back(candidate);
+        return _entries.back();
+    }
+
+
+    /// Replay the aggregated results to the outputters.
+    void report(const std::vector<Outputter*>& outputters)
+    {
+        std::size_t disabledCount = 0;
+        for (std::size_t i = 0; i < _entries.size(); ++i) {
+            if (_entries[i].Disabled) {
+                ++disabledCount;
+            }
+        }
+        const std::size_t enabledCount = _entries.size() - disabledCount;
+
+        for (std::size_t o = 0; o < outputters.size(); ++o) {
+            outputters[o]->begin(enabledCount, disabledCount);
+        }
+
+        for (std::size_t i = 0; i < _entries.size(); ++i) {
+            const Entry& entry = _entries[i];
+            const TestParametersDescriptor parameters(entry.Parameters);
+
+            if (entry.Disabled) {
+                for (std::size_t o = 0; o < outputters.size(); ++o) {
+                    outputters[o]->skipDisabledTest(entry.FixtureName,
+                                                    entry.TestName,
+                                                    parameters,
+                                                    entry.Runs,
+                                                    entry.Iterations);
+                }
+                continue;
+            }
+
+            for (std::size_t o = 0; o < outputters.size(); ++o) {
+                outputters[o]->beginTest(entry.FixtureName,
+                                         entry.TestName,
+                                         parameters,
+                                         entry.Runs,
+                                         entry.Iterations);
+            }
+
+            if (!entry.Failures.empty()) {
+                std::stringstream reason;
+                reason << "failed in " << entry.Failures.size() << " of "
+                       << _repetitions << " processes: "
+                       << entry.Failures[0];
+
+                for (std::size_t o = 0; o < outputters.size(); ++o) {
+                    outputters[o]->failTest(entry.FixtureName,
+                                            entry.TestName,
+                                            parameters,
+                                            reason.str());
+                }
+                continue;
+            }
+
+            TestResult result(entry.Measurement, entry.Iterations);
+            result.setProcessStatistics(
+                entry.ProcessMeans,
+                (entry.WithinDegrees ?
+                 entry.WithinM2 / double(entry.WithinDegrees) :
+                 0.0)
+            );
+            BenchMarker::checkBudget(entry.FixtureName, entry.TestName, result);
+
+            for (std::size_t o = 0; o < outputters.size(); ++o) {
+                outputters[o]->endTest(entry.FixtureName,
+                                       entry.TestName,
+                                       parameters,
+                                       result);
+            }
+        }
+
+        for (std::size_t o = 0; o < outputters.size(); ++o) {
+            outputters[o]->end(enabledCount, disabledCount);
+        }
+    }
+private:
+    std::vector<std::string>             _arguments;
+    std::size_t                          _repetitions;
+    std::vector<Entry>                   _entries;
+    std::map<std::string, std::size_t>   _index;
+};
+
+}
+#endif
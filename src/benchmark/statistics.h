@@ -0,0 +1,500 @@
+#ifndef BENCHMARK_STATISTICS_H_
+#define BENCHMARK_STATISTICS_H_
+#include <algorithm>
+#include <cmath>
+#include <cstddef>
+#include <vector>
+
+namespace benchmark {
+
+/// Running moments.
+
+/// Keeps count, mean, variance, total, minimum and maximum of a stream of
+/// samples in constant memory using Welford's algorithm. Two instances can
+/// be merged with Chan's parallel formula, so per-thread or per-run
+/// accumulators can be combined without loss.
+class RunningStatistics {
+public:
+    RunningStatistics()
+        :   _count(0),
+            _mean(0.0),
+            _m2(0.0),
+            _total(0.0),
+            _minimum(0.0),
+            _maximum(0.0)
+    {
+
+    }
+
+
+    /// Add a sample.
+    inline void add(double value)
+    {
+        if (!_count) {
+            _minimum = value;
+            _maximum = value;
+        } else {
+            if (value < _minimum) {
+                _minimum = value;
+            }
+            if (value > _maximum) {
+                _maximum = value;
+            }
+        }
+
+        ++_count;
+        _total += value;
+
+        const double delta = value - _mean;
+        _mean += delta / double(_count);
+        _m2 += delta * (value - _mean);
+    }
+
+
+    /// Merge another accumulator into this one.
+    void merge(const RunningStatistics& other)
+    {
+        if (!other._count) {
+            return;
+        }
+        if (!_count) {
+            *this = other;
+            return;
+        }
+
+        const double count = double(_count) + double(other._count);
+        const double delta = other._mean - _mean;
+
+        _m2 += other._m2 +
+               delta * delta * double(_count) * double(other._count) / count;
+        _mean += delta * double(other._count) / count;
+        _count += other._count;
+        _total += other._total;
+        _minimum = std::min(_minimum, other._minimum);
+        _maximum = std::max(_maximum, other._maximum);
+    }
+
+
+    /// Number of samples.
+    inline std::size_t count() const
+    {
+        return _count;
+    }
+
+    /// Sum of all samples.
+    inline double total() const
+    {
+        return _total;
+    }
+
+    /// Arithmetic mean.
+    inline double mean() const
+    {
+        return _mean;
+    }
+
+    /// Sample variance.
+
+    /// Zero for fewer than two samples.
+    inline double variance() const
+    {
+        return (_count > 1 ? _m2 / double(_count - 1) : 0.0);
+    }
+
+    /// Sample standard deviation.
+    inline double stdDev() const
+    {
+        return std::sqrt(variance());
+    }
+
+    /// Smallest sample.
+    inline double minimum() const
+    {
+        return _minimum;
+    }
+
+    /// Largest sample.
+    inline double maximum() const
+    {
+        return _maximum;
+    }
+
+    /// Sum of squared deviations from the mean.
+    inline double m2() const
+    {
+        return _m2;
+    }
+
+
+    /// Restore an accumulator from its raw state.
+
+    /// Used when statistics are shipped between processes.
+    static RunningStatistics fromState(std::size_t count,
+                                       double mean,
+                                       double m2,
+                                       double total,
+                                       double minimum,
+                                       double maximum)
+    {
+        RunningStatistics statistics;
+        statistics._count = count;
+        statistics._mean = mean;
+        statistics._m2 = m2;
+        statistics._total = total;
+        statistics._minimum = minimum;
+        statistics._maximum = maximum;
+        return statistics;
+    }
+private:
+    std::size_t   _count;
+    double        _mean;
+    double        _m2;
+    double        _total;
+    double        _minimum;
+    double        _maximum;
+};
+
+
+/// Mergeable quantile sketch.
+
+/// A merging t-digest: samples are buffered and periodically folded into
+/// a bounded set of weighted centroids, kept small near the tails so that
+/// extreme quantiles stay accurate. Memory is bounded by the compression
+/// factor regardless of the number of samples. As long as no two samples
+/// have been folded together the digest is exact.
+class QuantileDigest {
+public:
+    /// Weighted centroid.
+    struct Centroid {
+        Centroid(double mean, double weight)
+            :   Mean(mean),
+                Weight(weight)
+        {
+
+        }
+
+        double Mean;
+        double Weight;
+
+        inline bool operator <(const Centroid& other) const
+        {
+            return Mean < other.Mean;
+        }
+    };
+
+
+    /// @param compression Upper bound on the number of centroids
+    /// retained, trading memory for accuracy.
+    explicit QuantileDigest(double compression = 100.0)
+        :   _compression(compression),
+            _bufferLimit(std::size_t(compression) * 5),
+            _weight(0.0),
+            _exact(true)
+    {
+
+    }
+
+
+    /// Add a sample.
+    inline void add(double value)
+    {
+        _buffer.push_back(Centroid(value, 1.0));
+        if (_buffer.size() >= _bufferLimit) {
+            compress();
+        }
+    }
+
+
+    /// Add a weighted centroid.
+    inline void add(double mean, double weight)
+    {
+        if (weight != 1.0) {
+            _exact = false;
+        }
+        _buffer.push_back(Centroid(mean, weight));
+        if (_buffer.size() >= _bufferLimit) {
+            compress();
+        }
+    }
+
+
+    /// Merge another digest into this one.
+    void merge(const QuantileDigest& other)
+    {
+        const std::vector<Centroid>& centroids = other.centroids();
+        for (std::size_t i = 0; i < centroids.size(); ++i) {
+            add(centroids[i].Mean, centroids[i].Weight);
+        }
+    }
+
+
+    /// Centroids in ascending order of their means.
+    const std::vector<Centroid>& centroids() const
+    {
+        compress();
+        return _centroids;
+    }
+
+
+    /// Whether every centroid still represents a single sample.
+    inline bool exact() const
+    {
+        compress();
+        return _exact;
+    }
+
+
+    /// Estimate a quantile.
+
+    /// @param q Quantile in [0, 1].
+    /// @returns the interpolated value at the quantile, or 0 if the digest
+    /// is empty.
+    double quantile(double q) const
+    {
+        compress();
+
+        if (_centroids.empty()) {
+            return 0.0;
+        }
+        if (_centroids.size() == 1) {
+            return _centroids[0].Mean;
+        }
+
+        q = std::max(0.0, std::min(1.0, q));
+        const double index = q * _weight;
+
+        // Each centroid's mass is centered on its mean; interpolate
+        // between neighbouring centers.
+        double cumulative = 0.0;
+        double previousCenter = 0.0;
+
+        for (std::size_t i = 0; i < _centroids.size(); ++i) {
+            const Centroid& centroid = _centroids[i];
+            const double center = cumulative + centroid.Weight / 2.0;
+
+            if (index <= center) {
+                if (!i) {
+                    return centroid.Mean;
+                }
+
+                const Centroid& previous = _centroids[i - 1];
+                const double fraction =
+                    (index - previousCenter) / (center - previousCenter);
+                return previous.Mean +
+                       fraction * (centroid.Mean - previous.Mean);
+            }
+
+            previousCenter = center;
+            cumulative += centroid.Weight;
+        }
+
+        return _centroids.back().Mean;
+    }
+private:
+    /// Scale function bounding centroid sizes.
+
+    /// k1 from the t-digest paper: centroids near q = 0 and q = 1 are kept
+    /// small, those near the median may grow.
+    inline double scale(double q) const
+    {
+        static const double pi = 3.14159265358979323846;
+        return _compression / (2.0 * pi) * std::asin(2.0 * q - 1.0);
+    }
+
+
+    /// Fold the buffered samples into the centroids.
+    void compress() const
+    {
+        if (_buffer.empty()) {
+            return;
+        }
+
+        _buffer.insert(_buffer.end(), _centroids.begin(), _centroids.end());
+        std::sort(_buffer.begin(), _buffer.end());
+
+        double weight = 0.0;
+        for (std::size_t i = 0; i < _buffer.size(); ++i) {
+            weight += _buffer[i].Weight;
+        }
+
+        std::vector<Centroid> merged;
+        merged.reserve(std::size_t(_compression) * 2);
+
+        Centroid current = _buffer[0];
+        double weightSoFar = 0.0;
+
+        for (std::size_t i = 1; i < _buffer.size(); ++i) {
+            const Centroid& next = _buffer[i];
+            const double proposed = current.Weight + next.Weight;
+            const double q0 = weightSoFar / weight;
+            const double q2 =
+                std::min(1.0, (weightSoFar + proposed) / weight);
+
+            if (scale(q2) - scale(q0) <= 1.0) {
+                current.Mean += (next.Mean - current.Mean) *
+                                next.Weight / proposed;
+                current.Weight = proposed;
+                _exact = false;
+            } else {
+                weightSoFar += current.Weight;
+                merged.push_back(current);
+                current = next;
+            }
+        }
+        merged.push_back(current);
+
+        _centroids.swap(merged);
+        _buffer.clear();
+        _weight = weight;
+    }
+private:
+    double                          _compression;
+    std::size_t                     _bufferLimit;
+    mutable std::vector<Centroid>   _centroids;
+    mutable std::vector<Centroid>   _buffer;
+    mutable double                  _weight;
+    mutable bool                    _exact;
+};
+
+
+/// Streaming sample statistics.
+
+/// Combines running moments with a quantile digest so that arbitrarily
+/// many samples can be summarized in constant memory. Raw samples are
+/// only kept when explicitly requested with retainSamples().
+class SampleStatistics {
+public:
+    SampleStatistics()
+        :   _retainSamples(false)
+    {
+
+    }
+
+
+    /// Retain raw samples.
+
+    /// Must be called before the first sample is added.
+    inline void retainSamples(bool retain)
+    {
+        _retainSamples = retain;
+    }
+
+    /// Whether raw samples are retained.
+    inline bool retainsSamples() const
+    {
+        return _retainSamples;
+    }
+
+
+    /// Add a sample.
+    inline void add(double value)
+    {
+        _moments.add(value);
+        _digest.add(value);
+        if (_retainSamples) {
+            _samples.push_back(value);
+        }
+    }
+
+
+    /// Merge another set of statistics into this one.
+
+    /// Raw samples are only carried over if both sides retain them.
+    void merge(const SampleStatistics& other)
+    {
+        _moments.merge(other._moments);
+        _digest.merge(other._digest);
+        if (_retainSamples) {
+            if (other._retainSamples) {
+                _samples.insert(_samples.end(),
+                                other._samples.begin(),
+                                other._samples.end());
+            } else {
+                _retainSamples = false;
+                std::vector<double>().swap(_samples);
+            }
+        }
+    }
+
+
+    /// Running moments.
+    inline const RunningStatistics& moments() const
+    {
+        return _moments;
+    }
+
+    /// Quantile digest.
+    inline const QuantileDigest& digest() const
+    {
+        return _digest;
+    }
+
+    /// Retained raw samples in insertion order.
+
+    /// Empty unless samples are retained.
+    inline const std::vector<double>& samples() const
+    {
+        return _samples;
+    }
+
+
+    inline std::size_t count() const
+    {
+        return _moments.count();
+    }
+
+    inline double total() const
+    {
+        return _moments.total();
+    }
+
+    inline double mean() const
+    {
+        return _moments.mean();
+    }
+
+    inline double stdDev() const
+    {
+        return _moments.stdDev();
+    }
+
+    inline double minimum() const
+    {
+        return _moments.minimum();
+    }
+
+    inline double maximum() const
+    {
+        return _moments.maximum();
+    }
+
+    inline double quantile(double q) const
+    {
+        return _digest.quantile(q);
+    }
+
+
+    /// Restore statistics from their components.
+
+    /// Used when statistics are shipped between processes.
+    static SampleStatistics fromParts(const RunningStatistics& moments,
+                                      const QuantileDigest& digest,
+                                      const std::vector<double>& samples,
+                                      bool retainSamples)
+    {
+        SampleStatistics statistics;
+        statistics._moments = moments;
+        statistics._digest = digest;
+        statistics._samples = samples;
+        statistics._retainSamples = retainSamples;
+        return statistics;
+    }
+private:
+    RunningStatistics     _moments;
+    QuantileDigest        _digest;
+    std::vector<double>   _samples;
+    bool                  _retainSamples;
+};
+
+}
+#endif
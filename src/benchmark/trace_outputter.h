@@ -0,0 +1,221 @@
+#ifndef BENCHMARK_TRACE_OUTPUTTER_H_
+#define BENCHMARK_TRACE_OUTPUTTER_H_
+#include <cmath>
+#include <cstdio>
+#include <set>
+#include <string>
+#include <vector>
+#include <unistd.h>
+#include <benchmark/outputter.h>
+#include <benchmark/trace_recorder.h>
+
+namespace benchmark {
+
+/// Writes the timeline of the run as Chrome trace-event JSON.
+
+/// Shows when calibration, every test, fixture set up and tear down, run
+/// and sampled iteration happened, on the thread and process it happened
+/// on, for chrome://tracing or ui.perfetto.dev. Requires the timeline to
+/// be recorded with BenchMarker::setTracing(). The document is written at
+/// end(), once the timeline is complete.
+class TraceOutputter : public Outputter {
+public:
+    TraceOutputter(std::ostream& stream = std::cout)
+        :   _stream(stream)
+    {
+
+    }
+
+
+    virtual void environment(const Environment& environment)
+    {
+        _properties = environment.Properties;
+    }
+
+
+    virtual void begin(const std::size_t& enabledCount,
+                       const std::size_t& disabledCount)
+    {
+
+    }
+
+
+    virtual void end(const std::size_t& executedCount,
+                     const std::size_t& disabledCount)
+    {
+        const std::vector<TraceEvent> events = TraceRecorder::events();
+        const int64_t self = int64_t(::getpid());
+
+        _stream << "{\n  \"displayTimeUnit\": \"ns\",\n"
+                << "  \"otherData\": {";
+        for (std::size_t i = 0; i < _properties.size(); ++i) {
+            _stream << (i ? ",\n" : "\n") << "    "
+                    << quote(_properties[i].first) << ": "
+                    << quote(_properties[i].second);
+        }
+        _stream << (_properties.empty() ? "},\n" : "\n  },\n")
+                << "  \"traceEvents\": [";
+
+        // Name the processes, then the threads, then the spans.
+        bool first = true;
+        std::set<int64_t> processes;
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            if (!processes.insert(events[i].Process).second) {
+                continue;
+            }
+            metadata("process_name",
+                     events[i].Process,
+                     events[i].Process,
+                     (events[i].Process == self ?
+                      "benchmark" :
+                      "child benchmark"),
+                     first);
+        }
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            if (events[i].Phase == 'M') {
+                metadata("thread_name",
+                         events[i].Process,
+                         events[i].Thread,
+                         events[i].Name,
+                         first);
+            }
+        }
+
+        for (std::size_t i = 0; i < events.size(); ++i) {
+            const TraceEvent& event = events[i];
+            if (event.Phase != 'X') {
+                continue;
+            }
+
+            separate(first);
+            _stream << "{\"name\": " << quote(event.Name)
+                    << ", \"cat\": " << quote(event.Category)
+                    << ", \"ph\": \"X\", \"ts\": "
+                    << microseconds(event.Start)
+                    << ", \"dur\": " << microseconds(event.Duration)
+                    << ", \"pid\": " << event.Process
+                    << ", \"tid\": " << event.Thread;
+            if (!event.Arguments.empty()) {
+                _stream << ", \"args\": {";
+                for (std::size_t a = 0; a < event.Arguments.size(); ++a) {
+                    _stream << (a ? ", " : "")
+                            << quote(event.Arguments[a].first) << ": "
+                            << number(event.Arguments[a].second);
+                }
+                _stream << "}";
+            }
+            _stream << "}";
+        }
+
+        _stream << (first ? "]\n}\n" : "\n  ]\n}\n");
+        _stream.flush();
+    }
+
+
+    virtual void beginTest(const std::string& fixtureName,
+                           const std::string& testName,
+                           const TestParametersDescriptor& parameters,
+                           const std::size_t& runsCount,
+                           const std::size_t& iterationsCount)
+    {
+
+    }
+
+
+    virtual void endTest(const std::string& fixtureName,
+                         const std::string& testName,
+                         const TestParametersDescriptor& parameters,
+                         const TestResult& result)
+    {
+
+    }
+
+
+    virtual void skipDisabledTest(const std::string& fixtureName,
+                                  const std::string& testName,
+                                  const TestParametersDescriptor& parameters,
+                                  const std::size_t& runsCount,
+                                  const std::size_t& iterationsCount)
+    {
+
+    }
+private:
+    /// Start an entry of the event array.
+    void separate(bool& first)
+    {
+        _stream << (first ? "\n    " : ",\n    ");
+        first = false;
+    }
+
+
+    /// Write a metadata event naming a process or thread.
+    void metadata(const char* kind,
+                  int64_t process,
+                  int64_t thread,
+                  const std::string& name,
+                  bool& first)
+    {
+        separate(first);
+        _stream << "{\"name\": \"" << kind << "\", \"ph\": \"M\""
+                << ", \"pid\": " << process
+                << ", \"tid\": " << thread
+                << ", \"args\": {\"name\": " << quote(name) << "}}";
+    }
+
+
+    /// Nanoseconds as microseconds, keeping nanosecond precision.
+    static std::string microseconds(uint64_t nanoseconds)
+    {
+        char buffer[32];
+        ::snprintf(buffer, sizeof(buffer), "%llu.%03u",
+                   static_cast<unsigned long long>(nanoseconds / 1000),
+                   static_cast<unsigned>(nanoseconds % 1000));
+        return buffer;
+    }
+
+
+    static std::string number(double value)
+    {
+        if ((value != value) ||
+            (value == HUGE_VAL) ||
+            (value == -HUGE_VAL)) {
+            return "null";
+        }
+
+        char buffer[32];
+        ::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        return buffer;
+    }
+
+
+    /// Quote and escape a JSON string.
+    static std::string quote(const std::string& value)
+    {
+        std::string quoted("\"");
+        for (std::size_t i = 0; i < value.size(); ++i) {
+            const unsigned char c = static_cast<unsigned char>(value[i]);
+            if (c == '"') {
+                quoted += "\\\"";
+            } else if (c == '\\') {
+                quoted += "\\\\";
+            } else if (c == '\n') {
+                quoted += "\\n";
+            } else if (c == '\t') {
+                quoted += "\\t";
+            } else if (c < 0x20) {
+                char escape[8];
+                ::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            } else {
+                quoted += char(c);
+            }
+        }
+        return quoted + "\"";
+    }
+private:
+    std::ostream   &_stream;
+    ResultMetadata  _properties;
+};
+
+}
+#endif
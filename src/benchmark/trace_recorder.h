@@ -0,0 +1,233 @@
+#ifndef BENCHMARK_TRACE_RECORDER_H_
+#define BENCHMARK_TRACE_RECORDER_H_
+#include <cstddef>
+#include <string>
+#include <utility>
+#include <vector>
+#include <pthread.h>
+#include <stdint.h>
+#include <time.h>
+#include <unistd.h>
+#if defined(__linux__)
+    #include <sys/syscall.h>
+#endif
+
+namespace benchmark {
+
+/// Numeric arguments of a trace event.
+typedef std::vector<std::pair<std::string, double> > TraceArguments;
+
+
+/// Event on the timeline of a benchmark run.
+struct TraceEvent {
+    TraceEvent()
+        :   Phase('X'),
+            Start(0),
+            Duration(0),
+            Process(0),
+            Thread(0)
+    {
+
+    }
+
+
+    /// 'X' for a span, 'M' for naming the thread.
+    char Phase;
+
+
+    /// Name of the span, or of the thread for 'M'.
+    std::string Name;
+
+
+    /// Category of the span, e.g. "fixture" or "run".
+    std::string Category;
+
+
+    /// Start in nanoseconds of the trace clock.
+    uint64_t Start;
+
+
+    /// Duration in nanoseconds.
+    uint64_t Duration;
+
+
+    /// Process and thread the event happened on.
+    int64_t Process;
+    int64_t Thread;
+
+
+    /// Numeric arguments shown with the span.
+    TraceArguments Arguments;
+};
+
+
+/// Records a timeline of calibration, tests, runs and fixtures.
+
+/// Spans are kept in memory and written by the trace outputter. Spans of
+/// isolated children and repetitions are sent back to the parent with
+/// their results. Timestamps are taken from CLOCK_BOOTTIME where
+/// available, the default clock of Perfetto system traces, so both line up
+/// when loaded together.
+class TraceRecorder {
+public:
+    /// Enable recording for all tests.
+
+    /// Disabled by default.
+    static void setEnabled(bool enabled)
+    {
+        state().Enabled = enabled;
+    }
+
+
+    /// Whether recording is enabled.
+    static inline bool enabled()
+    {
+        return state().Enabled;
+    }
+
+
+    /// Record every n-th iteration of a run as a span.
+
+    /// The sampled iterations are timed on their own, which adds reading
+    /// the clock twice and recording the span to their time.
+    /// @param interval Iterations between samples, or 0 for none.
+    static void setIterationInterval(std::size_t interval)
+    {
+        state().IterationInterval = interval;
+    }
+
+
+    /// Iterations between sampled iteration spans, or 0 for none.
+    static inline std::size_t iterationInterval()
+    {
+        return state().IterationInterval;
+    }
+
+
+    /// Current time of the trace clock in nanoseconds.
+    static inline uint64_t now()
+    {
+        struct timespec time;
+#if defined(CLOCK_BOOTTIME)
+        ::clock_gettime(CLOCK_BOOTTIME, &time);
+#else
+        ::clock_gettime(CLOCK_MONOTONIC, &time);
+#endif
+        return (uint64_t(time.tv_sec) * uint64_t(1000000000) +
+                uint64_t(time.tv_nsec));
+    }
+
+
+    /// Record a span on the calling thread ending now, if enabled.
+
+    /// @param start Start of the span from now().
+    /// @returns the end of the span, to start the next one at.
+    static uint64_t span(const std::string& name,
+                         const char* category,
+                         uint64_t start,
+                         const TraceArguments& arguments = TraceArguments())
+    {
+        const uint64_t end = now();
+        if (!enabled()) {
+            return end;
+        }
+
+        TraceEvent event;
+        event.Name = name;
+        event.Category = category;
+        event.Start = start;
+        event.Duration = (end > start ? end - start : 0);
+        event.Arguments = arguments;
+        record(event);
+        return end;
+    }
+
+
+    /// Name the calling thread in the trace, if enabled.
+    static void nameThread(const std::string& name)
+    {
+        if (!enabled()) {
+            return;
+        }
+
+        TraceEvent event;
+        event.Phase = 'M';
+        event.Name = name;
+        record(event);
+    }
+
+
+    /// Add events recorded elsewhere, e.g. in an isolated child.
+    static void add(const std::vector<TraceEvent>& events)
+    {
+        State& s = state();
+        ::pthread_mutex_lock(&s.Mutex);
+        s.Events.insert(s.Events.end(), events.begin(), events.end());
+        ::pthread_mutex_unlock(&s.Mutex);
+    }
+
+
+    /// Recorded events.
+    static std::vector<TraceEvent> events()
+    {
+        State& s = state();
+        ::pthread_mutex_lock(&s.Mutex);
+        const std::vector<TraceEvent> events(s.Events);
+        ::pthread_mutex_unlock(&s.Mutex);
+        return events;
+    }
+
+
+    /// Discard the recorded events.
+
+    /// Called in isolated children, which inherit the events of the
+    /// parent.
+    static void clear()
+    {
+        State& s = state();
+        ::pthread_mutex_lock(&s.Mutex);
+        s.Events.clear();
+        ::pthread_mutex_unlock(&s.Mutex);
+    }
+private:
+    struct State {
+        State()
+            :   Enabled(false),
+                IterationInterval(0)
+        {
+            ::pthread_mutex_init(&Mutex, NULL);
+        }
+
+        bool                     Enabled;
+        std::size_t              IterationInterval;
+        pthread_mutex_t          Mutex;
+        std::vector<TraceEvent>  Events;
+    };
+
+
+    static State& state()
+    {
+        static State s;
+        return s;
+    }
+
+
+    /// Add an event happening on the calling thread.
+    static void record(TraceEvent& event)
+    {
+        event.Process = int64_t(::getpid());
+#if defined(__linux__) && defined(SYS_gettid)
+        event.Thread = int64_t(::syscall(SYS_gettid));
+#else
+        event.Thread = event.Process;
+#endif
+
+        State& s = state();
+        ::pthread_mutex_lock(&s.Mutex);
+        s.Events.push_back(event);
+        ::pthread_mutex_unlock(&s.Mutex);
+    }
+};
+
+}
+#endif
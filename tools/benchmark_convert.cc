@@ -0,0 +1,295 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <exception>
+#include <iostream>
+#include <string>
+#include <benchmark/columnar_format.h>
+
+// Converts columnar results files written with "-o columnar:<path>" to
+// JSON or CSV for tools that cannot read the binary format.
+
+namespace {
+    const char* statusName(uint32_t status)
+    {
+        switch (status) {
+        case ::benchmark::ColumnarMeasured:
+            return "measured";
+        case ::benchmark::ColumnarDisabled:
+            return "disabled";
+        case ::benchmark::ColumnarFailed:
+            return "failed";
+        }
+        return "unknown";
+    }
+
+
+    std::string number(double value)
+    {
+        if ((value != value) ||
+            (value == HUGE_VAL) ||
+            (value == -HUGE_VAL)) {
+            return "null";
+        }
+
+        char buffer[32];
+        ::snprintf(buffer, sizeof(buffer), "%.17g", value);
+        return buffer;
+    }
+
+
+    std::string number(uint64_t value)
+    {
+        char buffer[32];
+        ::snprintf(buffer, sizeof(buffer), "%llu",
+                   static_cast<unsigned long long>(value));
+        return buffer;
+    }
+
+
+    std::string jsonString(const char* value)
+    {
+        std::string quoted("\"");
+        for (; *value; ++value) {
+            const unsigned char c = static_cast<unsigned char>(*value);
+            if (c == '"') {
+                quoted += "\\\"";
+            } else if (c == '\\') {
+                quoted += "\\\\";
+            } else if (c == '\n') {
+                quoted += "\\n";
+            } else if (c == '\t') {
+                quoted += "\\t";
+            } else if (c < 0x20) {
+                char escape[8];
+                ::snprintf(escape, sizeof(escape), "\\u%04x", c);
+                quoted += escape;
+            } else {
+                quoted += char(c);
+            }
+        }
+        return quoted + "\"";
+    }
+
+
+    std::string csvField(const char* value)
+    {
+        if (!::strpbrk(value, ",\"\r\n")) {
+            return value;
+        }
+
+        std::string quoted("\"");
+        for (; *value; ++value) {
+            if (*value == '"') {
+                quoted += '"';
+            }
+            quoted += *value;
+        }
+        return quoted + "\"";
+    }
+
+
+    void writeEntries(std::ostream& stream,
+                      const ::benchmark::ColumnarResults& results,
+                      const ::benchmark::ColumnarEntry* entries,
+                      std::size_t count,
+                      const char* indent)
+    {
+        stream << "{";
+        for (std::size_t i = 0; i < count; ++i) {
+            stream << (i ? ",\n" : "\n") << indent << "  "
+                   << jsonString(results.string(entries[i].Key)) << ": "
+                   << jsonString(results.string(entries[i].Value));
+        }
+        stream << (count ? "\n" + std::string(indent) : "") << "}";
+    }
+
+
+    void writeJson(std::ostream& stream,
+                   const ::benchmark::ColumnarResults& results,
+                   bool samples)
+    {
+        stream << "{\n  \"environment\": ";
+        if (results.environmentCount()) {
+            writeEntries(stream,
+                         results,
+                         &results.environment(0),
+                         results.environmentCount(),
+                         "  ");
+        } else {
+            stream << "{}";
+        }
+        stream << ",\n  \"benchmarks\": [";
+
+        for (std::size_t t = 0; t < results.testCount(); ++t) {
+            const ::benchmark::ColumnarTest& test = results.test(t);
+
+            stream << (t ? ",\n" : "\n") << "    {\n"
+                   << "      \"fixture\": "
+                   << jsonString(results.string(test.Fixture)) << ",\n"
+                   << "      \"name\": "
+                   << jsonString(results.string(test.Name)) << ",\n"
+                   << "      \"parameters\": "
+                   << jsonString(results.string(test.Parameters)) << ",\n"
+                   << "      \"status\": \"" << statusName(test.Status)
+                   << "\",\n";
+            if (test.Status == ::benchmark::ColumnarFailed) {
+                stream << "      \"reason\": "
+                       << jsonString(results.string(test.Reason)) << ",\n";
+            }
+            stream << "      \"runs\": " << number(test.Runs) << ",\n"
+                   << "      \"iterations\": " << number(test.Iterations)
+                   << ",\n"
+                   << "      \"disturbed_runs\": "
+                   << number(test.DisturbedRuns) << ",\n"
+                   << "      \"rejected_runs\": "
+                   << number(test.RejectedRuns);
+
+            if (test.Status == ::benchmark::ColumnarMeasured) {
+                stream << ",\n      \"run_time_ns\": {"
+                       << "\"mean\": " << number(test.Mean)
+                       << ", \"stddev\": " << number(test.StdDev)
+                       << ", \"median\": " << number(test.Median)
+                       << ", \"q1\": " << number(test.Quartile1)
+                       << ", \"q3\": " << number(test.Quartile3)
+                       << ", \"min\": " << number(test.Minimum)
+                       << ", \"max\": " << number(test.Maximum) << "}"
+                       << ",\n      \"metadata\": ";
+                writeEntries(stream,
+                             results,
+                             results.metadata(test),
+                             std::size_t(test.EntriesCount),
+                             "      ");
+
+                stream << ",\n      \"counters\": {";
+                const ::benchmark::ColumnarCounter* counters =
+                    results.counters(test);
+                for (std::size_t c = 0; c < test.CountersCount; ++c) {
+                    const ::benchmark::ColumnarCounter& counter = counters[c];
+                    stream << (c ? ",\n" : "\n") << "        "
+                           << jsonString(results.string(counter.Name))
+                           << ": {\"count\": " << number(counter.Count)
+                           << ", \"mean\": " << number(counter.Mean)
+                           << ", \"stddev\": " << number(counter.StdDev)
+                           << ", \"median\": " << number(counter.Median)
+                           << ", \"min\": " << number(counter.Minimum)
+                           << ", \"max\": " << number(counter.Maximum)
+                           << "}";
+                }
+                stream << (test.CountersCount ? "\n      }" : "}");
+
+                if (samples) {
+                    const double* runTimes = results.samples(test);
+                    stream << ",\n      \"run_times_ns\": [";
+                    for (std::size_t s = 0; s < test.SamplesCount; ++s) {
+                        stream << (s ? ", " : "") << number(runTimes[s]);
+                    }
+                    stream << "]";
+                }
+            }
+            stream << "\n    }";
+        }
+        stream << (results.testCount() ? "\n  ]\n}\n" : "]\n}\n");
+    }
+
+
+    void writeCsv(std::ostream& stream,
+                  const ::benchmark::ColumnarResults& results,
+                  bool samples)
+    {
+        if (samples) {
+            stream << "fixture,name,parameters,run,run_time_ns\n";
+        } else {
+            stream << "fixture,name,parameters,status,runs,iterations,"
+                   << "mean_ns,stddev_ns,median_ns,q1_ns,q3_ns,min_ns,"
+                   << "max_ns,disturbed_runs,rejected_runs\n";
+        }
+
+        for (std::size_t t = 0; t < results.testCount(); ++t) {
+            const ::benchmark::ColumnarTest& test = results.test(t);
+            const std::string names =
+                csvField(results.string(test.Fixture)) + "," +
+                csvField(results.string(test.Name)) + "," +
+                csvField(results.string(test.Parameters));
+
+            if (samples) {
+                const double* runTimes = results.samples(test);
+                for (std::size_t s = 0; s < test.SamplesCount; ++s) {
+                    stream << names << "," << s << ","
+                           << number(runTimes[s]) << "\n";
+                }
+                continue;
+            }
+
+            stream << names << "," << statusName(test.Status) << ","
+                   << number(test.Runs) << ","
+                   << number(test.Iterations);
+            if (test.Status == ::benchmark::ColumnarMeasured) {
+                stream << "," << number(test.Mean)
+                       << "," << number(test.StdDev)
+                       << "," << number(test.Median)
+                       << "," << number(test.Quartile1)
+                       << "," << number(test.Quartile3)
+                       << "," << number(test.Minimum)
+                       << "," << number(test.Maximum);
+            } else {
+                stream << ",,,,,,,";
+            }
+            stream << "," << number(test.DisturbedRuns)
+                   << "," << number(test.RejectedRuns) << "\n";
+        }
+    }
+
+
+    int usage(const char* executable)
+    {
+        std::cerr << "Usage: " << executable
+                  << " [--samples] (json|csv) <results file>" << std::endl
+                  << std::endl
+                  << "Converts a columnar results file to JSON or CSV on "
+                  << "stdout." << std::endl
+                  << std::endl
+                  << "  --samples" << std::endl
+                  << "    Include the raw run times: as an array per "
+                  << "benchmark in JSON, or as" << std::endl
+                  << "    one row per run instead of the summary in CSV."
+                  << std::endl;
+        return EXIT_FAILURE;
+    }
+}
+
+int main(int argc, char** argv)
+{
+    bool samples = false;
+    int argI = 1;
+
+    if ((argI < argc) && (!strcmp(argv[argI], "--samples"))) {
+        samples = true;
+        ++argI;
+    }
+    if (argc - argI != 2) {
+        return usage(argv[0]);
+    }
+
+    const char* format = argv[argI];
+    const char* path = argv[argI + 1];
+    if ((strcmp(format, "json")) && (strcmp(format, "csv"))) {
+        return usage(argv[0]);
+    }
+
+    try {
+        const ::benchmark::ColumnarResults results(path);
+        if (!strcmp(format, "json")) {
+            writeJson(std::cout, results, samples);
+        } else {
+            writeCsv(std::cout, results, samples);
+        }
+    } catch (std::exception& e) {
+        std::cerr << "Error: " << e.what() << std::endl;
+        return EXIT_FAILURE;
+    }
+
+    std::cout.flush();
+    return (std::cout.good() ? EXIT_SUCCESS : EXIT_FAILURE);
+}